@@ -0,0 +1,364 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <benchmark/benchmark.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+#include <algorithm>
+#include <sstream>
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_TEST_DATA
+#define IAI_NAIVE_KINEMATICS_SIM_TEST_DATA "test_data"
+#endif
+
+using namespace iai_naive_kinematics_sim;
+
+// robot with arms of 10 joints each, or of 5 joints that are followed by 5 fingers each
+static RobotGenerator makeRobot(size_t joints, bool fingers, size_t expression_depth = 1)
+{
+  RobotGeneratorConfig config;
+  config.chains = std::max<size_t>(1, joints / 10);
+  config.chain_depth = fingers ? 5 : 10;
+  config.joint_types = {"revolute", "revolute", "continuous"};
+  config.fingers = fingers ? 5 : 0;
+  config.expression_depth = expression_depth;
+  return RobotGenerator(config);
+}
+
+static void initRobot(Simulator& sim, const RobotGenerator& generator)
+{
+  urdf::Model model;
+  if (!model.initString(generator.makeURDF()))
+    throw std::runtime_error("Could not parse synthetic URDF.");
+
+  sim.init(model, generator.getSimulatedJoints(), generator.getControlledJoints(),
+      ros::Duration(1.0), generator.makeFakeControllers());
+
+  // give every controlled joint something to integrate
+  sensor_msgs::JointState command;
+  for (size_t i=0; i<generator.getControlledJoints().size(); ++i)
+    pushBackJointState(command, generator.getControlledJoints()[i], 0.0, 0.1, 0.0);
+  sim.setSubCommand(command, ros::Time(1.0));
+}
+
+static void initRobot(Simulator& sim, size_t joints, bool fingers)
+{
+  initRobot(sim, makeRobot(joints, fingers));
+}
+
+// keeps the controlled joints moving during long runs: resends their command every 100
+// ticks, within the watchdog period, and turns them around every 1000 ticks, before they
+// reach their limits; a robot that stands still would only measure the dirty checks of
+// the fake controllers
+class Commander
+{
+  public:
+    Commander(const Simulator& sim, const std::vector<std::string>& controlled,
+        double velocity) :
+      layout_(sim.resolveLayout(controlled)), velocities_(controlled.size(), velocity),
+      velocity_(velocity), ticks_(0) {}
+
+    void tick(Simulator& sim, const ros::Time& now)
+    {
+      if (ticks_ % 100 == 0)
+      {
+        std::fill(velocities_.begin(), velocities_.end(),
+            (ticks_ / 1000) % 2 == 0 ? velocity_ : -velocity_);
+        sim.setSubCommand(layout_, velocities_.data(), now);
+      }
+      ticks_++;
+    }
+
+  private:
+    JointLayout layout_;
+    std::vector<double> velocities_;
+    double velocity_;
+    size_t ticks_;
+};
+
+static void JointCounts(benchmark::internal::Benchmark* b)
+{
+  b->Arg(10)->Arg(30)->Arg(100)->Arg(300)->Arg(1000);
+}
+
+static void BM_Update(benchmark::State& state)
+{
+  Simulator sim;
+  RobotGenerator generator = makeRobot(state.range(0), false);
+  initRobot(sim, generator);
+  Commander commander(sim, generator.getControlledJoints(), 0.1);
+  ros::Time now(1.0);
+  ros::Duration dt(0.001);
+
+  for (auto _ : state)
+  {
+    now += dt;
+    commander.tick(sim, now);
+    sim.update(now, dt);
+    benchmark::DoNotOptimize(sim.getJointArrays().position.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Update)->Apply(JointCounts);
+
+static void BM_UpdateWithFakeControllers(benchmark::State& state)
+{
+  Simulator sim;
+  RobotGenerator generator = makeRobot(state.range(0), true);
+  initRobot(sim, generator);
+  Commander commander(sim, generator.getControlledJoints(), 0.1);
+  ros::Time now(1.0);
+  ros::Duration dt(0.001);
+
+  for (auto _ : state)
+  {
+    now += dt;
+    commander.tick(sim, now);
+    sim.update(now, dt);
+    benchmark::DoNotOptimize(sim.getJointArrays().position.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UpdateWithFakeControllers)->Apply(JointCounts);
+
+static void BM_UpdateWithDeepFakeControllers(benchmark::State& state)
+{
+  Simulator sim;
+  RobotGenerator generator = makeRobot(100, true, state.range(0));
+  initRobot(sim, generator);
+  Commander commander(sim, generator.getControlledJoints(), 0.1);
+  ros::Time now(1.0);
+  ros::Duration dt(0.001);
+
+  for (auto _ : state)
+  {
+    now += dt;
+    commander.tick(sim, now);
+    sim.update(now, dt);
+    benchmark::DoNotOptimize(sim.getJointArrays().position.data());
+  }
+  state.SetItemsProcessed(state.iterations() * sim.size());
+}
+BENCHMARK(BM_UpdateWithDeepFakeControllers)->ArgName("expression_depth")->
+  Arg(1)->Arg(4)->Arg(16);
+
+static void BM_GetJointState(benchmark::State& state)
+{
+  Simulator sim;
+  initRobot(sim, state.range(0), false);
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(sim.getJointState().position.data());
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GetJointState)->Apply(JointCounts);
+
+// how the joints of the commands in BM_SetSubCommand are laid out
+enum CommandLayout
+{
+  IN_ORDER,     // all joints, in the order of the simulator
+  REVERSED,     // all joints, in reverse order
+  SUBSET,       // every fourth joint
+  ALTERNATING   // each command names a different one of several layouts
+};
+
+static std::vector<sensor_msgs::JointState> makeCommands(const std::vector<std::string>& names,
+    CommandLayout layout)
+{
+  std::vector<std::vector<std::string> > layouts;
+  switch (layout)
+  {
+    case IN_ORDER:
+      layouts.push_back(names);
+      break;
+    case REVERSED:
+      layouts.push_back(std::vector<std::string>(names.rbegin(), names.rend()));
+      break;
+    case SUBSET:
+      layouts.push_back(std::vector<std::string>());
+      for (size_t i=0; i<names.size(); i+=4)
+        layouts.back().push_back(names[i]);
+      break;
+    case ALTERNATING:
+      // more layouts than the simulator caches by default
+      for (size_t i=0; i<12; ++i)
+      {
+        layouts.push_back(names);
+        std::rotate(layouts.back().begin(),
+            layouts.back().begin() + (i * names.size()) / 12, layouts.back().end());
+      }
+      break;
+    default:
+      throw std::runtime_error("Unknown command layout.");
+  }
+
+  std::vector<sensor_msgs::JointState> commands(layouts.size());
+  for (size_t i=0; i<layouts.size(); ++i)
+    for (size_t j=0; j<layouts[i].size(); ++j)
+      pushBackJointState(commands[i], layouts[i][j], 0.0, 0.01 * j, 0.0);
+  return commands;
+}
+
+static void BM_SetSubCommand(benchmark::State& state)
+{
+  Simulator sim;
+  size_t joints = state.range(0);
+  initRobot(sim, joints, false);
+  std::vector<sensor_msgs::JointState> commands =
+    makeCommands(sim.getJointNames(), static_cast<CommandLayout>(state.range(1)));
+  ros::Time now(1.0);
+
+  size_t i = 0;
+  for (auto _ : state)
+  {
+    sim.setSubCommand(commands[i], now);
+    i = (i + 1) % commands.size();
+  }
+  state.SetItemsProcessed(state.iterations() * commands[0].name.size());
+}
+BENCHMARK(BM_SetSubCommand)->ArgNames({"joints", "layout"})->
+  ArgsProduct({{10, 100, 1000}, {IN_ORDER, REVERSED, SUBSET, ALTERNATING}});
+
+// the same without any name lookups, for callers that resolve their layout once
+static void BM_SetSubCommandResolved(benchmark::State& state)
+{
+  Simulator sim;
+  size_t joints = state.range(0);
+  initRobot(sim, joints, false);
+  sensor_msgs::JointState command = makeCommands(sim.getJointNames(), REVERSED)[0];
+  JointLayout layout = sim.resolveLayout(command.name);
+  ros::Time now(1.0);
+
+  for (auto _ : state)
+    sim.setSubCommand(layout, command.velocity.data(), now);
+  state.SetItemsProcessed(state.iterations() * joints);
+}
+BENCHMARK(BM_SetSubCommandResolved)->Arg(10)->Arg(100)->Arg(1000);
+
+static void BM_LoadFakeControllers(benchmark::State& state)
+{
+  Simulator sim;
+  RobotGenerator generator = makeRobot(state.range(0), true);
+  initRobot(sim, generator);
+  YAML::Node fake_controllers = generator.makeFakeControllers();
+
+  for (auto _ : state)
+    sim.loadFakeJoints(fake_controllers);
+  state.SetItemsProcessed(state.iterations() * fake_controllers["fake-controllers"].size());
+}
+BENCHMARK(BM_LoadFakeControllers)->Arg(10)->Arg(100)->Arg(1000);
+
+// URDF with the joints of the PR2 gripper that pr2_fake_controllers.yaml refers to
+static std::string pr2GripperURDF()
+{
+  const char* fingers[] = {"r_gripper_l_finger_joint", "r_gripper_l_finger_tip_joint",
+    "r_gripper_r_finger_joint", "r_gripper_r_finger_tip_joint"};
+
+  std::ostringstream urdf;
+  urdf << "<?xml version=\"1.0\"?>\n<robot name=\"pr2_gripper\">\n" <<
+    "  <link name=\"r_gripper_palm_link\"/>\n" <<
+    "  <link name=\"r_gripper_motor_link\"/>\n" <<
+    "  <joint name=\"r_gripper_joint\" type=\"prismatic\">\n" <<
+    "    <parent link=\"r_gripper_palm_link\"/>\n" <<
+    "    <child link=\"r_gripper_motor_link\"/>\n" <<
+    "    <axis xyz=\"0 1 0\"/>\n" <<
+    "    <limit effort=\"1000.0\" lower=\"0.0\" upper=\"0.09\" velocity=\"0.2\"/>\n" <<
+    "  </joint>\n";
+  for (size_t i=0; i<4; ++i)
+    urdf << "  <link name=\"finger_link" << i << "\"/>\n" <<
+      "  <joint name=\"" << fingers[i] << "\" type=\"revolute\">\n" <<
+      "    <parent link=\"r_gripper_palm_link\"/>\n" <<
+      "    <child link=\"finger_link" << i << "\"/>\n" <<
+      "    <axis xyz=\"0 0 1\"/>\n" <<
+      "    <limit effort=\"1000.0\" lower=\"0.0\" upper=\"0.548\" velocity=\"0.5\"/>\n" <<
+      "  </joint>\n";
+  urdf << "</robot>\n";
+  return urdf.str();
+}
+
+static void BM_UpdatePR2GripperFakeControllers(benchmark::State& state)
+{
+  urdf::Model model;
+  if (!model.initString(pr2GripperURDF()))
+    throw std::runtime_error("Could not parse synthetic URDF.");
+  YAML::Node config = YAML::LoadFile(
+      std::string(IAI_NAIVE_KINEMATICS_SIM_TEST_DATA) + "/pr2_fake_controllers.yaml");
+
+  std::vector<std::string> joints, controlled;
+  controlled.push_back("r_gripper_joint");
+  joints.push_back("r_gripper_joint");
+  for (size_t i=0; i<config["fake-controllers"].size(); ++i)
+    joints.push_back(config["fake-controllers"][i].begin()->first.as<std::string>());
+
+  Simulator sim;
+  sim.init(model, joints, controlled, ros::Duration(1.0), config["fake-controllers"]);
+  Commander commander(sim, controlled, 0.01);
+  ros::Time now(1.0);
+  ros::Duration dt(0.001);
+
+  for (auto _ : state)
+  {
+    now += dt;
+    commander.tick(sim, now);
+    sim.update(now, dt);
+    benchmark::DoNotOptimize(sim.getJointArrays().position.data());
+  }
+  state.SetItemsProcessed(state.iterations() * joints.size());
+}
+BENCHMARK(BM_UpdatePR2GripperFakeControllers);
+
+static void BM_SnapshotRestore(benchmark::State& state)
+{
+  Simulator sim;
+  initRobot(sim, state.range(0), true);
+  SimulatorSnapshot snapshot;
+  sim.snapshot(snapshot);
+
+  for (auto _ : state)
+  {
+    sim.snapshot(snapshot);
+    sim.restore(snapshot);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SnapshotRestore)->Apply(JointCounts);
+
+static void BM_Fork(benchmark::State& state)
+{
+  Simulator sim;
+  initRobot(sim, state.range(0), true);
+
+  for (auto _ : state)
+  {
+    Simulator fork = sim;
+    benchmark::DoNotOptimize(fork.getJointArrays().position.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Fork)->Apply(JointCounts);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_BATCH_SIMULATOR_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_BATCH_SIMULATOR_HPP
+
+#include <iai_naive_kinematics_sim/joint_arrays.hpp>
+#include <iai_naive_kinematics_sim/simulator.hpp>
+
+namespace iai_naive_kinematics_sim
+{
+  // simulates several worlds of the same robot in lock-step, e.g. to evaluate different
+  // command sequences from the same start state; all worlds share the joint limits and
+  // the compiled fake controllers, and their joint values are stored as [joint][world]
+  // so that every step is vectorized across the worlds
+  class BatchSimulator
+  {
+    public:
+      BatchSimulator() : worlds_(0) {}
+
+      ~BatchSimulator() {}
+
+      // sets up the given number of worlds, all starting from the current state,
+      // commands and watchdogs of sim
+      void init(const Simulator& sim, size_t worlds)
+      {
+        if (worlds == 0)
+          throw std::runtime_error("Asked to set up a batch simulation of 0 worlds.");
+
+        worlds_ = worlds;
+        state_msg_ = sim.getJointState();
+        const SimulatorModel& model = *sim.model_;
+        index_map_ = model.index_map;
+        watchdog_index_map_ = model.watchdog_index_map;
+        layouts_.clear();
+        watchdog_joints_ = model.watchdog_joints;
+        program_ = model.program;
+        program_.initBatchRegisters(worlds, registers_);
+
+        size_t joints = sim.size();
+        state_.resize(joints * worlds);
+        command_.resize(joints * worlds);
+        limits_.resize(joints * worlds);
+        for (size_t j=0; j<joints; ++j)
+          for (size_t w=0; w<worlds; ++w)
+          {
+            size_t i = j * worlds + w;
+            state_.position[i] = sim.state_.position[j];
+            state_.velocity[i] = sim.state_.velocity[j];
+            state_.effort[i] = sim.state_.effort[j];
+            command_.velocity[i] = sim.command_.velocity[j];
+            limits_.lower[i] = model.limits.lower[j];
+            limits_.upper[i] = model.limits.upper[j];
+          }
+
+        watchdog_periods_.clear();
+        last_pets_.clear();
+        for (size_t i=0; i<sim.watchdogs_.size(); ++i)
+        {
+          watchdog_periods_.push_back(sim.watchdogs_.getPeriod(i).toNSec());
+          last_pets_.insert(last_pets_.end(), worlds,
+              static_cast<int64_t>(sim.watchdogs_.getLastPetTime(i).toNSec()));
+        }
+      }
+
+      size_t worlds() const
+      {
+        return worlds_;
+      }
+
+      size_t size() const
+      {
+        return index_map_.size();
+      }
+
+      void update(const ros::Time& now, const ros::Duration& dt)
+      {
+        if (dt.toSec() <= 0)
+          throw std::runtime_error("Time interval given to update function not bigger than 0.");
+
+        // ask the watchdogs, and stop joints that have not received a new command in a while;
+        // then copy the commands of the controlled joints into the state
+        int64_t now_ns = static_cast<int64_t>(now.toNSec());
+        for (size_t i=0; i<watchdog_joints_.size(); ++i)
+        {
+          double* command = command_.velocity.data() + watchdog_joints_[i] * worlds_;
+          double* velocity = state_.velocity.data() + watchdog_joints_[i] * worlds_;
+          const int64_t* last_pet = last_pets_.data() + i * worlds_;
+          for (size_t w=0; w<worlds_; ++w)
+          {
+            if (now_ns - last_pet[w] > watchdog_periods_[i])
+              command[w] = 0.0;
+            velocity[w] = command[w];
+          }
+        }
+
+        integrateAndClamp(state_, limits_, dt.toSec());
+        program_.runBatch(state_, limits_, worlds_, registers_);
+
+        state_msg_.header.stamp = now;
+        state_msg_.header.seq++;
+      }
+
+      // the batched equivalent of Simulator::rollout; commands[w] is the schedule of world w,
+      // and trajectories[w] receives its states
+      void rollout(const ros::Time& now, const ros::Duration& dt, size_t steps,
+          const std::vector< std::vector<sensor_msgs::JointState> >& commands, size_t decimation,
+          std::vector< std::vector<sensor_msgs::JointState> >& trajectories)
+      {
+        if (commands.size() > worlds_)
+          throw std::runtime_error("Batch rollout of " + std::to_string(worlds_) +
+              " worlds was given command schedules for " + std::to_string(commands.size()) +
+              " worlds.");
+        for (size_t w=0; w<commands.size(); ++w)
+          if (commands[w].size() > steps)
+            throw std::runtime_error("Rollout of " + std::to_string(steps) +
+                " steps was given " + std::to_string(commands[w].size()) +
+                " commands for world " + std::to_string(w) + ".");
+
+        trajectories.assign(worlds_, std::vector<sensor_msgs::JointState>());
+        ros::Time step_now = now;
+        for (size_t i=0; i<steps; ++i, step_now += dt)
+        {
+          for (size_t w=0; w<commands.size(); ++w)
+            if (i < commands[w].size() && !commands[w][i].name.empty())
+              setSubCommand(w, commands[w][i], step_now);
+
+          update(step_now, dt);
+
+          if (i+1 == steps || (decimation > 0 && (i+1) % decimation == 0))
+            for (size_t w=0; w<worlds_; ++w)
+              trajectories[w].push_back(getJointState(w));
+        }
+
+        if (steps == 0)
+          for (size_t w=0; w<worlds_; ++w)
+            trajectories[w].push_back(getJointState(w));
+      }
+
+      void setSubCommand(size_t world, const sensor_msgs::JointState& command, const ros::Time& now)
+      {
+        checkWorld(world);
+        sanityCheckCommand(command);
+
+        const JointLayout& layout = *cachedLayout(command.name);
+        for (size_t i=0; i<layout.slots.size(); ++i)
+          if (layout.slots[i] != JointLayout::NONE)
+          {
+            last_pets_[layout.slots[i] * worlds_ + world] = static_cast<int64_t>(now.toNSec());
+            command_.velocity[watchdog_joints_[layout.slots[i]] * worlds_ + world] =
+              command.velocity[i];
+          }
+      }
+
+      void setSubJointState(size_t world, const sensor_msgs::JointState& state)
+      {
+        checkWorld(world);
+        sanityCheckJointState(state);
+
+        const JointLayout& layout = *cachedLayout(state.name);
+        checkJointsKnown(layout);
+        for (size_t i=0; i<layout.joints.size(); ++i)
+        {
+          size_t index = layout.joints[i] * worlds_ + world;
+          state_.position[index] = state.position[i];
+          state_.velocity[index] = state.velocity[i];
+          if (!state.effort.empty())
+            state_.effort[index] = state.effort[i];
+        }
+      }
+
+      sensor_msgs::JointState getJointState(size_t world) const
+      {
+        checkWorld(world);
+
+        sensor_msgs::JointState state = state_msg_;
+        for (size_t j=0; j<state.name.size(); ++j)
+        {
+          state.position[j] = state_.position[j * worlds_ + world];
+          state.velocity[j] = state_.velocity[j * worlds_ + world];
+          state.effort[j] = state_.effort[j * worlds_ + world];
+        }
+
+        return state;
+      }
+
+    private:
+      size_t worlds_;
+
+      // joint values, commands and limits of all worlds, stored as [joint][world]
+      JointArrays state_, command_;
+      JointLimitArrays limits_;
+
+      // the fake controllers, shared by all worlds, and their registers as [register][world]
+      ExpressionProgram program_;
+      std::vector<double> registers_;
+
+      // watchdog periods by slot, and the last time each slot was petted as [slot][world]
+      std::vector<int64_t> watchdog_periods_;
+      std::vector<int64_t> last_pets_;
+
+      // layout of the joints, copied from the simulator this batch was set up from
+      sensor_msgs::JointState state_msg_;
+      std::map<std::string, size_t> index_map_;
+      std::map<std::string, size_t> watchdog_index_map_;
+      std::vector<size_t> watchdog_joints_;
+      LayoutCache layouts_;
+
+      void checkWorld(size_t world) const
+      {
+        if (world >= worlds_)
+          throw std::range_error("Asked for world " + std::to_string(world) +
+              " of a batch simulation with " + std::to_string(worlds_) + " worlds.");
+      }
+
+      LayoutCache::LayoutPtr cachedLayout(const std::vector<std::string>& names)
+      {
+        LayoutCache::LayoutPtr layout = layouts_.find(names);
+        if (!layout)
+          layout = layouts_.insert(resolveJointLayout(names, index_map_, watchdog_index_map_));
+
+        return layout;
+      }
+  };
+}
+
+#endif
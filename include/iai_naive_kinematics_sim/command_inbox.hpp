@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_COMMAND_INBOX_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_COMMAND_INBOX_HPP
+
+#include <iai_naive_kinematics_sim/command_queue.hpp>
+#include <iai_naive_kinematics_sim/simulator.hpp>
+#include <memory>
+#include <mutex>
+
+namespace iai_naive_kinematics_sim
+{
+  // collects commands from any number of ROS callback threads, and hands them to the thread
+  // that simulates, to be applied at the start of the next tick; the names of a command are
+  // resolved to watchdog slots by the sending thread, and cached like in the simulator
+  class CommandInbox
+  {
+    public:
+      CommandInbox(size_t capacity = 256) : queue_(capacity), sim_(0) {}
+
+      ~CommandInbox() {}
+
+      // resolves names against the given simulator from now on; forgets cached layouts
+      void init(const Simulator& sim)
+      {
+        std::lock_guard<std::mutex> lock(layouts_mutex_);
+        sim_ = &sim;
+        layouts_.clear();
+      }
+
+      // returns false, and drops the command, if the simulation thread is falling behind
+      bool push(const sensor_msgs::JointState& command, const ros::Time& now)
+      {
+        sanityCheckCommand(command);
+
+        ResolvedCommand resolved;
+        resolved.layout = resolve(command.name);
+        resolved.velocities = command.velocity;
+        resolved.now = now;
+
+        return queue_.push(resolved);
+      }
+
+      // applies all commands received so far, in the order they arrived; only to be called
+      // by the thread that simulates
+      size_t apply(Simulator& sim)
+      {
+        size_t applied = 0;
+        while (queue_.pop(applied_))
+        {
+          sim.setSubCommand(*applied_.layout, applied_.velocities.data(), applied_.now);
+          applied++;
+        }
+
+        return applied;
+      }
+
+    private:
+      struct ResolvedCommand
+      {
+        LayoutCache::LayoutPtr layout;
+        std::vector<double> velocities;
+        ros::Time now;
+      };
+
+      CommandQueue<ResolvedCommand> queue_;
+      // the last applied command, whose buffers go back into the queue with the next one
+      ResolvedCommand applied_;
+
+      // only the callback threads share this lock, never the simulation thread
+      std::mutex layouts_mutex_;
+      const Simulator* sim_;
+      LayoutCache layouts_;
+
+      LayoutCache::LayoutPtr resolve(const std::vector<std::string>& names)
+      {
+        std::lock_guard<std::mutex> lock(layouts_mutex_);
+        if (!sim_)
+          throw std::runtime_error("Received a command before the simulator was set up.");
+
+        LayoutCache::LayoutPtr layout = layouts_.find(names);
+        if (!layout)
+          layout = layouts_.insert(sim_->resolveLayout(names));
+
+        return layout;
+      }
+  };
+}
+
+#endif
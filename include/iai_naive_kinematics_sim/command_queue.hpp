@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_COMMAND_QUEUE_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_COMMAND_QUEUE_HPP
+
+#include <atomic>
+#include <stdexcept>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+namespace iai_naive_kinematics_sim
+{
+  // bounded lock-free queue for handing commands from any number of ROS callback threads to
+  // the simulation thread; every cell carries a sequence number that tells producers and the
+  // consumer whose turn it is, so neither side ever waits for the other (after D. Vyukov)
+  template <class T>
+  class CommandQueue
+  {
+    public:
+      // capacity is rounded up to the next power of two
+      CommandQueue(size_t capacity) :
+        cells_(roundUp(capacity)), mask_(cells_.size() - 1), head_(0), tail_(0)
+      {
+        for (size_t i=0; i<cells_.size(); ++i)
+          cells_[i].sequence.store(i, std::memory_order_relaxed);
+      }
+
+      ~CommandQueue() {}
+
+      size_t capacity() const
+      {
+        return cells_.size();
+      }
+
+      // returns false, and drops value, if the queue is full
+      bool push(const T& value)
+      {
+        size_t position = tail_.load(std::memory_order_relaxed);
+        while (true)
+        {
+          Cell& cell = cells_[position & mask_];
+          size_t sequence = cell.sequence.load(std::memory_order_acquire);
+          intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+          if (difference == 0)
+          {
+            if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+              cell.value = value;
+              cell.sequence.store(position + 1, std::memory_order_release);
+              return true;
+            }
+          }
+          else if (difference < 0)
+            return false;
+          else
+            position = tail_.load(std::memory_order_relaxed);
+        }
+      }
+
+      // returns false if the queue is empty; only one thread may pop at a time; value is
+      // swapped into the queue, so that a later push reuses its buffers, and popping neither
+      // allocates nor frees
+      bool pop(T& value)
+      {
+        size_t position = head_.load(std::memory_order_relaxed);
+        Cell& cell = cells_[position & mask_];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (sequence != position + 1)
+          return false;
+
+        std::swap(value, cell.value);
+        head_.store(position + 1, std::memory_order_relaxed);
+        cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+        return true;
+      }
+
+    private:
+      struct Cell
+      {
+        Cell() : sequence(0) {}
+
+        std::atomic<size_t> sequence;
+        T value;
+      };
+
+      std::vector<Cell> cells_;
+      size_t mask_;
+      // producers and consumer on separate cache lines
+      alignas(64) std::atomic<size_t> head_;
+      alignas(64) std::atomic<size_t> tail_;
+
+      CommandQueue(const CommandQueue&);
+      CommandQueue& operator=(const CommandQueue&);
+
+      static size_t roundUp(size_t capacity)
+      {
+        if (capacity == 0)
+          throw std::runtime_error("Asked to create a command queue without capacity.");
+
+        size_t size = 1;
+        while (size < capacity)
+          size *= 2;
+        return size;
+      }
+  };
+}
+
+#endif
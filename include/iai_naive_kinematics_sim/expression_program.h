@@ -0,0 +1,149 @@
+#pragma once
+#include <iai_naive_kinematics_sim/joint_arrays.hpp>
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+namespace iai_naive_kinematics_sim
+{
+	enum OpCode {
+		// load a joint value into a register
+		OP_LOAD_POS,
+		OP_LOAD_VEL,
+		OP_LOAD_EFF,
+
+		// arithmetic on registers
+		OP_ADD,
+		OP_SUB,
+		OP_MUL,
+		OP_DIV,
+		OP_MIN,
+		OP_MAX,
+		OP_ABS,
+		OP_SIN,
+		OP_COS,
+
+		// write a register into a joint; positions are clamped into their limits, and
+		// velocities are integrated by the simulator in the next update
+		OP_STORE_POS,
+		OP_STORE_VEL,
+		OP_STORE_EFF
+	};
+
+	struct Instruction {
+		Instruction(OpCode _op, uint32_t _dst, uint32_t _a, uint32_t _b)
+		: op(_op), dst(_dst), a(_a), b(_b) {}
+
+		OpCode op;
+		uint32_t dst;	// register written by the instruction, or joint index for stores
+		uint32_t a;		// first argument register, or joint index for loads
+		uint32_t b;		// second argument register
+	};
+
+	// a joint value read or written by a program, identified by the load op code and joint index
+	typedef pair<OpCode, size_t> JointValue;
+
+	// the code computing and storing a single fake joint value, and the joint values it reads
+	struct Segment {
+		uint32_t begin, end;			// range of instructions, the last one is the store
+		uint32_t inputsBegin, inputsEnd;	// range of inputs
+	};
+
+	// mutable part of running a program: the register file, and the joint values
+	// each segment saw the last time it was run
+	struct ProgramState {
+		ProgramState() : valid(false) {}
+
+		vector<double> registers;
+		vector<double> inputs;
+		vector<double> outputs;
+		bool valid;
+	};
+
+	/**
+	 * Linear, register-based lowering of a set of expression trees. Constants
+	 * live in the initial register file, everything else is computed by running
+	 * the instructions in order.
+	 *
+	 * The code is split into one segment per stored joint value. A segment is only
+	 * run if one of its inputs, or the value it stores, changed since its last run.
+	 */
+	struct ExpressionProgram {
+		vector<Instruction> code;
+		vector<double> initialRegisters;
+		vector<Segment> segments;
+		vector<JointValue> inputs;
+
+		bool empty() const { return code.empty(); }
+
+		// hash of the code and constants; programs with the same fingerprint compute the same
+		uint32_t fingerprint() const;
+
+		void initState(ProgramState& state) const;
+
+		void run(JointArrays& state, const JointLimitArrays& limits, ProgramState& programState) const;
+
+		/**
+		 * Runs the program on several worlds at once. State and limits hold the joints
+		 * of all worlds as [joint][world], the registers are laid out the same way.
+		 * Every instruction is applied to all worlds before the next one, and all
+		 * segments are run.
+		 */
+		void initBatchRegisters(size_t worlds, vector<double>& registers) const;
+
+		void runBatch(JointArrays& state, const JointLimitArrays& limits, size_t worlds, vector<double>& registers) const;
+
+	private:
+		void execute(const Segment& segment, JointArrays& state, const JointLimitArrays& limits, double* r) const;
+	};
+
+	// evaluates a single arithmetic op code, the second argument is ignored by unary ones
+	double evaluateOp(OpCode op, double a, double b);
+
+	// the joint values changed by a store op code
+	set<JointValue> writtenBy(OpCode store, size_t joint);
+
+	/**
+	 * Emits instructions into an ExpressionProgram. Expression nodes lower
+	 * themselves through it, each call returns the register holding the result.
+	 *
+	 * Identical subexpressions are hash-consed, i.e. they are emitted once and
+	 * share their register, and arithmetic on constants is folded at compile time.
+	 */
+	class ExpressionCompiler {
+	public:
+		uint32_t constant(double value);
+		uint32_t load(OpCode op, size_t joint);
+		uint32_t unary(OpCode op, uint32_t a);
+		uint32_t binary(OpCode op, uint32_t a, uint32_t b);
+		void store(OpCode op, size_t joint, uint32_t a);
+
+		// the joint values that the value in a register was computed from
+		const set<JointValue>& inputsOf(uint32_t reg) const { return registerInputs[reg]; }
+
+		const ExpressionProgram& program() const { return prog; }
+
+	private:
+		typedef tuple<int, uint32_t, uint32_t> ValueKey;
+
+		uint32_t newRegister(double value, bool isConstant);
+		uint32_t emit(OpCode op, uint32_t a, uint32_t b);
+
+		ExpressionProgram prog;
+		vector<bool> constantRegisters;
+		vector<set<JointValue> > registerInputs;
+
+		// registers of values that were already emitted, by op code and arguments
+		map<ValueKey, uint32_t> values;
+		map<uint64_t, uint32_t> constants;
+
+		// number of stores to each joint value so far; part of the key of loads, so that
+		// loads after a store are not merged with those before it
+		map<JointValue, uint32_t> versions;
+	};
+}
@@ -1,4 +1,6 @@
 #pragma once
+#include <iai_naive_kinematics_sim/expression_program.h>
+#include <iai_naive_kinematics_sim/joint_arrays.hpp>
 #include <sensor_msgs/JointState.h>
 #include <urdf/model.h>
 #include <yaml-cpp/yaml.h>
@@ -13,6 +15,7 @@ namespace iai_naive_kinematics_sim
 template <typename A>
 	struct Expression {
 		virtual A value() = 0;
+		virtual uint32_t compile(ExpressionCompiler& compiler) = 0;
 	};
 
 template <typename A, typename B>
@@ -34,15 +37,15 @@ template <typename A, typename B, typename C>
 
 template <typename A>
 	struct JointExprBase : public Expression<A> {
-		JointExprBase(sensor_msgs::JointState& _state) : state(_state) {}
+		JointExprBase(JointArrays& _state) : state(_state) {}
 
 	protected:
-		sensor_msgs::JointState& state;
+		JointArrays& state;
 	};
 
 template <typename A>
 	struct UnaryJointExpr : public JointExprBase<A> {
-		UnaryJointExpr(sensor_msgs::JointState& _state, size_t _idx) : JointExprBase<A>(_state), idx(_idx) {}
+		UnaryJointExpr(JointArrays& _state, size_t _idx) : JointExprBase<A>(_state), idx(_idx) {}
 	protected:
 		size_t idx;
 	};
@@ -53,6 +56,7 @@ template <typename A>
 		ConstDoubleExpr(double a) : v(a) {}
 
 		inline double value() { return v; }
+		uint32_t compile(ExpressionCompiler& c) { return c.constant(v); }
 	private:
 		double v;
 	};
@@ -62,46 +66,55 @@ template <typename A>
 	struct AddExpr : public BinaryExpression<double, Expression<double>, Expression<double>> {
 		AddExpr(Expression<double>* a, Expression<double>* b) : BinaryExpression<double, Expression<double>, Expression<double>>(a, b) {}
 		inline double value() { return right->value() + left->value(); }
+		uint32_t compile(ExpressionCompiler& c) { return c.binary(OP_ADD, right->compile(c), left->compile(c)); }
 	};
 
 	struct SubExpr : public BinaryExpression<double, Expression<double>, Expression<double>> {
 		SubExpr(Expression<double>* a, Expression<double>* b) : BinaryExpression<double, Expression<double>, Expression<double>>(a, b) {}
 		inline double value() { return right->value() - left->value(); }
+		uint32_t compile(ExpressionCompiler& c) { return c.binary(OP_SUB, right->compile(c), left->compile(c)); }
 	};
 
 	struct MulExpr : public BinaryExpression<double, Expression<double>, Expression<double>> {
 		MulExpr(Expression<double>* a, Expression<double>* b) : BinaryExpression<double, Expression<double>, Expression<double>>(a, b) {}
 		inline double value() { return right->value() * left->value(); }
+		uint32_t compile(ExpressionCompiler& c) { return c.binary(OP_MUL, right->compile(c), left->compile(c)); }
 	};
 
 	struct DivExpr : public BinaryExpression<double, Expression<double>, Expression<double>> {
 		DivExpr(Expression<double>* a, Expression<double>* b) : BinaryExpression<double, Expression<double>, Expression<double>>(a, b) {}
 		inline double value() { return right->value() / left->value(); }
+		uint32_t compile(ExpressionCompiler& c) { return c.binary(OP_DIV, right->compile(c), left->compile(c)); }
 	};
 
 	struct MinExpr : public BinaryExpression<double, Expression<double>, Expression<double>> {
 		MinExpr(Expression<double>* a, Expression<double>* b) : BinaryExpression<double, Expression<double>, Expression<double>>(a, b) {}
 		inline double value() { return min(right->value(), left->value()); }
+		uint32_t compile(ExpressionCompiler& c) { return c.binary(OP_MIN, right->compile(c), left->compile(c)); }
 	};
 
 	struct MaxExpr : public BinaryExpression<double, Expression<double>, Expression<double>> {
 		MaxExpr(Expression<double>* a, Expression<double>* b) : BinaryExpression<double, Expression<double>, Expression<double>>(a, b) {}
 		inline double value() { return max(right->value(), left->value()); }
+		uint32_t compile(ExpressionCompiler& c) { return c.binary(OP_MAX, right->compile(c), left->compile(c)); }
 	};
 
 	struct AbsExpr : public UnaryExpression<double, Expression<double>> {
 		AbsExpr(Expression<double>* a) : UnaryExpression<double, Expression<double>>(a) {}
 		inline double value() { return abs(arg->value()); }
+		uint32_t compile(ExpressionCompiler& c) { return c.unary(OP_ABS, arg->compile(c)); }
 	};
 
 	struct SinExpr : public UnaryExpression<double, Expression<double>> {
 		SinExpr(Expression<double>* a) : UnaryExpression<double, Expression<double>>(a) {}
 		inline double value() { return sin(arg->value()); }
+		uint32_t compile(ExpressionCompiler& c) { return c.unary(OP_SIN, arg->compile(c)); }
 	};
 
 	struct CosExpr : public UnaryExpression<double, Expression<double>> {
 		CosExpr(Expression<double>* a) : UnaryExpression<double, Expression<double>>(a) {}
 		inline double value() { return cos(arg->value()); }
+		uint32_t compile(ExpressionCompiler& c) { return c.unary(OP_COS, arg->compile(c)); }
 	};
 
 // ------------ JOINT STUFF ----------------
@@ -115,69 +128,80 @@ template <typename A>
 	};
 
 	struct PositionExpr : public UnaryJointExpr<double> {
-		PositionExpr(sensor_msgs::JointState &state, size_t _idx)
+		PositionExpr(JointArrays &state, size_t _idx)
 		: UnaryJointExpr<double>(state, _idx) {}
 		inline double value() {return state.position[idx]; }
+		uint32_t compile(ExpressionCompiler& c) { return c.load(OP_LOAD_POS, idx); }
 	};
 
 	struct VelocityExpr : public UnaryJointExpr<double> {
-		VelocityExpr(sensor_msgs::JointState &state, size_t _idx)
+		VelocityExpr(JointArrays &state, size_t _idx)
 		: UnaryJointExpr<double>(state, _idx) {}
 		inline double value() {return state.velocity[idx]; }
+		uint32_t compile(ExpressionCompiler& c) { return c.load(OP_LOAD_VEL, idx); }
 	};
 
 	struct EffortExpr : public UnaryJointExpr<double> {
-		EffortExpr(sensor_msgs::JointState &state, size_t _idx)
+		EffortExpr(JointArrays &state, size_t _idx)
 		: UnaryJointExpr<double>(state, _idx) {}
 		inline double value() {return state.effort[idx]; }
+		uint32_t compile(ExpressionCompiler& c) { return c.load(OP_LOAD_EFF, idx); }
 	};
 
 	struct PositionFracExpr : public UnaryJointExpr<double>, JointLimitContainer {
-		PositionFracExpr(sensor_msgs::JointState &state, size_t _idx, LimitPtr ptr)
+		PositionFracExpr(JointArrays &state, size_t _idx, LimitPtr ptr)
 		: UnaryJointExpr<double>(state, _idx), JointLimitContainer(ptr) {}
 		inline double value() { return (state.position[idx] - limits->lower) / (limits->upper - limits->lower); }
+		uint32_t compile(ExpressionCompiler& c) { return c.binary(OP_DIV, c.binary(OP_SUB, c.load(OP_LOAD_POS, idx), c.constant(limits->lower)), c.constant(limits->upper - limits->lower)); }
 	};
 
 	struct VelocityFracExpr : public UnaryJointExpr<double>, JointLimitContainer {
-		VelocityFracExpr(sensor_msgs::JointState &state, size_t _idx, LimitPtr ptr)
+		VelocityFracExpr(JointArrays &state, size_t _idx, LimitPtr ptr)
 		: UnaryJointExpr<double>(state, _idx), JointLimitContainer(ptr) {}
 		inline double value() { return state.velocity[idx] / limits->velocity; }
+		uint32_t compile(ExpressionCompiler& c) { return c.binary(OP_DIV, c.load(OP_LOAD_VEL, idx), c.constant(limits->velocity)); }
 	};
 
 	struct EffortFracExpr : public UnaryJointExpr<double>, JointLimitContainer {
-		EffortFracExpr(sensor_msgs::JointState &state, size_t _idx, LimitPtr ptr)
+		EffortFracExpr(JointArrays &state, size_t _idx, LimitPtr ptr)
 		: UnaryJointExpr<double>(state, _idx), JointLimitContainer(ptr) {}
 		inline double value() { return state.effort[idx] / limits->effort; }
+		uint32_t compile(ExpressionCompiler& c) { return c.binary(OP_DIV, c.load(OP_LOAD_EFF, idx), c.constant(limits->effort)); }
 	};
 
 	struct PosUpLimitExpr : public Expression<double>, JointLimitContainer {
 		PosUpLimitExpr(LimitPtr ptr)
 		: JointLimitContainer(ptr) {}
 		inline double value() { return limits->upper; }
+		uint32_t compile(ExpressionCompiler& c) { return c.constant(limits->upper); }
 	};
 
 	struct PosLowLimitExpr : public Expression<double>, JointLimitContainer {
 		PosLowLimitExpr(LimitPtr ptr)
 		: JointLimitContainer(ptr) {}
 		inline double value() { return limits->lower; }
+		uint32_t compile(ExpressionCompiler& c) { return c.constant(limits->lower); }
 	};
 
 	struct PosLimitSpreadExpr : public Expression<double>, JointLimitContainer {
 		PosLimitSpreadExpr(LimitPtr ptr)
 		: JointLimitContainer(ptr) {}
 		inline double value() { return limits->upper - limits->lower; }
+		uint32_t compile(ExpressionCompiler& c) { return c.constant(limits->upper - limits->lower); }
 	};
 
 	struct VelocityLimitExpr : public Expression<double>, JointLimitContainer {
 		VelocityLimitExpr(LimitPtr ptr)
 		: JointLimitContainer(ptr) {}
 		inline double value() { return limits->velocity; }
+		uint32_t compile(ExpressionCompiler& c) { return c.constant(limits->velocity); }
 	};
 
 	struct EffortLimitExpr : public Expression<double>, JointLimitContainer {
 		EffortLimitExpr(LimitPtr ptr)
 		: JointLimitContainer(ptr) {}
 		inline double value() { return limits->effort; }
+		uint32_t compile(ExpressionCompiler& c) { return c.constant(limits->effort); }
 	};
 
 	class Simulator;
@@ -190,6 +214,15 @@ template <typename A>
 					   unordered_map<size_t, Expression<double>*>& posExprs,
 					   unordered_map<size_t, Expression<double>*>& velExprs,
 					   unordered_map<size_t, Expression<double>*>& effExprs);
+
+		/**
+		 * Lowers the position, velocity and effort expressions into one program in
+		 * which every fake joint value comes after the fake joint values it reads.
+		 * Throws if fake joint values read each other in a cycle.
+		 */
+		ExpressionProgram compile(const unordered_map<size_t, Expression<double>*>& posExprs,
+								  const unordered_map<size_t, Expression<double>*>& velExprs,
+								  const unordered_map<size_t, Expression<double>*>& effExprs);
 	private:
 		Expression<double>* parseDoubleExpr(const YAML::Node& node);
 		AddExpr* parseAddExpr(const YAML::Node& node);
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_FREE_RUNNING_LOOP_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_FREE_RUNNING_LOOP_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace iai_naive_kinematics_sim
+{
+  // keeps a simulated clock from running ahead of the subscribers that acknowledge it: the
+  // clock may advance to a stamp only if no subscriber's latest acknowledged stamp lags
+  // behind it by more than the maximum lead; subscribers that hold the clock back without
+  // acknowledging anything for longer than the timeout are forgotten until they acknowledge
+  // again; all times are in ns, not thread-safe
+  class ClockThrottle
+  {
+    public:
+      // a timeout of 0 never forgets subscribers
+      ClockThrottle(int64_t max_lead = 0, int64_t timeout = 0) :
+        max_lead_(max_lead), timeout_(timeout) {}
+
+      // waits for the named subscriber before the clock advances the first time
+      void expect(const std::string& name, int64_t wall_now)
+      {
+        Subscriber& subscriber = subscribers_[name];
+        subscriber.acknowledged = false;
+        subscriber.stamp = 0;
+        subscriber.wall_time = wall_now;
+      }
+
+      void acknowledge(const std::string& name, int64_t stamp, int64_t wall_now)
+      {
+        Subscriber& subscriber = subscribers_[name];
+        if (!subscriber.acknowledged || stamp > subscriber.stamp)
+          subscriber.stamp = stamp;
+        subscriber.acknowledged = true;
+        subscriber.wall_time = wall_now;
+      }
+
+      // restarts the timeouts of all subscribers
+      void restartTimeouts(int64_t wall_now)
+      {
+        for (std::map<std::string, Subscriber>::iterator it=subscribers_.begin();
+            it!=subscribers_.end(); ++it)
+          it->second.wall_time = wall_now;
+      }
+
+      bool mayAdvance(int64_t stamp) const
+      {
+        for (std::map<std::string, Subscriber>::const_iterator it=subscribers_.begin();
+            it!=subscribers_.end(); ++it)
+          if (holdsBack(it->second, stamp))
+            return false;
+
+        return true;
+      }
+
+      // forgets the subscribers that held back advancing to stamp for too long, and returns
+      // their names
+      std::vector<std::string> dropStale(int64_t stamp, int64_t wall_now)
+      {
+        std::vector<std::string> dropped;
+        if (timeout_ <= 0)
+          return dropped;
+
+        for (std::map<std::string, Subscriber>::iterator it=subscribers_.begin();
+            it!=subscribers_.end();)
+          if (holdsBack(it->second, stamp) && wall_now - it->second.wall_time > timeout_)
+          {
+            dropped.push_back(it->first);
+            subscribers_.erase(it++);
+          }
+          else
+            ++it;
+
+        return dropped;
+      }
+
+      size_t size() const
+      {
+        return subscribers_.size();
+      }
+
+    private:
+      struct Subscriber
+      {
+        bool acknowledged;
+        int64_t stamp, wall_time;
+      };
+
+      int64_t max_lead_, timeout_;
+      std::map<std::string, Subscriber> subscribers_;
+
+      bool holdsBack(const Subscriber& subscriber, int64_t stamp) const
+      {
+        return !subscriber.acknowledged || stamp - subscriber.stamp > max_lead_;
+      }
+  };
+
+  // advances a simulated clock from a dedicated thread by a fixed period per tick, either
+  // as fast as possible or at a fixed factor of wall time, but never ahead of a ClockThrottle
+  class FreeRunningLoop
+  {
+    public:
+      // gets the stamp of the tick in ns; must not throw
+      typedef std::function<void(int64_t stamp)> Tick;
+
+      FreeRunningLoop() : running_(false), now_(0), ticks_(0) {}
+
+      ~FreeRunningLoop()
+      {
+        stop();
+      }
+
+      // the first tick is stamped start + period; a real-time factor <= 0 runs as fast as
+      // possible; the timeouts of the subscribers of throttle start now
+      void start(int64_t start, int64_t period, double real_time_factor,
+          const ClockThrottle& throttle, const Tick& tick)
+      {
+        if (period <= 0)
+          throw std::runtime_error("Asked to start a free-running loop with a non-positive period.");
+        stop();
+
+        period_ = period;
+        real_time_factor_ = real_time_factor;
+        throttle_ = throttle;
+        throttle_.restartTimeouts(wallNow());
+        tick_ = tick;
+        dropped_.clear();
+        now_ = start;
+        ticks_ = 0;
+        running_ = true;
+        thread_ = std::thread(&FreeRunningLoop::run, this);
+      }
+
+      void stop()
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          running_ = false;
+        }
+        throttled_.notify_all();
+        if (thread_.joinable())
+          thread_.join();
+      }
+
+      bool isRunning() const
+      {
+        return running_;
+      }
+
+      // may be called from any thread
+      void acknowledge(const std::string& name, int64_t stamp)
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          throttle_.acknowledge(name, stamp, wallNow());
+        }
+        throttled_.notify_all();
+      }
+
+      // stamp of the latest tick, or the start before the first one
+      int64_t now() const
+      {
+        return now_.load(std::memory_order_acquire);
+      }
+
+      uint64_t ticks() const
+      {
+        return ticks_.load(std::memory_order_relaxed);
+      }
+
+      // names of the subscribers that were forgotten since the last call
+      std::vector<std::string> popDropped()
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::string> dropped;
+        dropped.swap(dropped_);
+        return dropped;
+      }
+
+    private:
+      std::thread thread_;
+      std::mutex mutex_;
+      std::condition_variable throttled_;
+      // guarded by mutex_, but also read without it
+      std::atomic<bool> running_;
+      int64_t period_;
+      double real_time_factor_;
+      Tick tick_;
+      std::atomic<int64_t> now_;
+      std::atomic<uint64_t> ticks_;
+
+      // guarded by mutex_
+      ClockThrottle throttle_;
+      std::vector<std::string> dropped_;
+
+      // not copyable, because it owns the thread
+      FreeRunningLoop(const FreeRunningLoop&);
+      FreeRunningLoop& operator=(const FreeRunningLoop&);
+
+      static int64_t wallNow()
+      {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+      }
+
+      // blocks until the throttle lets the clock advance to stamp; false if stopped before
+      bool waitForSubscribers(int64_t stamp)
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (running_)
+        {
+          std::vector<std::string> dropped = throttle_.dropStale(stamp, wallNow());
+          dropped_.insert(dropped_.end(), dropped.begin(), dropped.end());
+          if (throttle_.mayAdvance(stamp))
+            return true;
+
+          // wake up now and then to notice subscribers that time out
+          throttled_.wait_for(lock, std::chrono::milliseconds(10));
+        }
+
+        return false;
+      }
+
+      void run()
+      {
+        // wall time at which the clock is due to reach base_stamp
+        int64_t base_wall = wallNow(), base_stamp = now_;
+
+        while (running_)
+        {
+          int64_t stamp = now_ + period_;
+          if (!waitForSubscribers(stamp))
+            return;
+
+          if (real_time_factor_ > 0)
+          {
+            int64_t wall_period = static_cast<int64_t>(period_ / real_time_factor_);
+            int64_t deadline = base_wall +
+              static_cast<int64_t>((stamp - base_stamp) / real_time_factor_);
+            int64_t wall_now = wallNow();
+            // after falling behind, e.g. waiting for subscribers, keep the factor from here
+            // on rather than catching up
+            if (wall_now > deadline + wall_period)
+            {
+              base_wall = wall_now;
+              base_stamp = stamp;
+            }
+            else if (wall_now < deadline)
+              std::this_thread::sleep_for(std::chrono::nanoseconds(deadline - wall_now));
+          }
+
+          tick_(stamp);
+          now_.store(stamp, std::memory_order_release);
+          ticks_.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+  };
+}
+
+#endif
@@ -29,9 +29,29 @@
 #ifndef IAI_NAIVE_KINEMATICS_SIM_IAI_NAIVE_KINEMATICS_SIM_HPP
 #define IAI_NAIVE_KINEMATICS_SIM_IAI_NAIVE_KINEMATICS_SIM_HPP
 
+#include <iai_naive_kinematics_sim/batch_simulator.hpp>
+#include <iai_naive_kinematics_sim/command_inbox.hpp>
+#include <iai_naive_kinematics_sim/command_queue.hpp>
+#include <iai_naive_kinematics_sim/free_running_loop.hpp>
+#include <iai_naive_kinematics_sim/instrumentation.hpp>
+#include <iai_naive_kinematics_sim/kinematics_sim.hpp>
+#include <iai_naive_kinematics_sim/latency_histogram.hpp>
+#include <iai_naive_kinematics_sim/lockstep_barrier.hpp>
+#include <iai_naive_kinematics_sim/publish_throttle.hpp>
+#include <iai_naive_kinematics_sim/realtime_loop.hpp>
+#include <iai_naive_kinematics_sim/robot_generator.hpp>
+#include <iai_naive_kinematics_sim/rollout_scheduler.hpp>
+#include <iai_naive_kinematics_sim/shared_memory_state.hpp>
 #include <iai_naive_kinematics_sim/simulator.hpp>
 #include <iai_naive_kinematics_sim/simulator_node.hpp>
+#include <iai_naive_kinematics_sim/snapshot_store.hpp>
+#include <iai_naive_kinematics_sim/threads.hpp>
+#include <iai_naive_kinematics_sim/tick_tasks.hpp>
+#include <iai_naive_kinematics_sim/trajectory_recorder.hpp>
+#include <iai_naive_kinematics_sim/trajectory_replay.hpp>
 #include <iai_naive_kinematics_sim/utils.hpp>
 #include <iai_naive_kinematics_sim/watchdog.hpp>
+#include <iai_naive_kinematics_sim/watchdog_manager.hpp>
+#include <iai_naive_kinematics_sim/work_stealing_pool.hpp>
 
 #endif
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_INSTRUMENTATION_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_INSTRUMENTATION_HPP
+
+#include <iai_naive_kinematics_sim/latency_histogram.hpp>
+#include <chrono>
+
+namespace iai_naive_kinematics_sim
+{
+  // stages of the simulation whose latencies are recorded
+  enum InstrumentationStage
+  {
+    STAGE_TICK,               // one tick of the simulation, from applying commands to publishing
+    STAGE_UPDATE,             // Simulator::update
+    STAGE_FAKE_CONTROLLERS,   // evaluating the fake controllers within an update
+    STAGE_COMMAND_RECEIVE,    // queueing a received command
+    STAGE_COMMAND_APPLY,      // applying the queued commands at the start of a tick
+    STAGE_PUBLISH,            // serializing and publishing the state
+    NUM_STAGES
+  };
+
+  // latency histograms of the stages of the simulation, and the number of ticks that took
+  // longer than their period; with IAI_NAIVE_KINEMATICS_SIM_NO_INSTRUMENTATION defined
+  // nothing is ever recorded
+  class Instrumentation
+  {
+    public:
+      Instrumentation() : overruns_(0) {}
+
+      static const char* stageName(InstrumentationStage stage)
+      {
+        static const char* names[NUM_STAGES] = {"tick", "update", "fake_controllers",
+          "command_receive", "command_apply", "publish"};
+        return names[stage];
+      }
+
+      static uint64_t now()
+      {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+      }
+
+      void record(InstrumentationStage stage, uint64_t nanoseconds)
+      {
+#ifndef IAI_NAIVE_KINEMATICS_SIM_NO_INSTRUMENTATION
+        histograms_[stage].record(nanoseconds);
+#endif
+      }
+
+      void recordOverrun()
+      {
+#ifndef IAI_NAIVE_KINEMATICS_SIM_NO_INSTRUMENTATION
+        overruns_.fetch_add(1, std::memory_order_relaxed);
+#endif
+      }
+
+      const LatencyHistogram& histogram(InstrumentationStage stage) const
+      {
+        return histograms_[stage];
+      }
+
+      uint64_t overruns() const
+      {
+        return overruns_.load(std::memory_order_relaxed);
+      }
+
+      void reset()
+      {
+        for (size_t i=0; i<NUM_STAGES; ++i)
+          histograms_[i].reset();
+        overruns_.store(0, std::memory_order_relaxed);
+      }
+
+    private:
+      LatencyHistogram histograms_[NUM_STAGES];
+      std::atomic<uint64_t> overruns_;
+  };
+
+  // records the time from its construction to its destruction as a latency of the given
+  // stage, unless the instrumentation is null or the timer is discarded
+  class ScopedTimer
+  {
+    public:
+#ifndef IAI_NAIVE_KINEMATICS_SIM_NO_INSTRUMENTATION
+      ScopedTimer(Instrumentation* instrumentation, InstrumentationStage stage) :
+        instrumentation_(instrumentation), stage_(stage),
+        start_(instrumentation ? Instrumentation::now() : 0) {}
+
+      ~ScopedTimer()
+      {
+        if (instrumentation_)
+          instrumentation_->record(stage_, elapsed());
+      }
+
+      // nanoseconds since construction
+      uint64_t elapsed() const
+      {
+        return instrumentation_ ? Instrumentation::now() - start_ : 0;
+      }
+
+      void discard()
+      {
+        instrumentation_ = 0;
+      }
+
+    private:
+      Instrumentation* instrumentation_;
+      InstrumentationStage stage_;
+      uint64_t start_;
+#else
+      ScopedTimer(Instrumentation*, InstrumentationStage) {}
+
+      uint64_t elapsed() const
+      {
+        return 0;
+      }
+
+      void discard() {}
+#endif
+
+      ScopedTimer(const ScopedTimer&) = delete;
+      ScopedTimer& operator=(const ScopedTimer&) = delete;
+  };
+}
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_JOINT_ARRAYS_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_JOINT_ARRAYS_HPP
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace iai_naive_kinematics_sim
+{
+  // allocator that aligns its memory for the widest vector registers we use
+  template <class T, size_t Alignment = 32>
+  class AlignedAllocator
+  {
+    public:
+      typedef T value_type;
+
+      template <class U>
+      struct rebind
+      {
+        typedef AlignedAllocator<U, Alignment> other;
+      };
+
+      AlignedAllocator() {}
+
+      template <class U>
+      AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+      T* allocate(size_t n)
+      {
+        void* ptr = 0;
+        if (posix_memalign(&ptr, Alignment, std::max(n, size_t(1)) * sizeof(T)) != 0)
+          throw std::bad_alloc();
+        return static_cast<T*>(ptr);
+      }
+
+      void deallocate(T* ptr, size_t)
+      {
+        free(ptr);
+      }
+  };
+
+  template <class T, class U, size_t Alignment>
+  inline bool operator==(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&)
+  {
+    return true;
+  }
+
+  template <class T, class U, size_t Alignment>
+  inline bool operator!=(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&)
+  {
+    return false;
+  }
+
+  typedef std::vector<double, AlignedAllocator<double> > AlignedVector;
+
+  // joint positions, velocities and efforts stored as a structure of arrays
+  struct JointArrays
+  {
+    AlignedVector position, velocity, effort;
+
+    size_t size() const
+    {
+      return position.size();
+    }
+
+    void resize(size_t size)
+    {
+      position.resize(size, 0.0);
+      velocity.resize(size, 0.0);
+      effort.resize(size, 0.0);
+    }
+  };
+
+  // lower and upper position limits of the joints; joints without position limits
+  // get infinite bounds, so that the clamping kernel does not need to branch on them
+  struct JointLimitArrays
+  {
+    AlignedVector lower, upper;
+
+    size_t size() const
+    {
+      return lower.size();
+    }
+
+    void resize(size_t size)
+    {
+      lower.resize(size, -std::numeric_limits<double>::infinity());
+      upper.resize(size, std::numeric_limits<double>::infinity());
+    }
+  };
+
+  // clamps a single joint into its position limits, and stops it if it had to be clamped;
+  // a NaN position is left alone
+  inline void clampJoint(double& position, double& velocity, double lower, double upper)
+  {
+    if (position < lower || position > upper)
+    {
+      position = std::max(lower, std::min(position, upper));
+      velocity = 0.0;
+    }
+  }
+
+  // integrates positions with their velocities over dt, and clamps all joints into their
+  // position limits; joints that had to be clamped get their velocity set to zero
+  inline void integrateAndClamp(double* position, double* velocity, const double* lower,
+      const double* upper, size_t size, double dt)
+  {
+    size_t i = 0;
+
+#if defined(__AVX__)
+    const __m256d dt_v = _mm256_set1_pd(dt);
+    for (; i + 4 <= size; i += 4)
+    {
+      __m256d pos = _mm256_loadu_pd(position + i);
+      __m256d vel = _mm256_loadu_pd(velocity + i);
+      __m256d low = _mm256_loadu_pd(lower + i);
+      __m256d up = _mm256_loadu_pd(upper + i);
+
+      pos = _mm256_add_pd(pos, _mm256_mul_pd(vel, dt_v));
+      __m256d outside = _mm256_or_pd(_mm256_cmp_pd(pos, low, _CMP_LT_OQ),
+          _mm256_cmp_pd(pos, up, _CMP_GT_OQ));
+      // min and max return their second operand if either is NaN, so a NaN position stays
+      // NaN like in clampJoint
+      pos = _mm256_max_pd(low, _mm256_min_pd(up, pos));
+      vel = _mm256_andnot_pd(outside, vel);
+
+      _mm256_storeu_pd(position + i, pos);
+      _mm256_storeu_pd(velocity + i, vel);
+    }
+#elif defined(__SSE2__)
+    const __m128d dt_v = _mm_set1_pd(dt);
+    for (; i + 2 <= size; i += 2)
+    {
+      __m128d pos = _mm_loadu_pd(position + i);
+      __m128d vel = _mm_loadu_pd(velocity + i);
+      __m128d low = _mm_loadu_pd(lower + i);
+      __m128d up = _mm_loadu_pd(upper + i);
+
+      pos = _mm_add_pd(pos, _mm_mul_pd(vel, dt_v));
+      __m128d outside = _mm_or_pd(_mm_cmplt_pd(pos, low), _mm_cmpgt_pd(pos, up));
+      pos = _mm_max_pd(low, _mm_min_pd(up, pos));
+      vel = _mm_andnot_pd(outside, vel);
+
+      _mm_storeu_pd(position + i, pos);
+      _mm_storeu_pd(velocity + i, vel);
+    }
+#endif
+
+    for (; i < size; ++i)
+    {
+      position[i] += velocity[i] * dt;
+      clampJoint(position[i], velocity[i], lower[i], upper[i]);
+    }
+  }
+
+  inline void integrateAndClamp(JointArrays& state, const JointLimitArrays& limits, double dt)
+  {
+    integrateAndClamp(state.position.data(), state.velocity.data(), limits.lower.data(),
+        limits.upper.data(), state.size(), dt);
+  }
+}
+
+#endif
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_KINEMATICS_SIM_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_KINEMATICS_SIM_HPP
+
+// only standard headers, so that processes can embed the simulator without building against ROS
+#include <iai_naive_kinematics_sim/layout_cache.hpp>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace iai_naive_kinematics_sim
+{
+  class Simulator;
+  struct SimulatorSnapshot;
+
+  // the parameters of the simulator node with the same names; fake_controllers is the YAML
+  // text of a fake controller configuration, or empty for none
+  struct KinematicsSimConfig
+  {
+    KinematicsSimConfig() : watchdog_period(0.1) {}
+
+    std::vector<std::string> simulated_joints, controlled_joints;
+    double watchdog_period;
+    std::map<std::string, double> watchdog_periods;
+    std::map<std::string, std::vector<std::string> > watchdog_groups;
+    std::string fake_controllers;
+    std::map<std::string, double> start_config;
+  };
+
+  // the state of a KinematicsSim, see KinematicsSim::snapshot
+  class KinematicsSimSnapshot
+  {
+    public:
+      KinematicsSimSnapshot();
+      KinematicsSimSnapshot(const KinematicsSimSnapshot& other);
+      KinematicsSimSnapshot& operator=(const KinematicsSimSnapshot& other);
+      ~KinematicsSimSnapshot();
+
+    private:
+      friend class KinematicsSim;
+      std::unique_ptr<SimulatorSnapshot> snapshot_;
+  };
+
+  // the simulator behind a ROS-free interface, for processes that embed it, e.g. to project
+  // without going through the simulator node; joint values are plain arrays in the order of
+  // a layout from resolveLayout(), or of getJointNames(); times are in ns on any monotonic
+  // clock, e.g. Clock; copies are forks, see Simulator
+  class KinematicsSim
+  {
+    public:
+      typedef std::chrono::steady_clock Clock;
+
+      KinematicsSim();
+      KinematicsSim(const KinematicsSim& other);
+      KinematicsSim& operator=(const KinematicsSim& other);
+      ~KinematicsSim();
+
+      // sets up the simulation of the robot in the URDF XML like the simulator node does,
+      // including the start configuration
+      void init(const std::string& urdf, const KinematicsSimConfig& config);
+      void initFile(const std::string& urdf_path, const KinematicsSimConfig& config);
+
+      size_t size() const;
+      const std::vector<std::string>& getJointNames() const;
+
+      JointLayout resolveLayout(const std::vector<std::string>& names) const;
+
+      // throws if the layout names joints that are not simulated; efforts may be null to keep
+      // the current efforts
+      void setState(const JointLayout& layout, const double* positions,
+          const double* velocities, const double* efforts);
+
+      // joints that are not simulated or not controlled are skipped
+      void setCommand(const JointLayout& layout, const double* velocities, int64_t now);
+      void setCommand(const JointLayout& layout, const double* velocities,
+          Clock::time_point now);
+
+      // simulates the period dt up to now, in the given number of steps
+      void update(int64_t now, int64_t dt, size_t substeps = 1);
+      void update(Clock::time_point now, Clock::duration dt, size_t substeps = 1);
+
+      // by joint index, valid until the simulator is changed
+      const double* getPositions() const;
+      const double* getVelocities() const;
+      const double* getEfforts() const;
+
+      // time stamp and sequence number of the state
+      int64_t getStamp() const;
+      uint32_t getSequence() const;
+
+      void snapshot(KinematicsSimSnapshot& snapshot) const;
+      void restore(const KinematicsSimSnapshot& snapshot);
+
+      // names of the controlled joints whose watchdog expired since the last call
+      std::vector<std::string> popExpiredWatchdogs();
+
+      // the simulator behind the interface, for users that build against ROS anyway
+      Simulator& simulator();
+      const Simulator& simulator() const;
+
+    private:
+      std::unique_ptr<Simulator> sim_;
+  };
+}
+
+#endif
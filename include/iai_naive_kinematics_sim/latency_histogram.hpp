@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_LATENCY_HISTOGRAM_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_LATENCY_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace iai_naive_kinematics_sim
+{
+  // copy of the counts of a LatencyHistogram; all values are in nanoseconds and, except for
+  // the mean, accurate to the resolution of the buckets, i.e. about 3%
+  struct LatencySnapshot
+  {
+    LatencySnapshot() : count(0), sum(0) {}
+
+    std::vector<uint64_t> counts;
+    uint64_t count, sum;
+
+    double mean() const
+    {
+      return count == 0 ? 0.0 : static_cast<double>(sum) / count;
+    }
+
+    uint64_t min() const;
+    uint64_t max() const;
+
+    // smallest value that at least the given fraction of the recorded values do not exceed
+    uint64_t percentile(double fraction) const;
+
+    // the values recorded since the given earlier snapshot of the same histogram
+    LatencySnapshot operator-(const LatencySnapshot& other) const
+    {
+      if (other.counts.size() != counts.size())
+        throw std::runtime_error("Subtracted latency snapshots of different sizes.");
+
+      LatencySnapshot result;
+      result.counts.resize(counts.size());
+      for (size_t i=0; i<counts.size(); ++i)
+        result.counts[i] = counts[i] - other.counts[i];
+      result.count = count - other.count;
+      result.sum = sum - other.sum;
+      return result;
+    }
+  };
+
+  // lock-free histogram of latencies in the style of HdrHistogram: values up to 63ns get a
+  // bucket each, larger values share a bucket with the values that agree in their highest 6
+  // bits; any number of threads may record into it while others take snapshots
+  class LatencyHistogram
+  {
+    public:
+      static const size_t SUB_BUCKET_BITS = 5;
+      static const size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+      // values below 2^41ns, i.e. about 36 minutes; larger ones go to the last bucket
+      static const size_t MAX_BITS = 40;
+      static const size_t BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+      LatencyHistogram() : counts_(new std::atomic<uint64_t>[BUCKETS]), sum_(0)
+      {
+        for (size_t i=0; i<BUCKETS; ++i)
+          counts_[i].store(0, std::memory_order_relaxed);
+      }
+
+      ~LatencyHistogram()
+      {
+        delete[] counts_;
+      }
+
+      LatencyHistogram(const LatencyHistogram&) = delete;
+      LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+      void record(uint64_t nanoseconds)
+      {
+        counts_[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(nanoseconds, std::memory_order_relaxed);
+      }
+
+      LatencySnapshot snapshot() const
+      {
+        LatencySnapshot result;
+        result.counts.resize(BUCKETS);
+        for (size_t i=0; i<BUCKETS; ++i)
+        {
+          result.counts[i] = counts_[i].load(std::memory_order_relaxed);
+          result.count += result.counts[i];
+        }
+        result.sum = sum_.load(std::memory_order_relaxed);
+        return result;
+      }
+
+      // not atomic with respect to concurrent records, which may survive partially
+      void reset()
+      {
+        for (size_t i=0; i<BUCKETS; ++i)
+          counts_[i].store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+      }
+
+      static size_t bucketIndex(uint64_t value)
+      {
+        if (value < 2 * SUB_BUCKETS)
+          return value;
+
+        size_t msb = 63 - __builtin_clzll(value);
+        if (msb > MAX_BITS)
+          return BUCKETS - 1;
+        size_t shift = msb - SUB_BUCKET_BITS;
+        return shift * SUB_BUCKETS + (value >> shift);
+      }
+
+      static uint64_t bucketLowerBound(size_t index)
+      {
+        if (index < 2 * SUB_BUCKETS)
+          return index;
+
+        size_t shift = index / SUB_BUCKETS - 1;
+        return static_cast<uint64_t>(index % SUB_BUCKETS + SUB_BUCKETS) << shift;
+      }
+
+      // largest value that falls into the given bucket
+      static uint64_t bucketUpperBound(size_t index)
+      {
+        if (index < 2 * SUB_BUCKETS)
+          return index;
+
+        size_t shift = index / SUB_BUCKETS - 1;
+        return bucketLowerBound(index) + (static_cast<uint64_t>(1) << shift) - 1;
+      }
+
+    private:
+      std::atomic<uint64_t>* counts_;
+      std::atomic<uint64_t> sum_;
+  };
+
+  inline uint64_t LatencySnapshot::min() const
+  {
+    for (size_t i=0; i<counts.size(); ++i)
+      if (counts[i] > 0)
+        return LatencyHistogram::bucketLowerBound(i);
+    return 0;
+  }
+
+  inline uint64_t LatencySnapshot::max() const
+  {
+    for (size_t i=counts.size(); i>0; --i)
+      if (counts[i-1] > 0)
+        return LatencyHistogram::bucketUpperBound(i-1);
+    return 0;
+  }
+
+  inline uint64_t LatencySnapshot::percentile(double fraction) const
+  {
+    if (count == 0)
+      return 0;
+
+    uint64_t rank = static_cast<uint64_t>(fraction * count + 0.5);
+    rank = std::max<uint64_t>(1, std::min(rank, count));
+    uint64_t seen = 0;
+    for (size_t i=0; i<counts.size(); ++i)
+    {
+      seen += counts[i];
+      if (seen >= rank)
+        return LatencyHistogram::bucketUpperBound(i);
+    }
+    return max();
+  }
+}
+
+#endif
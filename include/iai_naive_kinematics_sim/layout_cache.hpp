@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_LAYOUT_CACHE_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_LAYOUT_CACHE_HPP
+
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace iai_naive_kinematics_sim
+{
+  // where the joints named in a message live in the simulator: joints[i] is the index of the
+  // state of name[i], slots[i] its watchdog slot; NONE marks unknown or uncontrolled joints
+  struct JointLayout
+  {
+    static const size_t NONE = static_cast<size_t>(-1);
+
+    std::vector<std::string> names;
+    std::vector<size_t> joints, slots;
+  };
+
+  inline JointLayout resolveJointLayout(const std::vector<std::string>& names,
+      const std::map<std::string, size_t>& index_map,
+      const std::map<std::string, size_t>& watchdog_index_map)
+  {
+    JointLayout layout;
+    layout.names = names;
+    for (size_t i=0; i<names.size(); ++i)
+    {
+      size_t joint = JointLayout::NONE, slot = JointLayout::NONE;
+      std::map<std::string, size_t>::const_iterator it = index_map.find(names[i]);
+      if (it != index_map.end())
+        joint = it->second;
+      it = watchdog_index_map.find(names[i]);
+      if (it != watchdog_index_map.end())
+        slot = it->second;
+      layout.joints.push_back(joint);
+      layout.slots.push_back(slot);
+    }
+
+    return layout;
+  }
+
+  // throws the same error as a name lookup would have, if the layout names an unknown joint
+  inline void checkJointsKnown(const JointLayout& layout)
+  {
+    for (size_t i=0; i<layout.joints.size(); ++i)
+      if (layout.joints[i] == JointLayout::NONE)
+        throw std::runtime_error("Could not find joint index for joint with name '" +
+            layout.names[i] + "'.");
+  }
+
+  // 64 bit FNV-1a hash of a list of names, including their terminating '\0'
+  inline uint64_t nameFingerprint(const std::vector<std::string>& names)
+  {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i=0; i<names.size(); ++i)
+      for (size_t j=0; j<=names[i].size(); ++j)
+      {
+        hash ^= static_cast<unsigned char>(names[i].c_str()[j]);
+        hash *= 1099511628211ull;
+      }
+
+    return hash;
+  }
+
+  // remembers the layouts of the last few distinct name lists, looked up by fingerprint; the
+  // names are compared as well, so colliding fingerprints cannot mix up layouts
+  class LayoutCache
+  {
+    public:
+      typedef std::shared_ptr<const JointLayout> LayoutPtr;
+
+      LayoutCache(size_t capacity = 8) : capacity_(capacity), next_(0)
+      {
+        if (capacity == 0)
+          throw std::runtime_error("Asked to create a layout cache without capacity.");
+      }
+
+      ~LayoutCache() {}
+
+      size_t size() const
+      {
+        return entries_.size();
+      }
+
+      // returns the cached layout for names, or an empty pointer
+      LayoutPtr find(const std::vector<std::string>& names) const
+      {
+        uint64_t fingerprint = nameFingerprint(names);
+        for (size_t i=0; i<entries_.size(); ++i)
+          if (entries_[i].fingerprint == fingerprint && entries_[i].layout->names == names)
+            return entries_[i].layout;
+
+        return LayoutPtr();
+      }
+
+      // adds a layout, replacing the oldest one if the cache is full
+      LayoutPtr insert(const JointLayout& layout)
+      {
+        Entry entry;
+        entry.fingerprint = nameFingerprint(layout.names);
+        entry.layout.reset(new JointLayout(layout));
+
+        if (entries_.size() < capacity_)
+          entries_.push_back(entry);
+        else
+        {
+          entries_[next_] = entry;
+          next_ = (next_ + 1) % capacity_;
+        }
+
+        return entry.layout;
+      }
+
+      void clear()
+      {
+        entries_.clear();
+        next_ = 0;
+      }
+
+    private:
+      struct Entry
+      {
+        uint64_t fingerprint;
+        LayoutPtr layout;
+      };
+
+      size_t capacity_, next_;
+      std::vector<Entry> entries_;
+  };
+}
+
+#endif
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_LOCKSTEP_BARRIER_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_LOCKSTEP_BARRIER_HPP
+
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace iai_naive_kinematics_sim
+{
+  // waits once per projection tick for a command from each of a fixed set of sources; the
+  // barrier opens with the stamp of the state that was just simulated, and releases exactly
+  // once, either when every source has sent a command stamped at least that late, or when
+  // the timeout has passed; all times are in ns, thread-safe
+  class LockstepBarrier
+  {
+    public:
+      LockstepBarrier() : pending_(0), timeout_(0), stamp_(0), deadline_(0), open_(false) {}
+
+      // a timeout of 0 waits forever
+      void init(const std::vector<std::string>& sources, int64_t timeout)
+      {
+        if (sources.empty())
+          throw std::runtime_error("Asked to wait for an empty set of command sources.");
+        if (timeout < 0)
+          throw std::runtime_error("Asked to wait for command sources with a negative timeout.");
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        arrived_.clear();
+        for (size_t i=0; i<sources.size(); ++i)
+          if (!arrived_.insert(std::make_pair(sources[i], false)).second)
+            throw std::runtime_error("Asked to wait for command source '" + sources[i] +
+                "' twice.");
+        timeout_ = timeout;
+        open_ = false;
+      }
+
+      // starts waiting for the commands that answer the state at stamp; a barrier that was
+      // still open is abandoned without releasing it
+      void open(int64_t stamp, int64_t wall_now)
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (std::map<std::string, bool>::iterator it=arrived_.begin(); it!=arrived_.end(); ++it)
+          it->second = false;
+        pending_ = arrived_.size();
+        stamp_ = stamp;
+        deadline_ = wall_now + timeout_;
+        open_ = true;
+      }
+
+      // true if this command releases the barrier; commands from unknown sources, with older
+      // stamps, or while the barrier is closed are ignored
+      bool arrive(const std::string& source, int64_t stamp)
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!open_ || stamp < stamp_)
+          return false;
+
+        std::map<std::string, bool>::iterator it = arrived_.find(source);
+        if (it == arrived_.end() || it->second)
+          return false;
+
+        it->second = true;
+        if (--pending_ > 0)
+          return false;
+
+        open_ = false;
+        return true;
+      }
+
+      // true if the barrier was open and its timeout has passed, which releases it; missing
+      // receives the sources that did not send a command in time
+      bool expire(int64_t wall_now, std::vector<std::string>& missing)
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!open_ || timeout_ == 0 || wall_now < deadline_)
+          return false;
+
+        missing.clear();
+        for (std::map<std::string, bool>::const_iterator it=arrived_.begin();
+            it!=arrived_.end(); ++it)
+          if (!it->second)
+            missing.push_back(it->first);
+        open_ = false;
+        return true;
+      }
+
+      // time left until an open barrier times out; 0 if it is closed, waits forever, or its
+      // timeout has passed already
+      int64_t remaining(int64_t wall_now) const
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!open_ || timeout_ == 0 || wall_now >= deadline_)
+          return 0;
+        return deadline_ - wall_now;
+      }
+
+      bool isOpen() const
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return open_;
+      }
+
+      // stamp of the state the barrier was opened for last
+      int64_t stamp() const
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stamp_;
+      }
+
+      int64_t timeout() const
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return timeout_;
+      }
+
+    private:
+      mutable std::mutex mutex_;
+      // whether each source has answered the current stamp
+      std::map<std::string, bool> arrived_;
+      size_t pending_;
+      int64_t timeout_, stamp_, deadline_;
+      bool open_;
+  };
+}
+
+#endif
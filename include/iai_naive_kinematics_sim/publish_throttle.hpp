@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_PUBLISH_THROTTLE_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_PUBLISH_THROTTLE_HPP
+
+#include <ros/ros.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace iai_naive_kinematics_sim
+{
+  // decides whether a topic with a given publish rate is due at a simulation time stamp;
+  // deadlines advance by whole periods, so the rate does not drift; a stamp that is closer to
+  // the deadline than the next stamp probably will be counts as due, so that jittery stamps
+  // at about the publish rate are not skipped
+  class PublishThrottle
+  {
+    public:
+      // a throttle that lets everything through
+      PublishThrottle() : period_(0), next_(0), last_(0), started_(false) {}
+
+      PublishThrottle(double rate) : next_(0), last_(0), started_(false)
+      {
+        if (rate <= 0.0)
+          throw std::runtime_error("Asked to throttle to a non-positive publish rate.");
+        period_ = static_cast<int64_t>(1e9 / rate);
+      }
+
+      ~PublishThrottle() {}
+
+      bool due(const ros::Time& now)
+      {
+        int64_t stamp = now.toNSec();
+        int64_t interval = stamp - last_;
+        last_ = stamp;
+
+        // publish right away at start, and after time jumped back or far ahead
+        if (!started_ || stamp + period_ < next_ || stamp >= next_ + period_)
+        {
+          started_ = true;
+          next_ = stamp + period_;
+          return true;
+        }
+
+        if (stamp < next_ - std::min(interval, period_) / 2)
+          return false;
+
+        next_ += period_;
+        return true;
+      }
+
+    private:
+      int64_t period_, next_, last_;
+      bool started_;
+  };
+}
+
+#endif
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_REALTIME_LOOP_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_REALTIME_LOOP_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <stdint.h>
+#include <thread>
+#include <time.h>
+
+#include <iai_naive_kinematics_sim/threads.hpp>
+
+namespace iai_naive_kinematics_sim
+{
+  // how late the ticks of a RealtimeLoop woke up, in ns after their deadlines
+  struct TickStatistics
+  {
+    TickStatistics() :
+      ticks(0), overruns(0), min_latency(0), max_latency(0), mean_latency(0.0) {}
+
+    uint64_t ticks;
+    // deadlines that were missed completely, because a tick took longer than a period
+    uint64_t overruns;
+    int64_t min_latency, max_latency;
+    double mean_latency;
+  };
+
+  // calls a function periodically from a dedicated thread; deadlines are absolute multiples
+  // of the period on CLOCK_MONOTONIC, so the loop does not drift however long the ticks take
+  class RealtimeLoop
+  {
+    public:
+      // gets the number of periods since the previous tick, more than 1 after overruns; must
+      // not throw
+      typedef std::function<void(size_t periods)> Tick;
+
+      RealtimeLoop() : running_(false), error_(0)
+      {
+        resetStatistics();
+      }
+
+      ~RealtimeLoop()
+      {
+        stop();
+      }
+
+      // priority > 0 runs the loop with SCHED_FIFO, cpu >= 0 pins it to that CPU
+      void start(int64_t period, const Tick& tick, int priority = 0, int cpu = -1)
+      {
+        if (period <= 0)
+          throw std::runtime_error("Asked to start a real-time loop with a non-positive period.");
+        stop();
+
+        period_ = period;
+        tick_ = tick;
+        resetStatistics();
+        error_ = 0;
+        running_ = true;
+        thread_ = std::thread(&RealtimeLoop::run, this);
+
+        try
+        {
+          if (priority > 0)
+            setFifoPriority(thread_, priority);
+          if (cpu >= 0)
+            pinThread(thread_, cpu);
+        }
+        catch (...)
+        {
+          stop();
+          throw;
+        }
+      }
+
+      void stop()
+      {
+        running_ = false;
+        if (thread_.joinable())
+          thread_.join();
+      }
+
+      bool isRunning() const
+      {
+        return running_;
+      }
+
+      // the error number with which sleeping failed and the loop stopped, 0 if it did not
+      int error() const
+      {
+        return error_;
+      }
+
+      // may be called from any thread while the loop runs; reset starts a new measurement
+      TickStatistics statistics(bool reset = false)
+      {
+        TickStatistics stats;
+        if (reset)
+        {
+          stats.ticks = ticks_.exchange(0);
+          stats.overruns = overruns_.exchange(0);
+          stats.min_latency = min_latency_.exchange(std::numeric_limits<int64_t>::max());
+          stats.max_latency = max_latency_.exchange(std::numeric_limits<int64_t>::min());
+          stats.mean_latency = static_cast<double>(latency_sum_.exchange(0));
+        }
+        else
+        {
+          stats.ticks = ticks_.load();
+          stats.overruns = overruns_.load();
+          stats.min_latency = min_latency_.load();
+          stats.max_latency = max_latency_.load();
+          stats.mean_latency = static_cast<double>(latency_sum_.load());
+        }
+
+        if (stats.ticks == 0)
+          return TickStatistics();
+        stats.mean_latency /= stats.ticks;
+        return stats;
+      }
+
+    private:
+      std::thread thread_;
+      std::atomic<bool> running_;
+      std::atomic<int> error_;
+      int64_t period_;
+      Tick tick_;
+
+      // written by the loop thread only, so relaxed updates suffice
+      std::atomic<uint64_t> ticks_, overruns_;
+      std::atomic<int64_t> min_latency_, max_latency_, latency_sum_;
+
+      // not copyable, because it owns the thread
+      RealtimeLoop(const RealtimeLoop&);
+      RealtimeLoop& operator=(const RealtimeLoop&);
+
+      void resetStatistics()
+      {
+        ticks_ = 0;
+        overruns_ = 0;
+        min_latency_ = std::numeric_limits<int64_t>::max();
+        max_latency_ = std::numeric_limits<int64_t>::min();
+        latency_sum_ = 0;
+      }
+
+      static int64_t nanoseconds(const timespec& t)
+      {
+        return static_cast<int64_t>(t.tv_sec) * 1000000000ll + t.tv_nsec;
+      }
+
+      static timespec timespecOf(int64_t ns)
+      {
+        timespec t;
+        t.tv_sec = ns / 1000000000ll;
+        t.tv_nsec = ns % 1000000000ll;
+        return t;
+      }
+
+      void record(int64_t latency, uint64_t overruns)
+      {
+        ticks_.fetch_add(1, std::memory_order_relaxed);
+        overruns_.fetch_add(overruns, std::memory_order_relaxed);
+        latency_sum_.fetch_add(latency, std::memory_order_relaxed);
+        if (latency < min_latency_.load(std::memory_order_relaxed))
+          min_latency_.store(latency, std::memory_order_relaxed);
+        if (latency > max_latency_.load(std::memory_order_relaxed))
+          max_latency_.store(latency, std::memory_order_relaxed);
+      }
+
+      void run()
+      {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t deadline = nanoseconds(now) + period_;
+
+        while (running_)
+        {
+          timespec wakeup = timespecOf(deadline);
+          int result;
+          while ((result = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, 0)) != 0)
+          {
+            if (result != EINTR)
+            {
+              // retrying would spin on the same error
+              error_ = result;
+              running_ = false;
+              return;
+            }
+            if (!running_)
+              return;
+          }
+
+          clock_gettime(CLOCK_MONOTONIC, &now);
+          int64_t latency = nanoseconds(now) - deadline;
+
+          // skip the deadlines that already passed, and simulate their time in one tick
+          size_t periods = 1 + latency / period_;
+          deadline += periods * period_;
+          record(latency, periods - 1);
+
+          tick_(periods);
+        }
+      }
+  };
+}
+
+#endif
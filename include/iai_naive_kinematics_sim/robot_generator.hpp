@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_ROBOT_GENERATOR_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_ROBOT_GENERATOR_HPP
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+
+namespace iai_naive_kinematics_sim
+{
+  // parameters of a synthetic robot: several serial chains, e.g. arms, attached to one base
+  // link, each of which can end in a gripper with fingers that are driven by fake controllers
+  struct RobotGeneratorConfig
+  {
+    RobotGeneratorConfig() :
+      name("synthetic_robot"), chains(1), chain_depth(2), joint_types(1, "revolute"),
+      fingers(0), expression_depth(1), sharing(1) {}
+
+    std::string name;
+
+    // number of chains and of joints per chain
+    size_t chains, chain_depth;
+
+    // types of the joints along each chain, repeated if the chain is longer; one of
+    // revolute, continuous, prismatic or fixed
+    std::vector<std::string> joint_types;
+
+    // number of fake-controlled finger joints at the end of each chain
+    size_t fingers;
+
+    // number of nested operations that compute the position of a finger from the position
+    // of the joint it follows; 1 gives the expressions of pr2_fake_controllers.yaml
+    size_t expression_depth;
+
+    // number of fingers that follow the same joint of their chain
+    size_t sharing;
+  };
+
+  class RobotGenerator
+  {
+    public:
+      explicit RobotGenerator(const RobotGeneratorConfig& config) :
+        config_(config)
+      {
+        if (config.chains == 0 || config.chain_depth == 0)
+          throw std::runtime_error("Asked to generate a robot without joints.");
+        if (config.joint_types.empty())
+          throw std::runtime_error("Asked to generate a robot without joint types.");
+        for (size_t i=0; i<config.joint_types.size(); ++i)
+          if (config.joint_types[i] != "revolute" && config.joint_types[i] != "continuous" &&
+              config.joint_types[i] != "prismatic" && config.joint_types[i] != "fixed")
+            throw std::runtime_error("Unknown joint type '" + config.joint_types[i] + "'.");
+        if (config.expression_depth == 0 || config.sharing == 0)
+          throw std::runtime_error("Expression depth and sharing of fake controllers need to be positive.");
+
+        for (size_t i=0; i<config.chains; ++i)
+        {
+          std::vector<std::string> followable;
+          for (size_t j=0; j<config.chain_depth; ++j)
+          {
+            const std::string& type = jointType(j);
+            if (type == "fixed")
+              continue;
+
+            simulated_joints_.push_back(jointName(i, j));
+            controlled_joints_.push_back(jointName(i, j));
+            // fake controllers need position limits to compute fractions of positions
+            if (type != "continuous")
+              followable.push_back(jointName(i, j));
+          }
+
+          if (config.fingers > 0 && followable.empty())
+            throw std::runtime_error("Chains need a revolute or prismatic joint for their fingers to follow.");
+
+          for (size_t k=0; k<config.fingers; ++k)
+          {
+            simulated_joints_.push_back(fingerName(i, k));
+            finger_sources_.push_back(followable[(k / config.sharing) % followable.size()]);
+          }
+        }
+      }
+
+      const RobotGeneratorConfig& getConfig() const
+      {
+        return config_;
+      }
+
+      // movable joints of the chains followed by their fingers, chain by chain
+      const std::vector<std::string>& getSimulatedJoints() const
+      {
+        return simulated_joints_;
+      }
+
+      // movable joints of the chains
+      const std::vector<std::string>& getControlledJoints() const
+      {
+        return controlled_joints_;
+      }
+
+      std::string makeURDF() const
+      {
+        std::ostringstream urdf;
+        urdf << "<?xml version=\"1.0\"?>\n<robot name=\"" << config_.name << "\">\n" <<
+          "  <link name=\"base_link\"/>\n";
+
+        for (size_t i=0; i<config_.chains; ++i)
+        {
+          std::string parent = "base_link";
+          for (size_t j=0; j<config_.chain_depth; ++j)
+          {
+            std::string child = linkName(i, j);
+            appendJoint(urdf, jointName(i, j), jointType(j), parent, child);
+            parent = child;
+          }
+
+          for (size_t k=0; k<config_.fingers; ++k)
+            appendJoint(urdf, fingerName(i, k), "revolute", parent, fingerLinkName(i, k));
+        }
+
+        urdf << "</robot>\n";
+        return urdf.str();
+      }
+
+      // fake controllers that move every finger within its limits as the joint it follows
+      // moves within its limits
+      YAML::Node makeFakeControllers() const
+      {
+        YAML::Node controllers(YAML::NodeType::Sequence);
+        for (size_t i=0; i<config_.chains; ++i)
+          for (size_t k=0; k<config_.fingers; ++k)
+          {
+            const std::string& finger = fingerName(i, k);
+            YAML::Node controller;
+            controller[finger]["position"] = binaryExpr("add",
+                binaryExpr("mul",
+                  fractionExpr(finger_sources_[i * config_.fingers + k], config_.expression_depth),
+                  unaryExpr("pos-lim-len-of", finger)),
+                unaryExpr("pos-lim-low-of", finger));
+            controllers.push_back(controller);
+          }
+
+        YAML::Node root;
+        root["fake-controllers"] = controllers;
+        return root;
+      }
+
+      // parameters of the simulator node for the robot, including the URI of the fake
+      // controllers, if one is given
+      YAML::Node makeConfig(const std::string& fake_controllers_uri = "") const
+      {
+        YAML::Node config;
+        for (size_t i=0; i<simulated_joints_.size(); ++i)
+          config["simulated_joints"].push_back(simulated_joints_[i]);
+        for (size_t i=0; i<controlled_joints_.size(); ++i)
+          config["controlled_joints"].push_back(controlled_joints_[i]);
+        config["projection_mode"] = false;
+        config["sim_frequency"] = 100;
+        // as string to get 0.1 rather than its closest double in the file
+        config["watchdog_period"] = "0.1";
+        if (!fake_controllers_uri.empty())
+          config["fake_controllers"] = fake_controllers_uri;
+        return config;
+      }
+
+    private:
+      RobotGeneratorConfig config_;
+      std::vector<std::string> simulated_joints_, controlled_joints_;
+
+      // joint that each finger follows, chain by chain
+      std::vector<std::string> finger_sources_;
+
+      const std::string& jointType(size_t depth) const
+      {
+        return config_.joint_types[depth % config_.joint_types.size()];
+      }
+
+      static std::string jointName(size_t chain, size_t depth)
+      {
+        return "chain" + std::to_string(chain) + "_joint" + std::to_string(depth);
+      }
+
+      static std::string linkName(size_t chain, size_t depth)
+      {
+        return "chain" + std::to_string(chain) + "_link" + std::to_string(depth);
+      }
+
+      static std::string fingerName(size_t chain, size_t finger)
+      {
+        return "chain" + std::to_string(chain) + "_finger" + std::to_string(finger) + "_joint";
+      }
+
+      static std::string fingerLinkName(size_t chain, size_t finger)
+      {
+        return "chain" + std::to_string(chain) + "_finger" + std::to_string(finger) + "_link";
+      }
+
+      static void appendJoint(std::ostringstream& urdf, const std::string& name,
+          const std::string& type, const std::string& parent, const std::string& child)
+      {
+        urdf << "  <link name=\"" << child << "\"/>\n" <<
+          "  <joint name=\"" << name << "\" type=\"" << type << "\">\n" <<
+          "    <parent link=\"" << parent << "\"/>\n" <<
+          "    <child link=\"" << child << "\"/>\n" <<
+          "    <origin rpy=\"0 0 0\" xyz=\"0 0 0.1\"/>\n";
+        if (type != "fixed")
+          urdf << "    <axis xyz=\"" << (type == "prismatic" ? "1 0 0" : "0 0 1") << "\"/>\n";
+        if (type == "revolute")
+          urdf << "    <limit effort=\"10.0\" lower=\"-2.5\" upper=\"2.5\" velocity=\"1.0\"/>\n";
+        else if (type == "prismatic")
+          urdf << "    <limit effort=\"100.0\" lower=\"0.0\" upper=\"0.3\" velocity=\"0.2\"/>\n";
+        else if (type == "continuous")
+          urdf << "    <limit effort=\"10.0\" velocity=\"1.0\"/>\n";
+        urdf << "  </joint>\n";
+      }
+
+      // fraction of the position of joint within its limits, passed through depth-1 operations
+      // that keep it within [0, 1]
+      static YAML::Node fractionExpr(const std::string& joint, size_t depth)
+      {
+        if (depth <= 1)
+          return unaryExpr("f-pos-of", joint);
+
+        YAML::Node sin;
+        sin["sin"].push_back(fractionExpr(joint, depth-1));
+        return binaryExpr("add", binaryExpr("mul", sin, 0.5), 0.5);
+      }
+
+      template<class A>
+      static YAML::Node unaryExpr(const std::string& op, const A& a)
+      {
+        YAML::Node expr;
+        expr[op] = a;
+        return expr;
+      }
+
+      template<class A, class B>
+      static YAML::Node binaryExpr(const std::string& op, const A& a, const B& b)
+      {
+        YAML::Node expr;
+        expr[op].push_back(a);
+        expr[op].push_back(b);
+        return expr;
+      }
+  };
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_ROLLOUT_SCHEDULER_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_ROLLOUT_SCHEDULER_HPP
+
+#include <algorithm>
+#include <iai_naive_kinematics_sim/batch_simulator.hpp>
+#include <iai_naive_kinematics_sim/simulator.hpp>
+#include <iai_naive_kinematics_sim/work_stealing_pool.hpp>
+
+namespace iai_naive_kinematics_sim
+{
+  // runs batched rollouts on a work-stealing thread pool; the worlds of a rollout are split
+  // into batches of at most batch_size worlds, and every batch is simulated by one task;
+  // since the worlds do not interact, the results do not depend on the number of threads
+  class RolloutScheduler
+  {
+    public:
+      RolloutScheduler(size_t threads, const std::vector<int>& cpus = std::vector<int>(),
+          size_t batch_size = 8) :
+        pool_(threads, cpus), batch_size_(batch_size)
+      {
+        if (batch_size == 0)
+          throw std::runtime_error("Asked to schedule rollouts in batches of 0 worlds.");
+      }
+
+      ~RolloutScheduler() {}
+
+      size_t threads() const
+      {
+        return pool_.size();
+      }
+
+      size_t batchSize() const
+      {
+        return batch_size_;
+      }
+
+      // simulates one world per command schedule, all starting from the state of sim; see
+      // Simulator::rollout for the meaning of the other arguments
+      void rollout(const Simulator& sim, const ros::Time& now, const ros::Duration& dt,
+          size_t steps, const std::vector< std::vector<sensor_msgs::JointState> >& commands,
+          size_t decimation, std::vector< std::vector<sensor_msgs::JointState> >& trajectories)
+      {
+        trajectories.assign(commands.size(), std::vector<sensor_msgs::JointState>());
+
+        // the batches are set up here, because reading the state of sim is not thread-safe
+        std::vector<BatchSimulator> batches;
+        std::vector<size_t> begins;
+        for (size_t begin=0; begin<commands.size(); begin+=batch_size_)
+        {
+          batches.push_back(BatchSimulator());
+          batches.back().init(sim, std::min(batch_size_, commands.size() - begin));
+          begins.push_back(begin);
+        }
+
+        std::vector< std::function<void()> > tasks;
+        for (size_t i=0; i<batches.size(); ++i)
+        {
+          tasks.push_back([&, i]()
+          {
+            size_t begin = begins[i];
+            std::vector< std::vector<sensor_msgs::JointState> > batch_commands(
+                commands.begin() + begin, commands.begin() + begin + batches[i].worlds());
+            std::vector< std::vector<sensor_msgs::JointState> > batch_trajectories;
+
+            batches[i].rollout(now, dt, steps, batch_commands, decimation, batch_trajectories);
+
+            for (size_t w=0; w<batch_trajectories.size(); ++w)
+              trajectories[begin + w].swap(batch_trajectories[w]);
+          });
+        }
+
+        pool_.run(tasks);
+      }
+
+    private:
+      WorkStealingPool pool_;
+      size_t batch_size_;
+  };
+}
+
+#endif
@@ -0,0 +1,441 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_SHARED_MEMORY_STATE_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_SHARED_MEMORY_STATE_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace iai_naive_kinematics_sim
+{
+  // Layout of the shared memory segment: a header, the joint names as one block of
+  // '\0'-terminated strings, and a ring of slots that each hold one joint state. Every slot
+  // is guarded by a seqlock: its sequence number is odd while the publisher writes it, and
+  // readers retry if the number was odd or changed while they copied the slot.
+  namespace shared_memory
+  {
+    static const uint64_t MAGIC = 0x69616973696d7331ull;
+    static const uint32_t VERSION = 1;
+    static const size_t ALIGNMENT = 64;
+
+    static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+        "Shared memory transport needs lock-free 64 bit atomics.");
+
+    struct Header
+    {
+      std::atomic<uint64_t> magic;
+      uint32_t version;
+      uint32_t joints;
+      uint32_t slots;
+      uint32_t names_size;
+      uint64_t slot_size;
+      // number of published states; the latest one sits in slot (published - 1) % slots
+      std::atomic<uint64_t> published;
+    };
+
+    struct Slot
+    {
+      std::atomic<uint64_t> sequence;
+      uint64_t seq;
+      int64_t stamp;
+      // followed by the positions, velocities, and efforts of all joints
+    };
+
+    inline size_t align(size_t size)
+    {
+      return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    inline size_t slotSize(size_t joints)
+    {
+      return align(sizeof(Slot) + 3 * joints * sizeof(double));
+    }
+
+    inline size_t slotsOffset(size_t names_size)
+    {
+      return align(sizeof(Header)) + align(names_size);
+    }
+
+    inline std::string error(const std::string& what, const std::string& name)
+    {
+      return what + " shared memory '" + name + "': " + std::strerror(errno);
+    }
+  }
+
+  // a joint state as read from shared memory; names are only transferred once, and are
+  // available from the reader
+  struct SharedJointState
+  {
+    // number of the state since the publisher started, counting from 1
+    uint64_t count;
+    // header.seq and header.stamp (in ns) of the corresponding sensor_msgs::JointState
+    uint64_t seq;
+    int64_t stamp;
+    std::vector<double> position, velocity, effort;
+  };
+
+  // publishes joint states into a POSIX shared memory segment, for co-located consumers
+  // that want to skip serialization; never blocks on readers
+  class SharedMemoryStatePublisher
+  {
+    public:
+      SharedMemoryStatePublisher() : memory_(0), size_(0), inode_(0) {}
+
+      ~SharedMemoryStatePublisher()
+      {
+        close();
+      }
+
+      // creates the segment; name has to start with a '/', e.g. '/iai_naive_kinematics_sim';
+      // throws if a segment of that name exists, unless take_over is set, which replaces it,
+      // e.g. the one a crashed simulator left behind; readers of a replaced segment see it
+      // closed, and have to re-open the name
+      void open(const std::string& name, const std::vector<std::string>& joint_names,
+          size_t slots, bool take_over = false)
+      {
+        if (slots == 0)
+          throw std::runtime_error("Asked to open shared memory with 0 slots.");
+        close();
+
+        std::string names;
+        for (size_t i=0; i<joint_names.size(); ++i)
+          names += joint_names[i] + '\0';
+
+        size_t slot_size = shared_memory::slotSize(joint_names.size());
+        size_t size = shared_memory::slotsOffset(names.size()) + slots * slot_size;
+
+        if (take_over)
+          markClosed(name);
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0 && errno == EEXIST)
+          throw std::runtime_error("Could not create shared memory '" + name +
+              "', because another simulator publishes into it, or left it behind.");
+        if (fd < 0)
+          throw std::runtime_error(shared_memory::error("Could not create", name));
+        struct stat info;
+        if (fstat(fd, &info) != 0 || ftruncate(fd, size) != 0)
+        {
+          std::string message = shared_memory::error("Could not resize", name);
+          ::close(fd);
+          shm_unlink(name.c_str());
+          throw std::runtime_error(message);
+        }
+        void* memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (memory == MAP_FAILED)
+        {
+          std::string message = shared_memory::error("Could not map", name);
+          shm_unlink(name.c_str());
+          throw std::runtime_error(message);
+        }
+
+        name_ = name;
+        memory_ = static_cast<char*>(memory);
+        size_ = size;
+        inode_ = info.st_ino;
+        joints_ = joint_names.size();
+        slots_ = slots;
+        slot_size_ = slot_size;
+        slots_offset_ = shared_memory::slotsOffset(names.size());
+
+        // the memory is zero-filled, so all slots start with an even sequence number
+        shared_memory::Header* header = this->header();
+        header->version = shared_memory::VERSION;
+        header->joints = joints_;
+        header->slots = slots_;
+        header->names_size = names.size();
+        header->slot_size = slot_size_;
+        header->published.store(0, std::memory_order_relaxed);
+        std::memcpy(memory_ + shared_memory::align(sizeof(shared_memory::Header)),
+            names.data(), names.size());
+        header->magic.store(shared_memory::MAGIC, std::memory_order_release);
+      }
+
+      // marks the segment as closed for readers that still have it mapped, and removes it,
+      // unless another publisher has taken over its name
+      void close()
+      {
+        if (!memory_)
+          return;
+
+        header()->magic.store(0, std::memory_order_release);
+        munmap(memory_, size_);
+        if (inodeOf(name_) == inode_)
+          shm_unlink(name_.c_str());
+        memory_ = 0;
+        size_ = 0;
+        inode_ = 0;
+      }
+
+      bool isOpen() const
+      {
+        return memory_ != 0;
+      }
+
+      void publish(uint64_t seq, int64_t stamp, const double* position,
+          const double* velocity, const double* effort)
+      {
+        if (!memory_)
+          throw std::runtime_error("Asked to publish into closed shared memory.");
+
+        shared_memory::Header* header = this->header();
+        uint64_t published = header->published.load(std::memory_order_relaxed);
+        shared_memory::Slot* slot = reinterpret_cast<shared_memory::Slot*>(
+            memory_ + slots_offset_ + (published % slots_) * slot_size_);
+        double* data = reinterpret_cast<double*>(slot + 1);
+
+        uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+        slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot->seq = seq;
+        slot->stamp = stamp;
+        std::memcpy(data, position, joints_ * sizeof(double));
+        std::memcpy(data + joints_, velocity, joints_ * sizeof(double));
+        std::memcpy(data + 2 * joints_, effort, joints_ * sizeof(double));
+
+        slot->sequence.store(sequence + 2, std::memory_order_release);
+        header->published.store(published + 1, std::memory_order_release);
+      }
+
+    private:
+      // not copyable, because it owns the mapping
+      SharedMemoryStatePublisher(const SharedMemoryStatePublisher&);
+      SharedMemoryStatePublisher& operator=(const SharedMemoryStatePublisher&);
+
+      std::string name_;
+      char* memory_;
+      size_t size_, joints_, slots_, slot_size_, slots_offset_;
+      // identifies the segment, since its name may be taken over by another publisher
+      ino_t inode_;
+
+      shared_memory::Header* header() const
+      {
+        return reinterpret_cast<shared_memory::Header*>(memory_);
+      }
+
+      // the inode of the segment with the given name, 0 if there is none
+      static ino_t inodeOf(const std::string& name)
+      {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+          return 0;
+        struct stat info;
+        ino_t inode = fstat(fd, &info) == 0 ? info.st_ino : 0;
+        ::close(fd);
+        return inode;
+      }
+
+      // tells the readers of an existing segment that it is closed, and removes it
+      static void markClosed(const std::string& name)
+      {
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd >= 0)
+        {
+          struct stat info;
+          if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >=
+              sizeof(shared_memory::Header))
+          {
+            void* memory = mmap(0, sizeof(shared_memory::Header), PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+            if (memory != MAP_FAILED)
+            {
+              static_cast<shared_memory::Header*>(memory)->magic.store(0,
+                  std::memory_order_release);
+              munmap(memory, sizeof(shared_memory::Header));
+            }
+          }
+          ::close(fd);
+        }
+        shm_unlink(name.c_str());
+      }
+  };
+
+  // reads the latest joint state from a segment created by SharedMemoryStatePublisher;
+  // lock-free, and never blocks the publisher
+  class SharedMemoryStateReader
+  {
+    public:
+      SharedMemoryStateReader() : memory_(0), size_(0) {}
+
+      ~SharedMemoryStateReader()
+      {
+        close();
+      }
+
+      void open(const std::string& name)
+      {
+        close();
+
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+          throw std::runtime_error(shared_memory::error("Could not open", name));
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+          std::string message = shared_memory::error("Could not inspect", name);
+          ::close(fd);
+          throw std::runtime_error(message);
+        }
+        size_t size = info.st_size;
+        void* memory = size < sizeof(shared_memory::Header) ? MAP_FAILED :
+          mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (memory == MAP_FAILED)
+          throw std::runtime_error("Could not map shared memory '" + name + "'.");
+
+        memory_ = static_cast<const char*>(memory);
+        size_ = size;
+
+        const shared_memory::Header* header = this->header();
+        if (header->magic.load(std::memory_order_acquire) != shared_memory::MAGIC ||
+            header->version != shared_memory::VERSION ||
+            size_ < shared_memory::slotsOffset(header->names_size) +
+              header->slots * header->slot_size)
+        {
+          close();
+          throw std::runtime_error("Shared memory '" + name +
+              "' does not hold joint states of a running simulator.");
+        }
+
+        joints_ = header->joints;
+        slots_ = header->slots;
+        slot_size_ = header->slot_size;
+        slots_offset_ = shared_memory::slotsOffset(header->names_size);
+
+        names_.clear();
+        const char* names = memory_ + shared_memory::align(sizeof(shared_memory::Header));
+        for (size_t i=0, begin=0; i<header->names_size; ++i)
+          if (names[i] == '\0')
+          {
+            names_.push_back(std::string(names + begin, i - begin));
+            begin = i + 1;
+          }
+        if (names_.size() != joints_)
+        {
+          close();
+          throw std::runtime_error("Shared memory '" + name + "' has a broken name table.");
+        }
+      }
+
+      void close()
+      {
+        if (!memory_)
+          return;
+
+        munmap(const_cast<char*>(memory_), size_);
+        memory_ = 0;
+        size_ = 0;
+        names_.clear();
+      }
+
+      bool isOpen() const
+      {
+        return memory_ != 0;
+      }
+
+      // false once the publisher has closed the segment; re-open to follow a new publisher
+      bool isAlive() const
+      {
+        return memory_ && header()->magic.load(std::memory_order_acquire) == shared_memory::MAGIC;
+      }
+
+      const std::vector<std::string>& names() const
+      {
+        return names_;
+      }
+
+      // copies the latest state into the given one; returns false if nothing has been
+      // published yet, or if the publisher is gone
+      bool read(SharedJointState& state) const
+      {
+        if (!memory_)
+          throw std::runtime_error("Asked to read from closed shared memory.");
+
+        const shared_memory::Header* header = this->header();
+        state.position.resize(joints_);
+        state.velocity.resize(joints_);
+        state.effort.resize(joints_);
+
+        while (isAlive())
+        {
+          uint64_t published = header->published.load(std::memory_order_acquire);
+          if (published == 0)
+            return false;
+
+          const shared_memory::Slot* slot = reinterpret_cast<const shared_memory::Slot*>(
+              memory_ + slots_offset_ + ((published - 1) % slots_) * slot_size_);
+          const double* data = reinterpret_cast<const double*>(slot + 1);
+
+          uint64_t before = slot->sequence.load(std::memory_order_acquire);
+          if (before % 2 == 1)
+            continue;
+
+          state.count = published;
+          state.seq = slot->seq;
+          state.stamp = slot->stamp;
+          std::memcpy(state.position.data(), data, joints_ * sizeof(double));
+          std::memcpy(state.velocity.data(), data + joints_, joints_ * sizeof(double));
+          std::memcpy(state.effort.data(), data + 2 * joints_, joints_ * sizeof(double));
+
+          std::atomic_thread_fence(std::memory_order_acquire);
+          if (slot->sequence.load(std::memory_order_relaxed) == before)
+            return true;
+        }
+
+        return false;
+      }
+
+    private:
+      // not copyable, because it owns the mapping
+      SharedMemoryStateReader(const SharedMemoryStateReader&);
+      SharedMemoryStateReader& operator=(const SharedMemoryStateReader&);
+
+      const char* memory_;
+      size_t size_, joints_, slots_, slot_size_, slots_offset_;
+      std::vector<std::string> names_;
+
+      const shared_memory::Header* header() const
+      {
+        return reinterpret_cast<const shared_memory::Header*>(memory_);
+      }
+  };
+}
+
+#endif
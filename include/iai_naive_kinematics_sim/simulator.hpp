@@ -29,18 +29,74 @@
 #ifndef IAI_NAIVE_KINEMATICS_SIM_SIMULATOR_HPP
 #define IAI_NAIVE_KINEMATICS_SIM_SIMULATOR_HPP
 
+#include <iai_naive_kinematics_sim/instrumentation.hpp>
+#include <iai_naive_kinematics_sim/joint_arrays.hpp>
+#include <iai_naive_kinematics_sim/layout_cache.hpp>
+#include <iai_naive_kinematics_sim/trajectory_recorder.hpp>
 #include <iai_naive_kinematics_sim/utils.hpp>
 #include <iai_naive_kinematics_sim/watchdog.hpp>
 #include "iai_naive_kinematics_sim/expressions.h"
+#include <memory>
 
 namespace iai_naive_kinematics_sim
 {
+  class Simulator;
+
+  // everything about the simulated robot that does not change while simulating; copies of a
+  // simulator share it, and a simulator that changes it, e.g. by loading fake controllers,
+  // first makes its own copy
+  struct SimulatorModel
+  {
+    SimulatorModel() : program_id(0) {}
+
+    // urdf model to lookup information about the joints
+    urdf::Model model;
+
+    // a map from joint-state names to their index in the joint-state message
+    std::map<std::string, size_t> index_map;
+
+    // a map from controlled joint names to their watchdog slot, and the joint-state index
+    // of the joint watched in each slot
+    std::map<std::string, size_t> watchdog_index_map;
+    std::vector<size_t> watchdog_joints;
+
+    // per-joint meta-data, addressed by the index of the joint in the joint-state message
+    std::vector<JointInfo> joint_infos;
+
+    // position limits of the joints, in the same layout as the state
+    JointLimitArrays limits;
+
+    // the fake controllers, compiled into a program that every copy runs on its own state
+    ExpressionProgram program;
+    // fingerprint of program, computed once when it is compiled
+    uint32_t program_id;
+  };
+
+  // the complete mutable state of a simulator: joint values, commands, the registers of the
+  // fake controllers, and the watchdogs; restoring it continues the simulation exactly where
+  // the snapshot was taken
+  struct SimulatorSnapshot
+  {
+    SimulatorSnapshot() : layout_id(0), program_id(0) {}
+
+    // joint names and fake controllers of the simulator the snapshot was taken from, see
+    // layoutId() and ExpressionProgram::fingerprint()
+    uint32_t layout_id, program_id;
+    ros::Time stamp;
+    JointArrays state, command;
+    ProgramState program_state;
+    WatchdogSnapshot watchdogs;
+  };
+
+  // copies of a simulator are forks: they share the model, and only copy the state
   class Simulator
   {
     friend class ExpressionTree;
+    friend class BatchSimulator;
 
     public:
-      Simulator() : expressionTree(this) {}
+      Simulator() : model_(std::make_shared<SimulatorModel>()), instrumentation_(0),
+        recorder_(0) {}
 
       ~Simulator() {}
 
@@ -48,26 +104,52 @@ namespace iai_naive_kinematics_sim
           const std::vector<std::string>& simulated_joints,
           const std::vector<std::string>& controlled_joints,
           const ros::Duration& watchdog_period,
-          const YAML::Node& fake_controllers)
+          const YAML::Node& fake_controllers = YAML::Node())
       {
-        model_ = model;
-        state_ = bootstrapJointState(model, simulated_joints);
+        model_ = std::make_shared<SimulatorModel>();
+        SimulatorModel& robot = *model_;
+        robot.model = model;
+        state_msg_ = bootstrapJointState(model, simulated_joints);
+        command_msg_ = state_msg_;
+        compact_msg_ = CompactJointState();
+        compact_msg_.layout_id = layoutId(state_msg_.name);
+        state_ = JointArrays();
+        state_.resize(state_msg_.name.size());
         command_ = state_;
-        index_map_ = makeJointIndexMap(state_.name);
+        robot.index_map = makeJointIndexMap(state_msg_.name);
         watchdogs_ = makeWatchdogs(model, controlled_joints, watchdog_period);
+        robot.watchdog_index_map = makeJointIndexMap(controlled_joints);
+        layouts_.clear();
+        expired_watchdogs_.assign(controlled_joints.size(), false);
+        for (size_t i=0; i<controlled_joints.size(); ++i)
+          robot.watchdog_joints.push_back(getJointIndex(controlled_joints[i]));
+        robot.joint_infos = makeJointInfos(model, state_msg_.name, robot.watchdog_index_map);
+        robot.limits = makeJointLimitArrays(robot.joint_infos);
         loadFakeJoints(fake_controllers);
       }
 
       void loadFakeJoints(const YAML::Node& node) {
-        posExprs.clear();
-        velExprs.clear();
-        effExprs.clear();
-        expressionTree.parseYAML(node, posExprs, velExprs, effExprs);
+        SimulatorModel& model = mutableModel();
+
+        // lower the expression trees into a flat program; the trees read the state of this
+        // simulator, so they are dropped rather than shared with its copies
+        ExpressionTree tree(this);
+        unordered_map<size_t, Expression<double>*> posExprs, velExprs, effExprs;
+        if (!node.IsNull())
+          tree.parseYAML(node, posExprs, velExprs, effExprs);
+
+        for (auto it = velExprs.begin(); it != velExprs.end(); it++)
+          if (model.joint_infos[it->first].controlled)
+            throw std::runtime_error("Joint '" + state_msg_.name[it->first] +
+                "' is controlled, and cannot have a fake velocity controller.");
+        model.program = tree.compile(posExprs, velExprs, effExprs);
+        model.program_id = model.program.fingerprint();
+        model.program.initState(program_state_);
       }
 
       size_t size() const
       {
-        return index_map_.size();
+        return model_->index_map.size();
       }
 
       void update(const ros::Time& now, const ros::Duration& dt)
@@ -75,100 +157,340 @@ namespace iai_naive_kinematics_sim
         if (dt.toSec() <= 0)
           throw std::runtime_error("Time interval given to update function not bigger than 0.");
 
-        // ask the watchdogs, and stop joints that have not received a new command in a while
-        for (std::map<std::string, Watchdog>::const_iterator it=watchdogs_.begin(); it!=watchdogs_.end(); ++it)
-          if (it->second.barks(now))
-            setJointVelocity(command_, getJointIndex(it->first), 0.0);
+        ScopedTimer timer(instrumentation_, STAGE_UPDATE);
+        if (recorder_)
+          recorder_->recordUpdate(now.toNSec(), dt.toNSec());
 
-        for(size_t i=0; i<state_.position.size(); ++i)
+        // stop joints whose watchdog expired since the last update; they stay stopped until
+        // they receive a new command
+        const SimulatorModel& model = *model_;
+        const std::vector<size_t>& expired = watchdogs_.advance(now);
+        for (size_t i=0; i<expired.size(); ++i)
         {
-          // FIXME: having this check might be inefficient, profile this
-          if (hasControlledJoint(state_.name[i]))
-            state_.velocity[i] = command_.velocity[i];
-          state_.position[i] += state_.velocity[i] * dt.toSec();
-          enforceJointLimits(state_.name[i]);
+          command_.velocity[model.watchdog_joints[expired[i]]] = 0.0;
+          expired_watchdogs_[expired[i]] = true;
         }
 
-        // Update fake psoitions
-        for(auto it = posExprs.begin(); it != posExprs.end(); it++) {
-          state_.position[it->first] = it->second->value();
-          enforceJointLimits(state_.name[it->first]);
+        for (size_t i=0; i<model.watchdog_joints.size(); ++i)
+          state_.velocity[model.watchdog_joints[i]] =
+            command_.velocity[model.watchdog_joints[i]];
+
+        integrateAndClamp(state_, model.limits, dt.toSec());
+
+        // update fake positions and efforts; fake velocities are integrated in the next update,
+        // just like the commands of controlled joints
+        {
+          ScopedTimer fake_controllers_timer(instrumentation_, STAGE_FAKE_CONTROLLERS);
+          model.program.run(state_, model.limits, program_state_);
         }
 
-        state_.header.stamp = now;
-        state_.header.seq++;
+        state_msg_.header.stamp = now;
+        state_msg_.header.seq++;
+      }
+
+      // advances the simulation by several steps of length dt, the first one stamped with now;
+      // commands[i] is applied before step i, if it names any joints; every decimation-th
+      // state and the final state are appended to trajectory, with a decimation of 0 only
+      // the final state is
+      void rollout(const ros::Time& now, const ros::Duration& dt, size_t steps,
+          const std::vector<sensor_msgs::JointState>& commands, size_t decimation,
+          std::vector<sensor_msgs::JointState>& trajectory)
+      {
+        if (commands.size() > steps)
+          throw std::runtime_error("Rollout of " + std::to_string(steps) +
+              " steps was given " + std::to_string(commands.size()) + " commands.");
+
+        trajectory.clear();
+        ros::Time step_now = now;
+        for (size_t i=0; i<steps; ++i, step_now += dt)
+        {
+          if (i < commands.size() && !commands[i].name.empty())
+            setSubCommand(commands[i], step_now);
+
+          update(step_now, dt);
+
+          if (i+1 == steps || (decimation > 0 && (i+1) % decimation == 0))
+            trajectory.push_back(getJointState());
+        }
+
+        if (steps == 0)
+          trajectory.push_back(getJointState());
+      }
+
+      void updateN(const ros::Time& now, const ros::Duration& dt, size_t steps)
+      {
+        ros::Time step_now = now;
+        for (size_t i=0; i<steps; ++i, step_now += dt)
+          update(step_now, dt);
+      }
+
+      // simulates the period dt in the given number of (nearly) equal steps, the last one
+      // stamped with now; gives the same result as update(now, dt) if substeps is 1
+      void substep(const ros::Time& now, const ros::Duration& dt, size_t substeps)
+      {
+        if (substeps == 0)
+          throw std::runtime_error("Asked to simulate in 0 substeps.");
+
+        int64_t total = dt.toNSec();
+        int64_t step = total / static_cast<int64_t>(substeps);
+        for (size_t i=0; i<substeps; ++i)
+        {
+          int64_t begin = i * step;
+          int64_t end = i+1 == substeps ? total : (i+1) * step;
+          ros::Duration step_dt, remaining;
+          step_dt.fromNSec(end - begin);
+          remaining.fromNSec(total - end);
+          update(now - remaining, step_dt);
+        }
       }
 
       const sensor_msgs::JointState& getJointState() const
+      {
+        copyJointArrays(state_, state_msg_);
+        return state_msg_;
+      }
+
+      // the state without joint names; those are given by the layout with id layout_id
+      const CompactJointState& getCompactJointState() const
+      {
+        compact_msg_.header = state_msg_.header;
+        copyJointArrays(state_, compact_msg_);
+        return compact_msg_;
+      }
+
+      // the state without copying it into a message, for transports that skip serialization
+      const JointArrays& getJointArrays() const
       {
         return state_;
       }
 
+      const std_msgs::Header& getHeader() const
+      {
+        return state_msg_.header;
+      }
+
+      const std::vector<std::string>& getJointNames() const
+      {
+        return state_msg_.name;
+      }
+
       const sensor_msgs::JointState& getCommand() const
       {
-        return command_;
+        copyJointArrays(command_, command_msg_);
+        return command_msg_;
+      }
+
+      // assigns into snapshot, so that taking snapshots into the same buffer does not allocate
+      void snapshot(SimulatorSnapshot& snapshot) const
+      {
+        snapshot.layout_id = compact_msg_.layout_id;
+        snapshot.program_id = model_->program_id;
+        snapshot.stamp = state_msg_.header.stamp;
+        snapshot.state = state_;
+        snapshot.command = command_;
+        snapshot.program_state = program_state_;
+        watchdogs_.snapshot(snapshot.watchdogs);
+      }
+
+      // continues from a snapshot of a simulator of the same robot and fake controllers; the
+      // sequence number of the state keeps counting, and watchdogs that expired before are
+      // not reported again; throws while recording, since the log could not be replayed
+      // across the restore
+      void restore(const SimulatorSnapshot& snapshot)
+      {
+        if (recorder_ && recorder_->isOpen())
+          throw std::runtime_error("Asked to restore a snapshot while recording.");
+        if (snapshot.layout_id != compact_msg_.layout_id ||
+            snapshot.program_id != model_->program_id ||
+            snapshot.state.size() != state_.size() ||
+            snapshot.command.size() != command_.size() ||
+            snapshot.program_state.registers.size() != program_state_.registers.size() ||
+            snapshot.program_state.inputs.size() != program_state_.inputs.size() ||
+            snapshot.program_state.outputs.size() != program_state_.outputs.size())
+          throw std::runtime_error(
+              "Asked to restore a snapshot of a different robot or fake controllers.");
+
+        watchdogs_.restore(snapshot.watchdogs);
+        state_msg_.header.stamp = snapshot.stamp;
+        state_ = snapshot.state;
+        command_ = snapshot.command;
+        program_state_ = snapshot.program_state;
+        expired_watchdogs_.assign(expired_watchdogs_.size(), false);
+      }
+
+      // records the latencies of updates and fake controllers into the given instrumentation,
+      // which copies of the simulator share; null turns recording off
+      void setInstrumentation(Instrumentation* instrumentation)
+      {
+        instrumentation_ = instrumentation;
+      }
+
+      // appends every command, state and update to the given recorder, which is not owned;
+      // unlike the instrumentation, copies must not share it, null turns recording off
+      void setRecorder(TrajectoryRecorder* recorder)
+      {
+        recorder_ = recorder;
+      }
+
+      // names of the controlled joints whose watchdog expired since the last call, i.e. that
+      // were stopped for lack of commands
+      std::vector<std::string> popExpiredWatchdogs()
+      {
+        std::vector<std::string> names;
+        for (std::map<std::string, size_t>::const_iterator it=model_->watchdog_index_map.begin();
+            it!=model_->watchdog_index_map.end(); ++it)
+          if (expired_watchdogs_[it->second])
+          {
+            names.push_back(it->first);
+            expired_watchdogs_[it->second] = false;
+          }
+
+        return names;
       }
 
       bool hasJoint(const std::string& name) const
       {
-        std::map<std::string, size_t>::const_iterator it = index_map_.find(name);
+        std::map<std::string, size_t>::const_iterator it = model_->index_map.find(name);
 
-        return it!=index_map_.end();
+        return it!=model_->index_map.end();
       }
 
       bool hasControlledJoint(const std::string& name) const
       {
-        std::map<std::string, Watchdog>::const_iterator it = watchdogs_.find(name);
+        std::map<std::string, size_t>::const_iterator it = model_->watchdog_index_map.find(name);
 
-        return it!=watchdogs_.end();
+        return it!=model_->watchdog_index_map.end();
       }
 
+      // changes the watchdog period of a controlled joint, from its next command on
+      void setWatchdogPeriod(const std::string& name, const ros::Duration& period)
+      {
+        if (period.toSec() <= 0.0)
+          throw std::runtime_error("Asked to set a non-positive watchdog period for joint '" +
+              name + "'.");
+
+        std::map<std::string, size_t>::const_iterator it = model_->watchdog_index_map.find(name);
+        if (it == model_->watchdog_index_map.end())
+          throw std::runtime_error("Asked to set the watchdog period of joint '" + name +
+              "', which is not controlled.");
+
+        watchdogs_.setPeriod(it->second, period);
+      }
+
+      ros::Duration getWatchdogPeriod(const std::string& name) const
+      {
+        std::map<std::string, size_t>::const_iterator it = model_->watchdog_index_map.find(name);
+        if (it == model_->watchdog_index_map.end())
+          throw std::runtime_error("Asked for the watchdog period of joint '" + name +
+              "', which is not controlled.");
+
+        return watchdogs_.getPeriod(it->second);
+      }
+
+      // messages that repeat the names of a recent message skip resolving them
       void setSubJointState(const sensor_msgs::JointState& state)
       {
         sanityCheckJointState(state);
-
-        for(size_t i=0; i<state.name.size(); ++i)
-          setJointState(state_, getJointIndex(state.name[i]), state.name[i],
-              state.position[i], state.velocity[i], state.effort[i]);
+        setSubJointState(*cachedLayout(state.name), state.position.data(),
+            state.velocity.data(), state.effort.empty() ? 0 : state.effort.data());
       }
 
       void setSubCommand(const sensor_msgs::JointState& command, const ros::Time& now)
       {
-        for (size_t i=0; i<command.name.size(); ++i)
+        sanityCheckCommand(command);
+        setSubCommand(*cachedLayout(command.name), command.velocity.data(), now);
+      }
+
+      // resolves names without caching them, e.g. for callers that keep their own cache
+      JointLayout resolveLayout(const std::vector<std::string>& names) const
+      {
+        return resolveJointLayout(names, model_->index_map, model_->watchdog_index_map);
+      }
+
+      // same as setSubJointState for a state with the names of layout and the given values;
+      // efforts may be null to keep the current efforts
+      void setSubJointState(const JointLayout& layout, const double* positions,
+          const double* velocities, const double* efforts)
+      {
+        checkJointsKnown(layout);
+        if (recorder_)
+          recorder_->recordSetState(layout, positions, velocities, efforts);
+
+        for (size_t i=0; i<layout.joints.size(); ++i)
         {
-          std::map<std::string, Watchdog>::iterator it = watchdogs_.find(command.name[i]);
+          size_t index = layout.joints[i];
+          state_.position[index] = positions[i];
+          state_.velocity[index] = velocities[i];
+          if (efforts)
+            state_.effort[index] = efforts[i];
+        }
+      }
 
-          if (it != watchdogs_.end())
+      // same as setSubCommand for a command with the names of layout and the given velocities
+      void setSubCommand(const JointLayout& layout, const double* velocities,
+          const ros::Time& now)
+      {
+        if (recorder_)
+          recorder_->recordCommand(layout, velocities, now.toNSec());
+
+        for (size_t i=0; i<layout.slots.size(); ++i)
+          if (layout.slots[i] != JointLayout::NONE)
           {
-            it->second.pet(now);
-            setJointVelocity(command_, getJointIndex(command.name[i]), command.velocity[i]);
+            watchdogs_.pet(layout.slots[i], now);
+            command_.velocity[model_->watchdog_joints[layout.slots[i]]] = velocities[i];
           }
-        }
       }
 
     private:
+      // shared with copies of this simulator, see mutableModel()
+      std::shared_ptr<SimulatorModel> model_;
+
       // internal state and commands of the simulator
-      sensor_msgs::JointState state_, command_;
+      JointArrays state_, command_;
+
+      // message buffers that getJointState() and getCommand() fill from the internal arrays
+      mutable sensor_msgs::JointState state_msg_, command_msg_;
+      mutable CompactJointState compact_msg_;
+
+      // the registers and inputs to run the fake controllers on
+      ProgramState program_state_;
+
+      // the watchdogs for our command interfaces, by watchdog slot
+      WatchdogManager watchdogs_;
+
+      // slots whose watchdog expired since the last call of popExpiredWatchdogs()
+      std::vector<bool> expired_watchdogs_;
+
+      // layouts of recently set states and commands
+      LayoutCache layouts_;
+
+      // not owned, may be null
+      Instrumentation* instrumentation_;
+      TrajectoryRecorder* recorder_;
 
-      ExpressionTree expressionTree;
-      unordered_map<size_t, Expression<double>*> posExprs;
-      unordered_map<size_t, Expression<double>*> velExprs;
-      unordered_map<size_t, Expression<double>*> effExprs;
+      // the model, after making sure that no copy of this simulator shares it
+      SimulatorModel& mutableModel()
+      {
+        if (model_.use_count() > 1)
+          model_ = std::make_shared<SimulatorModel>(*model_);
 
-      // a map from joint-state names to their index in the joint-state message
-      std::map<std::string, size_t> index_map_;
+        return *model_;
+      }
 
-      // urdf model to lookup information about the joints
-      urdf::Model model_;
+      LayoutCache::LayoutPtr cachedLayout(const std::vector<std::string>& names)
+      {
+        LayoutCache::LayoutPtr layout = layouts_.find(names);
+        if (!layout)
+          layout = layouts_.insert(resolveLayout(names));
 
-      // a map holding the watchdogs for our command interfaces
-      std::map<std::string, Watchdog> watchdogs_;
+        return layout;
+      }
 
       size_t getJointIndex(const std::string& name) const
       {
-        std::map<std::string, size_t>::const_iterator it = index_map_.find(name);
+        std::map<std::string, size_t>::const_iterator it = model_->index_map.find(name);
 
-        if (it==index_map_.end())
+        if (it==model_->index_map.end())
           throw std::runtime_error("Could not find joint index for joint with name '" +
               name + "'.");
 
@@ -178,33 +500,13 @@ namespace iai_naive_kinematics_sim
       boost::shared_ptr<urdf::Joint> getJoint(const std::string& name) const
       {
         std::map<std::string, boost::shared_ptr<urdf::Joint> >::const_iterator it =
-          model_.joints_.find(name);
+          model_->model.joints_.find(name);
 
-        if (it == model_.joints_.end())
+        if (it == model_->model.joints_.end())
           throw std::runtime_error("URDF has no joint with name '" + name + "'.");
 
         return it->second;
       }
-
-      void enforceJointLimits(const std::string& name)
-      {
-        boost::shared_ptr<urdf::Joint> joint = getJoint(name);
-
-        if ((joint->type == urdf::Joint::REVOLUTE || joint->type == urdf::Joint::PRISMATIC) &&
-            joint->limits.get())
-        {
-          // joint should be limited, and has limits specified
-
-          size_t index = getJointIndex(name);
-          if(state_.position[index] < joint->limits->lower ||
-             state_.position[index] > joint->limits->upper)
-          {
-            state_.position[index] =
-              std::max(joint->limits->lower, std::min(state_.position[index], joint->limits->upper));
-            state_.velocity[index] = 0.0;
-          }
-        }
-      }
   };
 }
 
@@ -29,14 +29,42 @@
 #ifndef IAI_NAIVE_KINEMATICS_SIM_SIMULATOR_NODE_HPP
 #define IAI_NAIVE_KINEMATICS_SIM_SIMULATOR_NODE_HPP
 
+#include <iai_naive_kinematics_sim/command_inbox.hpp>
+#include <iai_naive_kinematics_sim/free_running_loop.hpp>
+#include <iai_naive_kinematics_sim/instrumentation.hpp>
+#include <iai_naive_kinematics_sim/kinematics_sim.hpp>
+#include <iai_naive_kinematics_sim/lockstep_barrier.hpp>
+#include <iai_naive_kinematics_sim/publish_throttle.hpp>
+#include <iai_naive_kinematics_sim/realtime_loop.hpp>
+#include <iai_naive_kinematics_sim/rollout_scheduler.hpp>
+#include <iai_naive_kinematics_sim/shared_memory_state.hpp>
 #include <iai_naive_kinematics_sim/simulator.hpp>
+#include <iai_naive_kinematics_sim/snapshot_store.hpp>
+#include <iai_naive_kinematics_sim/tick_tasks.hpp>
+#include <iai_naive_kinematics_sim/trajectory_recorder.hpp>
 #include <iai_naive_kinematics_sim/utils.hpp>
 #include <iai_naive_kinematics_sim/watchdog.hpp>
+#include <iai_naive_kinematics_sim/BatchRollout.h>
+#include <iai_naive_kinematics_sim/DumpLatencies.h>
 #include <iai_naive_kinematics_sim/SetJointState.h>
+#include <iai_naive_kinematics_sim/Rollout.h>
 #include <iai_naive_kinematics_sim/ProjectionClock.h>
+#include <iai_naive_kinematics_sim/RestoreSnapshot.h>
+#include <iai_naive_kinematics_sim/SaveSnapshot.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <rosgraph_msgs/Clock.h>
+#include <ros/callback_queue.h>
 #include <std_msgs/Header.h>
 #include <resource_retriever/retriever.h>
 #include <yaml-cpp/yaml.h>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 
 namespace iai_naive_kinematics_sim
@@ -45,14 +73,24 @@ namespace iai_naive_kinematics_sim
   {
     public:
       SimulatorNode(const ros::NodeHandle& nh):
-        nh_(nh), sim_frequency_(1.0) {}
+        nh_(nh), rollout_nh_(nh), sim_frequency_(1.0), sim_(core_.simulator()),
+        lockstep_(false), free_running_(false), real_time_factor_(0.0),
+        diagnostics_overruns_(0) {}
 
-      ~SimulatorNode() {}
+      ~SimulatorNode()
+      {
+        free_loop_.stop();
+        loop_.stop();
+      }
 
       void init()
       {
         readSimFrequency();
+        readIntegrationFrequency();
         projection_mode_ = readParam<bool>(nh_, "projection_mode");
+        free_running_ = nh_.param("free_running", false);
+        if (projection_mode_ && free_running_)
+          throw std::runtime_error("Cannot combine projection_mode and free_running.");
 
         std::string fake_controllers_str;
         std::string fake_controllers_uri;
@@ -66,65 +104,288 @@ namespace iai_naive_kinematics_sim
           }
         }
 
-        YAML::Node fake_controllers_node = YAML::Load(fake_controllers_str);
+        KinematicsSimConfig config;
+        config.simulated_joints = readSimulatedJoints();
+        config.controlled_joints = readControlledJoints();
+        config.watchdog_period = readWatchdogPeriod();
+        config.watchdog_periods = readWatchdogPeriods(config.controlled_joints);
+        config.fake_controllers = fake_controllers_str;
+        core_.init(readParam<std::string>(nh_, "/robot_description"), config);
+        sim_.setInstrumentation(&instrumentation_);
 
-        sim_.init(readUrdf(), readSimulatedJoints(), readControlledJoints(), readWatchdogPeriod(), fake_controllers_node);
+        // start recording before the start configuration, so that a simulator that is set
+        // up like this one can replay the log
+        std::string record;
+        if (nh_.getParam("record", record))
+        {
+          int record_buffer = nh_.param("record_buffer", 4096);
+          if (record_buffer <= 0)
+            throw std::runtime_error("Read a non-positive record_buffer.");
+          ROS_INFO("record: %s", record.c_str());
+          recorder_.open(record, sim_.getJointNames(), record_buffer);
+          sim_.setRecorder(&recorder_);
+        }
         sim_.setSubJointState(readStartConfig());
+        inbox_.init(sim_);
 
+        std::string shared_memory;
+        if (nh_.getParam("shared_memory", shared_memory))
+        {
+          ROS_INFO("shared_memory: %s", shared_memory.c_str());
+          bool take_over = false;
+          nh_.getParam("shared_memory_take_over", take_over);
+          shm_pub_.open(shared_memory, sim_.getJointNames(), readSharedMemorySlots(),
+              take_over);
+        }
 
         sub_ = nh_.subscribe("commands", 1, &SimulatorNode::callback, this,
               ros::TransportHints().tcpNoDelay());
-        pub_ = nh_.advertise<sensor_msgs::JointState>("joint_states", 1);
+        publish_joint_states_ = true;
+        nh_.getParam("publish_joint_states", publish_joint_states_);
+        joint_states_throttle_ = readPublishThrottle("joint_states_rate");
+        compact_throttle_ = readPublishThrottle("compact_joint_states_rate");
+        shm_throttle_ = readPublishThrottle("shared_memory_rate");
+        if (publish_joint_states_)
+          pub_ = nh_.advertise<sensor_msgs::JointState>("joint_states", 1);
+        compact_pub_ = nh_.advertise<CompactJointState>("compact_joint_states", 1);
+        layout_pub_ = nh_.advertise<JointStateLayout>("joint_state_layout", 1, true);
+        layout_pub_.publish(makeJointStateLayout(sim_.getJointNames()));
         server_ = nh_.advertiseService("set_joint_states", &SimulatorNode::set_joint_states, this);
+        rollout_server_ = nh_.advertiseService("rollout", &SimulatorNode::rollout, this);
+        snapshots_ = SnapshotStore(readMaxSnapshots());
+        save_snapshot_server_ = nh_.advertiseService("save_snapshot",
+            &SimulatorNode::save_snapshot, this);
+        restore_snapshot_server_ = nh_.advertiseService("restore_snapshot",
+            &SimulatorNode::restore_snapshot, this);
+        dump_latencies_server_ = nh_.advertiseService("dump_latencies",
+            &SimulatorNode::dump_latencies, this);
+
+        double diagnostics_period = nh_.param("diagnostics_period", 1.0);
+        if (diagnostics_period > 0)
+        {
+          diagnostics_pub_ = nh_.advertise<diagnostic_msgs::DiagnosticArray>("diagnostics", 1);
+          diagnostics_timer_ = nh_.createWallTimer(ros::WallDuration(diagnostics_period),
+              &SimulatorNode::publish_diagnostics, this);
+        }
+
+        // batch rollouts are served by their own spinner, so that they do not stall the simulation
+        scheduler_.reset(new RolloutScheduler(readRolloutThreads(), readRolloutCpus(),
+            readRolloutBatchSize()));
+        rollout_nh_.setCallbackQueue(&rollout_queue_);
+        batch_rollout_server_ = rollout_nh_.advertiseService("batch_rollout",
+            &SimulatorNode::batch_rollout, this);
+        rollout_spinner_.reset(new ros::AsyncSpinner(1, &rollout_queue_));
+        rollout_spinner_->start();
+
         if (projection_mode_)
         {
           clock_sub_ = nh_.subscribe("projection_clock", 1, &SimulatorNode::projection_clock_callback,
               this, ros::TransportHints().tcpNoDelay());
 
-          ack_pub_ = nh_.advertise<std_msgs::Header>("commands_received", 1);
+          std::vector<std::string> sources;
+          lockstep_ = nh_.getParam("lockstep_sources", sources) && !sources.empty();
+          if (lockstep_)
+            startLockstep(sources);
+          else
+            ack_pub_ = nh_.advertise<std_msgs::Header>("commands_received", 1);
+        }
+        else if (free_running_)
+          startFreeRunning();
+        else if (nh_.param("realtime_thread", false))
+        {
+          int priority = nh_.param("realtime_priority", 0);
+          int cpu = nh_.param("realtime_cpu", -1);
+          ROS_INFO("realtime_thread: priority %d, cpu %d", priority, cpu);
+          loop_.start(sim_period_.toNSec(), [this](size_t periods) { realtime_tick(periods); },
+              priority, cpu);
+          jitter_timer_ = nh_.createWallTimer(
+              ros::WallDuration(nh_.param("jitter_report_period", 10.0)),
+              &SimulatorNode::report_jitter, this);
         }
         else
           timer_ = nh_.createTimer(sim_period_, &SimulatorNode::timer_callback, this);
       }
 
     private:
-      ros::NodeHandle nh_;
-      ros::Publisher pub_, ack_pub_;
-      ros::Subscriber sub_, clock_sub_;
-      ros::ServiceServer server_;
+      ros::NodeHandle nh_, rollout_nh_;
+      ros::Publisher pub_, compact_pub_, layout_pub_, ack_pub_, ready_pub_, diagnostics_pub_,
+        sim_clock_pub_;
+      ros::Subscriber sub_, clock_sub_, clock_ack_sub_;
+      ros::ServiceServer server_, rollout_server_, batch_rollout_server_, dump_latencies_server_,
+        save_snapshot_server_, restore_snapshot_server_;
       ros::Timer timer_;
+      ros::WallTimer jitter_timer_, diagnostics_timer_, lockstep_timer_;
       ros::Rate sim_frequency_;
       ros::Duration sim_period_;
-      Simulator sim_;
+      double integration_frequency_;
+      // latencies of the live simulation; copies for rollouts do not report to it
+      Instrumentation instrumentation_;
+      // the simulator library, which the node wraps into ROS topics and services
+      KinematicsSim core_;
+      Simulator& sim_;
+      std::mutex sim_mutex_;
+      // guarded by sim_mutex_
+      SnapshotStore snapshots_;
+      // work of the services, run by the real-time thread between two ticks
+      TickTasks tasks_;
+      SharedMemoryStatePublisher shm_pub_;
+      TrajectoryRecorder recorder_;
       bool projection_mode_;
+      bool lockstep_;
+      LockstepBarrier barrier_;
+      bool free_running_;
+      double real_time_factor_;
+      bool publish_joint_states_;
+      PublishThrottle joint_states_throttle_, compact_throttle_, shm_throttle_;
 
-      void callback(const sensor_msgs::JointState::ConstPtr& msg)
+      CommandInbox inbox_;
+
+      // latencies at the time of the last diagnostics, to report those of the last period
+      std::mutex diagnostics_mutex_;
+      LatencySnapshot diagnostics_snapshots_[NUM_STAGES];
+      uint64_t diagnostics_overruns_;
+      RealtimeLoop loop_;
+      FreeRunningLoop free_loop_;
+      std::unique_ptr<RolloutScheduler> scheduler_;
+      ros::CallbackQueue rollout_queue_;
+      // declared last to stop serving batch rollouts before anything else is torn down
+      std::unique_ptr<ros::AsyncSpinner> rollout_spinner_;
+
+      // never touches the simulator, so it is safe with any number of spinner threads; the
+      // command takes effect at the start of the next simulation step; lockstep sources are
+      // identified by the name of the node that published the command
+      void callback(const ros::MessageEvent<sensor_msgs::JointState const>& event)
       {
+        const sensor_msgs::JointState::ConstPtr& msg = event.getMessage();
         try
         {
-          if (projection_mode_)
+          ros::Time now = projection_mode_ ? msg->header.stamp : currentTime();
+          ScopedTimer timer(&instrumentation_, STAGE_COMMAND_RECEIVE);
+          // a dropped command still answers the tick, or the projection would wait for it
+          // until the lockstep timeout
+          if (!inbox_.push(*msg, now))
+            ROS_WARN("Dropped a command, because the simulation is falling behind.");
+
+          if (lockstep_)
+          {
+            if (barrier_.arrive(event.getPublisherName(), msg->header.stamp.toNSec()))
+              publishReady(msg->header.stamp);
+          }
+          else if (projection_mode_)
           {
-            sim_.setSubCommand(*msg, msg->header.stamp);
             std_msgs::Header ack_msg = msg->header;
             ack_pub_.publish(ack_msg);
           }
+        }
+        catch (const std::exception& e)
+        {
+          ROS_ERROR("%s", e.what());
+        }
+      }
+
+      bool set_joint_states(SetJointState::Request& request, SetJointState::Response& response)
+      {
+        try
+        {
+          runOnSimulation([this, &request]() { sim_.setSubJointState(request.state); });
+          response.success = true;
+          response.message = "";
+        }
+        catch (const std::exception& e)
+        {
+          response.success = false;
+          response.message = e.what();
+        }
+
+        return true;
+      }
+
+      bool save_snapshot(SaveSnapshot::Request& request, SaveSnapshot::Response& response)
+      {
+        runOnSimulation([this, &response]() {
+            response.handle = snapshots_.save(sim_);
+            response.stamp = sim_.getHeader().stamp;
+        });
+        response.success = true;
+        response.message = "";
+
+        return true;
+      }
+
+      bool restore_snapshot(RestoreSnapshot::Request& request, RestoreSnapshot::Response& response)
+      {
+        try
+        {
+          runOnSimulation([this, &request]() {
+              sim_.restore(snapshots_.get(request.handle));
+              if (request.release)
+                snapshots_.release(request.handle);
+          });
+          response.success = true;
+          response.message = "";
+        }
+        catch (const std::exception& e)
+        {
+          response.success = false;
+          response.message = e.what();
+        }
+
+        return true;
+      }
+
+      bool rollout(Rollout::Request& request, Rollout::Response& response)
+      {
+        try
+        {
+          if (loop_.isRunning())
+          {
+            // the live simulation runs on in real time, so the rollout only predicts: it runs
+            // on a copy, which the real-time thread keeps ticking past, and is then dropped
+            Simulator sim;
+            runOnSimulation([this, &sim]() { sim = sim_; });
+            sim.setRecorder(0);
+            sim.setInstrumentation(0);
+            sim.rollout(request.now, request.period, request.steps, request.commands,
+                request.decimation, response.trajectory);
+          }
           else
           {
-            ros::Time now = ros::Time::now();
-            sim_.setSubCommand(*msg, now);
+            std::lock_guard<std::mutex> lock(sim_mutex_);
+            sim_.rollout(request.now, request.period, request.steps, request.commands,
+                request.decimation, response.trajectory);
+            publishState();
           }
+          response.success = true;
+          response.message = "";
         }
         catch (const std::exception& e)
         {
-          ROS_ERROR("%s", e.what());
+          response.success = false;
+          response.message = e.what();
         }
+
+        return true;
       }
 
-      bool set_joint_states(SetJointState::Request& request, SetJointState::Response& response)
+      bool batch_rollout(BatchRollout::Request& request, BatchRollout::Response& response)
       {
         try
         {
-          sim_.setSubJointState(request.state);
+          Simulator sim;
+          runOnSimulation([this, &sim]() { sim = sim_; });
+          sim.setRecorder(0);
+          sim.setInstrumentation(0);
+
+          std::vector< std::vector<sensor_msgs::JointState> > commands, trajectories;
+          for (size_t i=0; i<request.commands.size(); ++i)
+            commands.push_back(request.commands[i].states);
+
+          scheduler_->rollout(sim, request.now, request.period, request.steps, commands,
+              request.decimation, trajectories);
+
+          response.trajectories.resize(trajectories.size());
+          for (size_t i=0; i<trajectories.size(); ++i)
+            response.trajectories[i].states.swap(trajectories[i]);
           response.success = true;
           response.message = "";
         }
@@ -139,23 +400,345 @@ namespace iai_naive_kinematics_sim
 
       void timer_callback(const ros::TimerEvent& e)
       {
-        sim_.update(e.current_real, sim_period_);
-        pub_.publish(sim_.getJointState());
+        std::lock_guard<std::mutex> lock(sim_mutex_);
+        tick(e.current_real, sim_period_);
+      }
+
+      // runs on the real-time thread, which is the only one to take sim_mutex_ while it runs
+      void realtime_tick(size_t periods)
+      {
+        std::lock_guard<std::mutex> lock(sim_mutex_);
+        tasks_.run();
+        try
+        {
+          ros::Duration period;
+          period.fromNSec(sim_period_.toNSec() * periods);
+          tick(ros::Time::now(), period);
+        }
+        catch (const std::exception& e)
+        {
+          ROS_ERROR("%s", e.what());
+        }
+      }
+
+      bool dump_latencies(DumpLatencies::Request& request, DumpLatencies::Response& response)
+      {
+        std::lock_guard<std::mutex> lock(diagnostics_mutex_);
+        for (size_t i=0; i<NUM_STAGES; ++i)
+        {
+          InstrumentationStage stage = static_cast<InstrumentationStage>(i);
+          LatencySnapshot snapshot = instrumentation_.histogram(stage).snapshot();
+          response.stages.push_back(makeLatencyStatus(Instrumentation::stageName(stage), snapshot));
+          response.histograms.push_back(formatLatencyHistogram(snapshot));
+        }
+        response.stages[STAGE_TICK].values.push_back(
+            makeKeyValue("overruns", instrumentation_.overruns()));
+
+        if (request.reset)
+        {
+          instrumentation_.reset();
+          for (size_t i=0; i<NUM_STAGES; ++i)
+            diagnostics_snapshots_[i] = LatencySnapshot();
+          diagnostics_overruns_ = 0;
+        }
+
+        return true;
+      }
+
+      // publishes the latencies since the last diagnostics; ticks that took longer than the
+      // simulation period raise a warning
+      void publish_diagnostics(const ros::WallTimerEvent& e)
+      {
+        std::lock_guard<std::mutex> lock(diagnostics_mutex_);
+        diagnostic_msgs::DiagnosticArray msg;
+        msg.header.stamp = ros::Time::now();
+        for (size_t i=0; i<NUM_STAGES; ++i)
+        {
+          InstrumentationStage stage = static_cast<InstrumentationStage>(i);
+          LatencySnapshot snapshot = instrumentation_.histogram(stage).snapshot();
+          LatencySnapshot period = diagnostics_snapshots_[i].counts.empty() ?
+            snapshot : snapshot - diagnostics_snapshots_[i];
+          msg.status.push_back(makeLatencyStatus(ros::this_node::getName() + ": " +
+                Instrumentation::stageName(stage), period));
+          diagnostics_snapshots_[i] = snapshot;
+        }
+
+        uint64_t overruns = instrumentation_.overruns();
+        diagnostic_msgs::DiagnosticStatus& tick = msg.status[STAGE_TICK];
+        tick.values.push_back(makeKeyValue("overruns", overruns - diagnostics_overruns_));
+        if (overruns > diagnostics_overruns_)
+        {
+          tick.level = diagnostic_msgs::DiagnosticStatus::WARN;
+          tick.message = std::to_string(overruns - diagnostics_overruns_) +
+            " ticks took longer than the simulation period";
+        }
+        diagnostics_overruns_ = overruns;
+
+        diagnostics_pub_.publish(msg);
+      }
+
+      // runs task on the simulation under sim_mutex_; while the real-time thread runs, hands
+      // it over to that thread instead and waits for the next tick to run it, so that the
+      // real-time thread never waits for a service
+      void runOnSimulation(const TickTasks::Task& task)
+      {
+        if (!loop_.isRunning())
+        {
+          std::lock_guard<std::mutex> lock(sim_mutex_);
+          task();
+          return;
+        }
+
+        std::future<void> done = tasks_.push(task);
+        while (done.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready)
+          if (!loop_.isRunning())
+          {
+            // the real-time thread stopped before it got to the task
+            std::lock_guard<std::mutex> lock(sim_mutex_);
+            tasks_.run();
+          }
+        done.get();
+      }
+
+      void report_jitter(const ros::WallTimerEvent& e)
+      {
+        if (!loop_.isRunning() && loop_.error() != 0)
+        {
+          ROS_ERROR("The simulation thread stopped, because it could not sleep: %s. "
+              "Simulating with a ROS timer instead.", std::strerror(loop_.error()));
+          jitter_timer_.stop();
+          timer_ = nh_.createTimer(sim_period_, &SimulatorNode::timer_callback, this);
+          return;
+        }
+
+        TickStatistics stats = loop_.statistics(true);
+        ROS_INFO("simulation thread: %lu ticks, %lu overruns, wake-up latency min %.1fus, "
+            "mean %.1fus, max %.1fus", (unsigned long) stats.ticks,
+            (unsigned long) stats.overruns, stats.min_latency * 1e-3, stats.mean_latency * 1e-3,
+            stats.max_latency * 1e-3);
       }
 
       void projection_clock_callback(const ProjectionClock::ConstPtr& msg)
       {
-        sim_.update(msg->now, msg->period);
-        pub_.publish(sim_.getJointState());
+        std::lock_guard<std::mutex> lock(sim_mutex_);
+        // open the barrier before the state goes out, so that no answer to it is missed
+        if (lockstep_)
+        {
+          barrier_.open(msg->now.toNSec(), ros::WallTime::now().toNSec());
+          if (barrier_.timeout() > 0)
+            armLockstepTimer(barrier_.timeout());
+        }
+        tick(msg->now, msg->period);
+      }
+
+      // instead of acknowledging every command, wait for one command from each of the
+      // given sources per projection tick, and signal once that all of them have answered
+      void startLockstep(const std::vector<std::string>& sources)
+      {
+        double timeout = nh_.param("lockstep_timeout", 1.0);
+        if (timeout < 0.0)
+          throw std::runtime_error("Read a negative lockstep_timeout.");
+        ROS_INFO("lockstep: %lu command sources, timeout %f", (unsigned long) sources.size(),
+            timeout);
+
+        barrier_.init(sources, ros::Duration(timeout).toNSec());
+        ready_pub_ = nh_.advertise<std_msgs::Header>("ready", 1);
+        if (timeout > 0.0)
+          lockstep_timer_ = nh_.createWallTimer(ros::WallDuration(timeout),
+              &SimulatorNode::lockstep_timeout, this, true, false);
+      }
+
+      void lockstep_timeout(const ros::WallTimerEvent& e)
+      {
+        std::vector<std::string> missing;
+        int64_t now = ros::WallTime::now().toNSec();
+        if (!barrier_.expire(now, missing))
+        {
+          // the one-shot timer fired before the deadline of the open barrier, e.g. for the
+          // barrier it was armed for before, so wait for the rest of this one
+          int64_t remaining = barrier_.remaining(now);
+          if (remaining > 0)
+            armLockstepTimer(remaining);
+          return;
+        }
+
+        std::string names;
+        for (size_t i=0; i<missing.size(); ++i)
+          names += " " + missing[i];
+        ROS_WARN("Stopped waiting for commands within lockstep_timeout from:%s", names.c_str());
+        ros::Time stamp;
+        stamp.fromNSec(barrier_.stamp());
+        publishReady(stamp);
+      }
+
+      // (re-)starts the one-shot lockstep timer to fire once after the given ns
+      void armLockstepTimer(int64_t ns)
+      {
+        ros::WallDuration period;
+        period.fromNSec(ns);
+        lockstep_timer_.stop();
+        lockstep_timer_.setPeriod(period);
+        lockstep_timer_.start();
+      }
+
+      // tells the projection clock that all expected commands for the state at stamp are in
+      void publishReady(const ros::Time& stamp)
+      {
+        std_msgs::Header msg;
+        msg.stamp = stamp;
+        ready_pub_.publish(msg);
       }
 
-      urdf::Model readUrdf() const
+      // steps the simulation on its own thread, as fast as the real-time factor and the
+      // acknowledging clock subscribers allow, and publishes the simulated time on /clock
+      void startFreeRunning()
       {
-        std::string urdf_descr_ = readParam<std::string>(nh_, "/robot_description");
-        urdf::Model model;
-        if(!model.initString(urdf_descr_))
-          throw std::runtime_error("Could not parse given robot description.");
-        return model;
+        real_time_factor_ = nh_.param("real_time_factor", 0.0);
+        if (real_time_factor_ < 0.0)
+          throw std::runtime_error("Read a negative real_time_factor.");
+        double start_time = nh_.param("start_time", 0.0);
+        if (start_time < 0.0)
+          throw std::runtime_error("Read a negative start_time.");
+        double max_lead = nh_.param("clock_max_lead", sim_period_.toSec());
+        if (max_lead < 0.0)
+          throw std::runtime_error("Read a negative clock_max_lead.");
+        double ack_timeout = nh_.param("clock_ack_timeout", 1.0);
+        if (ack_timeout < 0.0)
+          throw std::runtime_error("Read a negative clock_ack_timeout.");
+        std::vector<std::string> subscribers;
+        nh_.getParam("clock_subscribers", subscribers);
+        ROS_INFO("free_running: real_time_factor %f, %lu clock subscribers",
+            real_time_factor_, (unsigned long) subscribers.size());
+
+        ClockThrottle throttle(ros::Duration(max_lead).toNSec(),
+            ros::Duration(ack_timeout).toNSec());
+        for (size_t i=0; i<subscribers.size(); ++i)
+          throttle.expect(subscribers[i], 0);
+
+        sim_clock_pub_ = nh_.advertise<rosgraph_msgs::Clock>("/clock", 1);
+        clock_ack_sub_ = nh_.subscribe("clock_ack", 10, &SimulatorNode::clock_ack_callback,
+            this, ros::TransportHints().tcpNoDelay());
+        free_loop_.start(ros::Duration(start_time).toNSec(), sim_period_.toNSec(),
+            real_time_factor_, throttle, [this](int64_t stamp) { free_running_tick(stamp); });
+      }
+
+      // runs on the free-running thread
+      void free_running_tick(int64_t stamp)
+      {
+        ros::Time now;
+        now.fromNSec(stamp);
+        {
+          std::lock_guard<std::mutex> lock(sim_mutex_);
+          try
+          {
+            tick(now, sim_period_);
+          }
+          catch (const std::exception& e)
+          {
+            ROS_ERROR("%s", e.what());
+          }
+        }
+
+        rosgraph_msgs::Clock clock;
+        clock.clock = now;
+        sim_clock_pub_.publish(clock);
+
+        std::vector<std::string> dropped = free_loop_.popDropped();
+        for (size_t i=0; i<dropped.size(); ++i)
+          ROS_WARN("Stopped waiting for clock subscriber %s, which has not acknowledged "
+              "within clock_ack_timeout.", dropped[i].c_str());
+      }
+
+      // the publishing node is the subscriber, stamp is the last clock it has processed
+      void clock_ack_callback(const ros::MessageEvent<std_msgs::Header const>& event)
+      {
+        free_loop_.acknowledge(event.getPublisherName(), event.getMessage()->stamp.toNSec());
+      }
+
+      // the time commands are received at: simulated while free-running, wall time otherwise
+      ros::Time currentTime() const
+      {
+        if (!free_running_)
+          return ros::Time::now();
+
+        ros::Time now;
+        now.fromNSec(free_loop_.now());
+        return now;
+      }
+
+      // wall time a tick may take without falling behind; unlimited when free-running as
+      // fast as possible
+      uint64_t overrunBudget() const
+      {
+        if (!free_running_)
+          return sim_period_.toNSec();
+        if (real_time_factor_ <= 0.0)
+          return std::numeric_limits<uint64_t>::max();
+        return static_cast<uint64_t>(sim_period_.toNSec() / real_time_factor_);
+      }
+
+      // applies the received commands, simulates the given period and publishes the result
+      void tick(const ros::Time& now, const ros::Duration& period)
+      {
+        ScopedTimer timer(&instrumentation_, STAGE_TICK);
+        {
+          ScopedTimer apply_timer(&instrumentation_, STAGE_COMMAND_APPLY);
+          if (inbox_.apply(sim_) == 0)
+            apply_timer.discard();
+        }
+        if (recorder_.isOpen())
+          recorder_.recordClock(now.toNSec(), period.toNSec(), substeps(period));
+        step(now, period);
+        if (recorder_.isOpen())
+        {
+          const JointArrays& state = sim_.getJointArrays();
+          recorder_.recordState(sim_.getHeader().seq, sim_.getHeader().stamp.toNSec(),
+              state.position.data(), state.velocity.data(), state.effort.data());
+        }
+        publishState();
+
+        if (timer.elapsed() > overrunBudget())
+          instrumentation_.recordOverrun();
+      }
+
+      // number of steps to simulate period in, as the integration frequency asks for
+      size_t substeps(const ros::Duration& period) const
+      {
+        return std::max(1.0, std::floor(period.toSec() * integration_frequency_ + 0.5));
+      }
+
+      // simulates the given period in as many steps as the integration frequency asks for
+      void step(const ros::Time& now, const ros::Duration& period)
+      {
+        sim_.substep(now, period, substeps(period));
+
+        std::vector<std::string> expired = sim_.popExpiredWatchdogs();
+        if (!expired.empty())
+        {
+          std::string names;
+          for (size_t i=0; i<expired.size(); ++i)
+            names += " " + expired[i];
+          ROS_WARN("Stopped joints that have not been commanded within their watchdog period:%s",
+              names.c_str());
+        }
+      }
+
+      // publishes the current state on every output whose publish rate is due
+      void publishState()
+      {
+        ScopedTimer timer(&instrumentation_, STAGE_PUBLISH);
+        const ros::Time& stamp = sim_.getHeader().stamp;
+        if (compact_throttle_.due(stamp))
+          compact_pub_.publish(sim_.getCompactJointState());
+        if (publish_joint_states_ && joint_states_throttle_.due(stamp))
+          pub_.publish(sim_.getJointState());
+
+        if (shm_pub_.isOpen() && shm_throttle_.due(stamp))
+        {
+          const JointArrays& state = sim_.getJointArrays();
+          shm_pub_.publish(sim_.getHeader().seq, sim_.getHeader().stamp.toNSec(),
+              state.position.data(), state.velocity.data(), state.effort.data());
+        }
       }
 
       void readSimFrequency()
@@ -168,14 +751,14 @@ namespace iai_naive_kinematics_sim
         sim_period_ = sim_frequency_.expectedCycleTime();
       }
 
-      ros::Duration readWatchdogPeriod() const
+      double readWatchdogPeriod() const
       {
         double watchdog_period = readParam<double>(nh_, "watchdog_period");
         if(watchdog_period <= 0.0)
           throw std::runtime_error("Read a non-positive watchdog period.");
         ROS_INFO("watchdog_period: %f", watchdog_period);
 
-        return ros::Duration(watchdog_period);
+        return watchdog_period;
       }
 
       std::vector<std::string> readSimulatedJoints() const
@@ -190,6 +773,33 @@ namespace iai_naive_kinematics_sim
         return simulated_joints;
       }
 
+      // the optional per-joint and per-group periods, e.g.
+      //   watchdog_groups: {base: [odom_x_joint, odom_y_joint]}
+      //   watchdog_periods: {base: 0.2, l_gripper_joint: 0.01}
+      std::map<std::string, double> readWatchdogPeriods(
+          const std::vector<std::string>& controlled_joints) const
+      {
+        std::map<std::string, double> periods;
+        nh_.getParam("watchdog_periods", periods);
+
+        std::map<std::string, std::vector<std::string> > groups;
+        for (std::map<std::string, double>::const_iterator it=periods.begin();
+            it!=periods.end(); ++it)
+        {
+          std::vector<std::string> joints;
+          if (nh_.getParam("watchdog_groups/" + it->first, joints))
+            groups[it->first] = joints;
+        }
+
+        std::map<std::string, double> result =
+          resolveWatchdogPeriods(periods, groups, controlled_joints);
+        for (std::map<std::string, double>::const_iterator it=result.begin();
+            it!=result.end(); ++it)
+          ROS_INFO("watchdog period of '%s': %f", it->first.c_str(), it->second);
+
+        return result;
+      }
+
       std::vector<std::string> readControlledJoints() const
       {
         std::vector<std::string> controlled_joints =
@@ -202,22 +812,87 @@ namespace iai_naive_kinematics_sim
         return controlled_joints;
       }
 
+      size_t readRolloutThreads() const
+      {
+        int threads = std::max(1u, std::thread::hardware_concurrency());
+        nh_.getParam("rollout_threads", threads);
+        if (threads <= 0)
+          throw std::runtime_error("Read a non-positive number of rollout threads.");
+        ROS_INFO("rollout_threads: %d", threads);
+
+        return threads;
+      }
+
+      std::vector<int> readRolloutCpus() const
+      {
+        std::vector<int> cpus;
+        nh_.getParam("rollout_cpus", cpus);
+
+        return cpus;
+      }
+
+      size_t readRolloutBatchSize() const
+      {
+        int batch_size = 8;
+        nh_.getParam("rollout_batch_size", batch_size);
+        if (batch_size <= 0)
+          throw std::runtime_error("Read a non-positive rollout batch size.");
+
+        return batch_size;
+      }
+
+      void readIntegrationFrequency()
+      {
+        // by default, simulate one step per callback
+        integration_frequency_ = 1.0 / sim_period_.toSec();
+        nh_.getParam("integration_frequency", integration_frequency_);
+        if (integration_frequency_ <= 0.0)
+          throw std::runtime_error("Read a non-positive integration frequency.");
+        ROS_INFO("integration_frequency: %f", integration_frequency_);
+      }
+
+      // unset rates publish with every simulation callback
+      PublishThrottle readPublishThrottle(const std::string& param_name) const
+      {
+        double rate;
+        if (!nh_.getParam(param_name, rate))
+          return PublishThrottle();
+        if (rate <= 0.0)
+          throw std::runtime_error("Read a non-positive " + param_name + ".");
+        ROS_INFO("%s: %f", param_name.c_str(), rate);
+
+        return PublishThrottle(rate);
+      }
+
+      size_t readSharedMemorySlots() const
+      {
+        int slots = 8;
+        nh_.getParam("shared_memory_slots", slots);
+        if (slots <= 0)
+          throw std::runtime_error("Read a non-positive number of shared memory slots.");
+
+        return slots;
+      }
+
+      size_t readMaxSnapshots() const
+      {
+        int snapshots = 64;
+        nh_.getParam("max_snapshots", snapshots);
+        if (snapshots <= 0)
+          throw std::runtime_error("Read a non-positive max_snapshots.");
+
+        return snapshots;
+      }
+
       sensor_msgs::JointState readStartConfig() const
       {
         std::map<std::string, double> start_config;
         nh_.getParam("start_config", start_config);
-        sensor_msgs::JointState joint_state;
         for(std::map<std::string, double>::const_iterator it=start_config.begin();
             it!=start_config.end(); ++it)
-        {
-          joint_state.name.push_back(it->first);
-          joint_state.position.push_back(it->second);
-          joint_state.velocity.push_back(0.0);
-          joint_state.effort.push_back(0.0);
           ROS_INFO("start config for '%s': %f", it->first.c_str(), it->second);
-        }
 
-        return joint_state;
+        return makeStartConfig(start_config);
       }
 
   };
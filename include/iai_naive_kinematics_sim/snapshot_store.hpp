@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_SNAPSHOT_STORE_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_SNAPSHOT_STORE_HPP
+
+#include <iai_naive_kinematics_sim/simulator.hpp>
+#include <map>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace iai_naive_kinematics_sim
+{
+  // keeps a bounded number of simulator snapshots under handles that are never reused; when
+  // it is full, saving evicts the oldest snapshot, whose buffers the new one reuses; not
+  // thread-safe
+  class SnapshotStore
+  {
+    public:
+      SnapshotStore(size_t capacity = 64) : next_handle_(1)
+      {
+        if (capacity == 0)
+          throw std::runtime_error("Asked to create a snapshot store without capacity.");
+        slots_.resize(capacity);
+        for (size_t i=capacity; i>0; --i)
+          free_.push_back(i-1);
+      }
+
+      ~SnapshotStore() {}
+
+      size_t capacity() const
+      {
+        return slots_.size();
+      }
+
+      size_t size() const
+      {
+        return handles_.size();
+      }
+
+      // takes a snapshot of sim and returns its handle, which is never 0
+      uint64_t save(const Simulator& sim)
+      {
+        if (free_.empty())
+        {
+          free_.push_back(handles_.begin()->second);
+          handles_.erase(handles_.begin());
+        }
+
+        size_t slot = free_.back();
+        sim.snapshot(slots_[slot]);
+        free_.pop_back();
+        uint64_t handle = next_handle_++;
+        handles_[handle] = slot;
+        return handle;
+      }
+
+      bool contains(uint64_t handle) const
+      {
+        return handles_.count(handle) > 0;
+      }
+
+      const SimulatorSnapshot& get(uint64_t handle) const
+      {
+        std::map<uint64_t, size_t>::const_iterator it = handles_.find(handle);
+        if (it == handles_.end())
+          throw std::range_error("Asked for snapshot " + std::to_string(handle) +
+              ", which has been released, evicted, or never existed.");
+
+        return slots_[it->second];
+      }
+
+      // returns false if there was no such snapshot
+      bool release(uint64_t handle)
+      {
+        std::map<uint64_t, size_t>::iterator it = handles_.find(handle);
+        if (it == handles_.end())
+          return false;
+
+        free_.push_back(it->second);
+        handles_.erase(it);
+        return true;
+      }
+
+    private:
+      std::vector<SimulatorSnapshot> slots_;
+      // handles by age, and the slots their snapshots are in
+      std::map<uint64_t, size_t> handles_;
+      std::vector<size_t> free_;
+      uint64_t next_handle_;
+  };
+}
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_THREADS_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_THREADS_HPP
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace iai_naive_kinematics_sim
+{
+  inline void pinThread(std::thread& thread, int cpu)
+  {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &set) != 0)
+      throw std::runtime_error("Could not pin thread to CPU " + std::to_string(cpu) + ".");
+#else
+    throw std::runtime_error("Pinning threads to CPUs is not supported on this platform.");
+#endif
+  }
+
+  // switches the thread to SCHED_FIFO with the given priority; usually needs CAP_SYS_NICE or
+  // an rtprio entry in /etc/security/limits.conf
+  inline void setFifoPriority(std::thread& thread, int priority)
+  {
+#ifdef __linux__
+    sched_param param;
+    param.sched_priority = priority;
+    int error = pthread_setschedparam(thread.native_handle(), SCHED_FIFO, &param);
+    if (error != 0)
+      throw std::runtime_error("Could not set SCHED_FIFO priority " + std::to_string(priority) +
+          ": " + std::strerror(error));
+#else
+    throw std::runtime_error("Real-time scheduling is not supported on this platform.");
+#endif
+  }
+}
+
+#endif
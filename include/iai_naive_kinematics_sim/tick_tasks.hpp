@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_TICK_TASKS_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_TICK_TASKS_HPP
+
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+
+namespace iai_naive_kinematics_sim
+{
+  // hands work from service threads to the thread that simulates, to be run between two
+  // ticks, so that the simulation thread never waits for a lock that a service holds; the
+  // caller waits on the returned future, which also carries the exceptions of the task
+  class TickTasks
+  {
+    public:
+      typedef std::function<void()> Task;
+
+      TickTasks() {}
+
+      ~TickTasks() {}
+
+      std::future<void> push(const Task& task)
+      {
+        std::packaged_task<void()> packaged(task);
+        std::future<void> done = packaged.get_future();
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(packaged));
+        return done;
+      }
+
+      // runs the tasks pushed so far, in order; if a pushing thread holds the lock right now,
+      // returns without waiting for it, and the tasks are left for the next call
+      size_t run()
+      {
+        std::deque< std::packaged_task<void()> > tasks;
+        {
+          std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+          if (!lock.owns_lock() || tasks_.empty())
+            return 0;
+          tasks.swap(tasks_);
+        }
+
+        for (size_t i=0; i<tasks.size(); ++i)
+          tasks[i]();
+
+        return tasks.size();
+      }
+
+    private:
+      // only held to push or to take the pushed tasks, never while running them
+      std::mutex mutex_;
+      std::deque< std::packaged_task<void()> > tasks_;
+
+      // not copyable, because of the futures waiting for the tasks
+      TickTasks(const TickTasks&);
+      TickTasks& operator=(const TickTasks&);
+  };
+}
+
+#endif
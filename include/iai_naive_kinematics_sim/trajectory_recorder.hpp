@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_TRAJECTORY_RECORDER_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_TRAJECTORY_RECORDER_HPP
+
+#include <iai_naive_kinematics_sim/layout_cache.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace iai_naive_kinematics_sim
+{
+  // Layout of a trajectory log: a header, the joint names as one block of '\0'-terminated
+  // strings, and records that all have the same size. Every record holds a header, a bit
+  // mask of the joints it names, and the positions, velocities and efforts of all joints,
+  // of which only those of the named joints are meaningful. A second file, with the suffix
+  // '.index', lists the position in the log and the stamp of every clock record.
+  namespace trajectory_log
+  {
+    static const uint64_t MAGIC = 0x69616973696d746cull;
+    static const uint32_t VERSION = 1;
+
+    enum RecordType
+    {
+      // Simulator::setSubCommand with the velocities of the named joints
+      COMMAND = 1,
+      // Simulator::setSubJointState, with efforts if the flag HAS_EFFORT is set
+      SET_STATE = 2,
+      // Simulator::update with stamp and duration
+      UPDATE = 3,
+      // a tick of the node with stamp, duration, and the number of substeps in seq
+      CLOCK = 4,
+      // the state of all joints after a tick of the node
+      STATE = 5
+    };
+
+    static const uint32_t HAS_EFFORT = 1;
+
+    struct Header
+    {
+      uint64_t magic;
+      uint32_t version;
+      uint32_t joints;
+      uint64_t names_size;
+      uint64_t record_size;
+    };
+
+    struct Record
+    {
+      uint32_t type;
+      uint32_t flags;
+      // number of the record since the start of the log; gaps mark dropped records
+      uint64_t number;
+      int64_t stamp;
+      int64_t duration;
+      uint64_t seq;
+      // followed by the mask, and the positions, velocities and efforts of all joints
+    };
+
+    struct IndexEntry
+    {
+      // position of the record in the file, which differs from its number after drops
+      uint64_t record;
+      int64_t stamp;
+    };
+
+    inline size_t align(size_t size)
+    {
+      return (size + 7) / 8 * 8;
+    }
+
+    inline size_t maskWords(size_t joints)
+    {
+      return (joints + 63) / 64;
+    }
+
+    inline size_t recordSize(size_t joints)
+    {
+      return sizeof(Record) + (maskWords(joints) + 3 * joints) * sizeof(uint64_t);
+    }
+
+    inline size_t recordsOffset(size_t names_size)
+    {
+      return align(sizeof(Header)) + align(names_size);
+    }
+
+    inline const uint64_t* mask(const Record* record)
+    {
+      return reinterpret_cast<const uint64_t*>(record + 1);
+    }
+
+    inline const double* positions(const Record* record, size_t joints)
+    {
+      return reinterpret_cast<const double*>(mask(record) + maskWords(joints));
+    }
+
+    inline const double* velocities(const Record* record, size_t joints)
+    {
+      return positions(record, joints) + joints;
+    }
+
+    inline const double* efforts(const Record* record, size_t joints)
+    {
+      return positions(record, joints) + 2 * joints;
+    }
+
+    inline std::string error(const std::string& what, const std::string& path)
+    {
+      return what + " trajectory log '" + path + "': " + std::strerror(errno);
+    }
+  }
+
+  // appends everything that changes a simulator to a trajectory log; records are copied
+  // into a ring buffer by the simulating thread, and written to disk by a background
+  // thread; if the writer falls behind, records are dropped and counted rather than
+  // blocking the simulation. The record functions must not be called concurrently.
+  class TrajectoryRecorder
+  {
+    public:
+      TrajectoryRecorder() : file_(0), index_file_(0), joints_(0), record_size_(0),
+        capacity_(0), next_number_(0), head_(0), tail_(0), dropped_(0), running_(false),
+        written_(0), failed_(false) {}
+
+      ~TrajectoryRecorder()
+      {
+        close();
+      }
+
+      // starts a new log at path, replacing any previous one; buffers up to capacity records
+      void open(const std::string& path, const std::vector<std::string>& joint_names,
+          size_t capacity = 4096)
+      {
+        if (capacity == 0)
+          throw std::runtime_error("Asked to record a trajectory with a buffer of 0 records.");
+        close();
+
+        std::string names;
+        for (size_t i=0; i<joint_names.size(); ++i)
+          names += joint_names[i] + '\0';
+
+        file_ = std::fopen(path.c_str(), "wb");
+        if (!file_)
+          throw std::runtime_error(trajectory_log::error("Could not create", path));
+        index_file_ = std::fopen((path + ".index").c_str(), "wb");
+        if (!index_file_)
+        {
+          std::string message = trajectory_log::error("Could not create the index of", path);
+          close();
+          throw std::runtime_error(message);
+        }
+
+        joints_ = joint_names.size();
+        record_size_ = trajectory_log::recordSize(joints_);
+
+        trajectory_log::Header header;
+        std::memset(&header, 0, sizeof(header));
+        header.magic = trajectory_log::MAGIC;
+        header.version = trajectory_log::VERSION;
+        header.joints = joints_;
+        header.names_size = names.size();
+        header.record_size = record_size_;
+        std::vector<char> preamble(trajectory_log::recordsOffset(names.size()), 0);
+        std::memcpy(preamble.data(), &header, sizeof(header));
+        std::memcpy(preamble.data() + trajectory_log::align(sizeof(header)), names.data(),
+            names.size());
+        if (std::fwrite(preamble.data(), preamble.size(), 1, file_) != 1)
+        {
+          std::string message = trajectory_log::error("Could not write", path);
+          close();
+          throw std::runtime_error(message);
+        }
+
+        path_ = path;
+        capacity_ = capacity;
+        buffer_.assign(capacity_ * record_size_, 0);
+        next_number_ = 0;
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+        dropped_.store(0, std::memory_order_relaxed);
+        written_ = 0;
+        failed_ = false;
+        running_.store(true, std::memory_order_release);
+        writer_ = std::thread(&TrajectoryRecorder::write, this);
+      }
+
+      // writes all buffered records, and closes the log
+      void close()
+      {
+        if (writer_.joinable())
+        {
+          running_.store(false, std::memory_order_release);
+          writer_.join();
+        }
+        if (file_)
+          std::fclose(file_);
+        if (index_file_)
+          std::fclose(index_file_);
+        file_ = 0;
+        index_file_ = 0;
+      }
+
+      bool isOpen() const
+      {
+        return file_ != 0;
+      }
+
+      // waits until the writer has written all records recorded so far
+      void flush() const
+      {
+        while (writer_.joinable() &&
+            tail_.load(std::memory_order_acquire) != head_.load(std::memory_order_relaxed))
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+
+      const std::string& path() const
+      {
+        return path_;
+      }
+
+      // number of records that were dropped because the writer fell behind, or failed
+      uint64_t dropped() const
+      {
+        return dropped_.load(std::memory_order_relaxed);
+      }
+
+      void recordCommand(const JointLayout& layout, const double* velocities, int64_t stamp)
+      {
+        trajectory_log::Record* record = begin(trajectory_log::COMMAND);
+        if (!record)
+          return;
+
+        record->stamp = stamp;
+        uint64_t* mask = this->mask(record);
+        double* data = this->data(record);
+        for (size_t i=0; i<layout.slots.size(); ++i)
+          if (layout.slots[i] != JointLayout::NONE)
+          {
+            size_t joint = layout.joints[i];
+            mask[joint / 64] |= uint64_t(1) << (joint % 64);
+            data[joints_ + joint] = velocities[i];
+          }
+        commit();
+      }
+
+      void recordSetState(const JointLayout& layout, const double* positions,
+          const double* velocities, const double* efforts)
+      {
+        trajectory_log::Record* record = begin(trajectory_log::SET_STATE);
+        if (!record)
+          return;
+
+        record->flags = efforts ? trajectory_log::HAS_EFFORT : 0;
+        uint64_t* mask = this->mask(record);
+        double* data = this->data(record);
+        for (size_t i=0; i<layout.joints.size(); ++i)
+        {
+          size_t joint = layout.joints[i];
+          mask[joint / 64] |= uint64_t(1) << (joint % 64);
+          data[joint] = positions[i];
+          data[joints_ + joint] = velocities[i];
+          if (efforts)
+            data[2 * joints_ + joint] = efforts[i];
+        }
+        commit();
+      }
+
+      void recordUpdate(int64_t stamp, int64_t duration)
+      {
+        trajectory_log::Record* record = begin(trajectory_log::UPDATE);
+        if (!record)
+          return;
+
+        record->stamp = stamp;
+        record->duration = duration;
+        commit();
+      }
+
+      void recordClock(int64_t stamp, int64_t duration, uint64_t substeps)
+      {
+        trajectory_log::Record* record = begin(trajectory_log::CLOCK);
+        if (!record)
+          return;
+
+        record->stamp = stamp;
+        record->duration = duration;
+        record->seq = substeps;
+        commit();
+      }
+
+      void recordState(uint64_t seq, int64_t stamp, const double* positions,
+          const double* velocities, const double* efforts)
+      {
+        trajectory_log::Record* record = begin(trajectory_log::STATE);
+        if (!record)
+          return;
+
+        record->stamp = stamp;
+        record->seq = seq;
+        uint64_t* mask = this->mask(record);
+        for (size_t i=0; i<trajectory_log::maskWords(joints_); ++i)
+          mask[i] = ~uint64_t(0);
+        double* data = this->data(record);
+        std::memcpy(data, positions, joints_ * sizeof(double));
+        std::memcpy(data + joints_, velocities, joints_ * sizeof(double));
+        std::memcpy(data + 2 * joints_, efforts, joints_ * sizeof(double));
+        commit();
+      }
+
+    private:
+      // not copyable, because it owns the writer thread
+      TrajectoryRecorder(const TrajectoryRecorder&);
+      TrajectoryRecorder& operator=(const TrajectoryRecorder&);
+
+      std::string path_;
+      std::FILE* file_;
+      std::FILE* index_file_;
+      size_t joints_, record_size_, capacity_;
+
+      // ring of capacity_ records; the simulating thread fills the records from head_ on,
+      // the writer writes them out up to head_ and frees them by advancing tail_
+      std::vector<char> buffer_;
+      uint64_t next_number_;
+      std::atomic<uint64_t> head_, tail_, dropped_;
+      std::atomic<bool> running_;
+      std::thread writer_;
+
+      // only used by the writer: records in the file, and whether writing failed
+      uint64_t written_;
+      bool failed_;
+
+      // returns a cleared record of the given type, or null if the record is dropped
+      trajectory_log::Record* begin(trajectory_log::RecordType type)
+      {
+        if (!file_)
+          return 0;
+
+        uint64_t number = next_number_++;
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= capacity_)
+        {
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+          return 0;
+        }
+
+        char* memory = &buffer_[(head % capacity_) * record_size_];
+        std::memset(memory, 0, record_size_);
+        trajectory_log::Record* record = reinterpret_cast<trajectory_log::Record*>(memory);
+        record->type = type;
+        record->number = number;
+        return record;
+      }
+
+      void commit()
+      {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+      }
+
+      uint64_t* mask(trajectory_log::Record* record) const
+      {
+        return reinterpret_cast<uint64_t*>(record + 1);
+      }
+
+      double* data(trajectory_log::Record* record) const
+      {
+        return reinterpret_cast<double*>(mask(record) + trajectory_log::maskWords(joints_));
+      }
+
+      // runs on the writer thread until the recorder is closed, and then writes the rest
+      void write()
+      {
+        while (true)
+        {
+          bool running = running_.load(std::memory_order_acquire);
+          uint64_t tail = tail_.load(std::memory_order_relaxed);
+          uint64_t head = head_.load(std::memory_order_acquire);
+          if (tail == head)
+          {
+            if (!running)
+              break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+          }
+
+          // write up to the end of the ring at once; after a failed write, the log ends
+          // and everything else counts as dropped
+          size_t begin = tail % capacity_;
+          size_t count = std::min<uint64_t>(head - tail, capacity_ - begin);
+          const char* records = &buffer_[begin * record_size_];
+          if (failed_ || std::fwrite(records, record_size_, count, file_) != count)
+          {
+            failed_ = true;
+            dropped_.fetch_add(count, std::memory_order_relaxed);
+          }
+          else
+            for (size_t i=0; i<count; ++i, ++written_)
+            {
+              const trajectory_log::Record* record =
+                reinterpret_cast<const trajectory_log::Record*>(records + i * record_size_);
+              trajectory_log::IndexEntry entry = {written_, record->stamp};
+              if (record->type == trajectory_log::CLOCK &&
+                  std::fwrite(&entry, sizeof(entry), 1, index_file_) != 1)
+                failed_ = true;
+            }
+
+          tail_.store(tail + count, std::memory_order_release);
+          if (tail + count == head_.load(std::memory_order_acquire))
+          {
+            std::fflush(file_);
+            std::fflush(index_file_);
+          }
+        }
+      }
+  };
+}
+
+#endif
@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_TRAJECTORY_REPLAY_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_TRAJECTORY_REPLAY_HPP
+
+#include <iai_naive_kinematics_sim/simulator.hpp>
+#include <iai_naive_kinematics_sim/trajectory_recorder.hpp>
+#include <algorithm>
+#include <map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace iai_naive_kinematics_sim
+{
+  // read-only view of a trajectory log written by TrajectoryRecorder, mapped into memory;
+  // a log that is still being written can be opened, and shows the records written so far
+  class TrajectoryLogReader
+  {
+    public:
+      TrajectoryLogReader() : memory_(0), size_(0), index_memory_(0), index_size_(0) {}
+
+      ~TrajectoryLogReader()
+      {
+        close();
+      }
+
+      void open(const std::string& path)
+      {
+        close();
+
+        memory_ = map(path, size_);
+        const trajectory_log::Header* header = reinterpret_cast<const trajectory_log::Header*>(memory_);
+        if (size_ < sizeof(trajectory_log::Header) || header->magic != trajectory_log::MAGIC ||
+            header->version != trajectory_log::VERSION ||
+            header->record_size != trajectory_log::recordSize(header->joints) ||
+            size_ < trajectory_log::recordsOffset(header->names_size))
+        {
+          close();
+          throw std::runtime_error("'" + path + "' is not a trajectory log.");
+        }
+
+        joints_ = header->joints;
+        record_size_ = header->record_size;
+        records_offset_ = trajectory_log::recordsOffset(header->names_size);
+        records_ = (size_ - records_offset_) / record_size_;
+
+        const char* names = memory_ + trajectory_log::align(sizeof(trajectory_log::Header));
+        for (size_t i=0, begin=0; i<header->names_size; ++i)
+          if (names[i] == '\0')
+          {
+            names_.push_back(std::string(names + begin, i - begin));
+            begin = i + 1;
+          }
+        if (names_.size() != joints_)
+        {
+          close();
+          throw std::runtime_error("Trajectory log '" + path + "' has a broken name table.");
+        }
+
+        // the index is optional, and only covers the records written when it was mapped
+        size_t index_size = 0;
+        try
+        {
+          index_memory_ = map(path + ".index", index_size);
+          index_size_ = index_size;
+        }
+        catch (const std::exception&)
+        {
+          index_memory_ = 0;
+          index_size_ = 0;
+        }
+      }
+
+      void close()
+      {
+        if (memory_)
+          munmap(const_cast<char*>(memory_), size_);
+        if (index_memory_)
+          munmap(const_cast<char*>(index_memory_), index_size_);
+        memory_ = 0;
+        size_ = 0;
+        index_memory_ = 0;
+        index_size_ = 0;
+        names_.clear();
+      }
+
+      bool isOpen() const
+      {
+        return memory_ != 0;
+      }
+
+      const std::vector<std::string>& names() const
+      {
+        return names_;
+      }
+
+      size_t joints() const
+      {
+        return joints_;
+      }
+
+      // number of complete records
+      size_t size() const
+      {
+        return records_;
+      }
+
+      const trajectory_log::Record* record(size_t i) const
+      {
+        if (i >= records_)
+          throw std::range_error("Asked for record " + std::to_string(i) + " of a trajectory log with " +
+              std::to_string(records_) + " records.");
+
+        return reinterpret_cast<const trajectory_log::Record*>(
+            memory_ + records_offset_ + i * record_size_);
+      }
+
+      bool isNamed(const trajectory_log::Record* record, size_t joint) const
+      {
+        return (trajectory_log::mask(record)[joint / 64] >> (joint % 64)) & 1;
+      }
+
+      // number of indexed clock records within the mapped records
+      size_t clocks() const
+      {
+        size_t count = index_size_ / sizeof(trajectory_log::IndexEntry);
+        while (count > 0 && index()[count - 1].record >= records_)
+          count--;
+        return count;
+      }
+
+      // position of the last clock record stamped no later than stamp, or size() if there
+      // is none
+      size_t findClock(int64_t stamp) const
+      {
+        const trajectory_log::IndexEntry* begin = index();
+        const trajectory_log::IndexEntry* end = begin + clocks();
+        const trajectory_log::IndexEntry* it = std::upper_bound(begin, end, stamp,
+            [](int64_t stamp, const trajectory_log::IndexEntry& entry) { return stamp < entry.stamp; });
+        if (it == begin)
+          return size();
+
+        return (it - 1)->record;
+      }
+
+    private:
+      // not copyable, because it owns the mapping
+      TrajectoryLogReader(const TrajectoryLogReader&);
+      TrajectoryLogReader& operator=(const TrajectoryLogReader&);
+
+      const char* memory_;
+      size_t size_;
+      const char* index_memory_;
+      size_t index_size_;
+      size_t joints_, record_size_, records_offset_, records_;
+      std::vector<std::string> names_;
+
+      const trajectory_log::IndexEntry* index() const
+      {
+        return reinterpret_cast<const trajectory_log::IndexEntry*>(index_memory_);
+      }
+
+      static const char* map(const std::string& path, size_t& size)
+      {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+          throw std::runtime_error(trajectory_log::error("Could not open", path));
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+          std::string message = trajectory_log::error("Could not inspect", path);
+          ::close(fd);
+          throw std::runtime_error(message);
+        }
+        size = info.st_size;
+        void* memory = size == 0 ? MAP_FAILED : mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (memory == MAP_FAILED)
+          throw std::runtime_error("Could not map trajectory log '" + path + "'.");
+
+        return static_cast<const char*>(memory);
+      }
+  };
+
+  struct ReplayStatistics
+  {
+    ReplayStatistics() : records(0), updates(0), states(0), mismatches(0),
+      first_mismatch(0) {}
+
+    size_t records, updates;
+    // number of recorded states that were compared to the replayed ones, and how many of
+    // them differed in any bit
+    size_t states, mismatches;
+    // position of the first state that differed, if any
+    size_t first_mismatch;
+  };
+
+  // feeds the commands, states and updates of a trajectory log to sim, which has to be set
+  // up like the recorded simulator was before the log started, and compares every recorded
+  // state bit for bit; throws if the log misses records or does not fit sim
+  inline ReplayStatistics replayTrajectory(const TrajectoryLogReader& log, Simulator& sim)
+  {
+    if (log.names() != sim.getJointNames())
+      throw std::runtime_error("Asked to replay a trajectory log of other joints.");
+
+    ReplayStatistics statistics;
+    size_t joints = log.joints();
+    std::map<std::vector<uint64_t>, JointLayout> layouts;
+    std::vector<double> positions(joints), velocities(joints), efforts(joints);
+    for (size_t i=0; i<log.size(); ++i, ++statistics.records)
+    {
+      const trajectory_log::Record* record = log.record(i);
+      if (record->number != i)
+        throw std::runtime_error("Trajectory log misses records before record " +
+            std::to_string(record->number) + ".");
+
+      switch (record->type)
+      {
+        case trajectory_log::COMMAND:
+        case trajectory_log::SET_STATE:
+        {
+          std::vector<uint64_t> mask(trajectory_log::mask(record),
+              trajectory_log::mask(record) + trajectory_log::maskWords(joints));
+          std::map<std::vector<uint64_t>, JointLayout>::iterator layout = layouts.find(mask);
+          if (layout == layouts.end())
+          {
+            std::vector<std::string> names;
+            for (size_t j=0; j<joints; ++j)
+              if (log.isNamed(record, j))
+                names.push_back(log.names()[j]);
+            layout = layouts.insert(std::make_pair(mask, sim.resolveLayout(names))).first;
+          }
+
+          const std::vector<size_t>& named = layout->second.joints;
+          for (size_t j=0; j<named.size(); ++j)
+          {
+            positions[j] = trajectory_log::positions(record, joints)[named[j]];
+            velocities[j] = trajectory_log::velocities(record, joints)[named[j]];
+            efforts[j] = trajectory_log::efforts(record, joints)[named[j]];
+          }
+
+          if (record->type == trajectory_log::COMMAND)
+          {
+            ros::Time now;
+            now.fromNSec(record->stamp);
+            sim.setSubCommand(layout->second, velocities.data(), now);
+          }
+          else
+            sim.setSubJointState(layout->second, positions.data(), velocities.data(),
+                record->flags & trajectory_log::HAS_EFFORT ? efforts.data() : 0);
+          break;
+        }
+        case trajectory_log::UPDATE:
+        {
+          ros::Time now;
+          ros::Duration dt;
+          now.fromNSec(record->stamp);
+          dt.fromNSec(record->duration);
+          sim.update(now, dt);
+          statistics.updates++;
+          break;
+        }
+        case trajectory_log::CLOCK:
+          break;
+        case trajectory_log::STATE:
+        {
+          const JointArrays& state = sim.getJointArrays();
+          size_t size = joints * sizeof(double);
+          bool equal = record->seq == sim.getHeader().seq &&
+            std::memcmp(trajectory_log::positions(record, joints), state.position.data(), size) == 0 &&
+            std::memcmp(trajectory_log::velocities(record, joints), state.velocity.data(), size) == 0 &&
+            std::memcmp(trajectory_log::efforts(record, joints), state.effort.data(), size) == 0;
+          if (!equal && statistics.mismatches++ == 0)
+            statistics.first_mismatch = i;
+          statistics.states++;
+          break;
+        }
+        default:
+          throw std::runtime_error("Trajectory log has a record of unknown type " +
+              std::to_string(record->type) + ".");
+      }
+    }
+
+    return statistics;
+  }
+}
+
+#endif
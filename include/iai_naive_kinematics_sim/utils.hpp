@@ -29,10 +29,18 @@
 #ifndef IAI_NAIVE_KINEMATICS_SIM_UTILS_HPP
 #define IAI_NAIVE_KINEMATICS_SIM_UTILS_HPP
 
+#include <diagnostic_msgs/DiagnosticStatus.h>
 #include <sensor_msgs/JointState.h>
 #include <urdf/model.h>
 #include <exception>
+#include <set>
+#include <sstream>
+#include <iai_naive_kinematics_sim/joint_arrays.hpp>
+#include <iai_naive_kinematics_sim/latency_histogram.hpp>
+#include <iai_naive_kinematics_sim/CompactJointState.h>
+#include <iai_naive_kinematics_sim/JointStateLayout.h>
 #include <iai_naive_kinematics_sim/watchdog.hpp>
+#include <iai_naive_kinematics_sim/watchdog_manager.hpp>
 
 namespace iai_naive_kinematics_sim
 {
@@ -110,6 +118,20 @@ namespace iai_naive_kinematics_sim
           " has fields 'name' and 'velocity' with different sizes: " +
           std::to_string(state.name.size()) + " compared to " +
           std::to_string(state.velocity.size()) + ".");
+    if (!state.effort.empty() && state.name.size() != state.effort.size())
+      throw std::range_error(std::string("State of type sensor_msgs::JointState") +
+          " has fields 'name' and 'effort' with different sizes: " +
+          std::to_string(state.name.size()) + " compared to " +
+          std::to_string(state.effort.size()) + ".");
+  }
+
+  inline void sanityCheckCommand(const sensor_msgs::JointState& command)
+  {
+    if (command.name.size() != command.velocity.size())
+      throw std::range_error(std::string("Command of type sensor_msgs::JointState") +
+          " has fields 'name' and 'velocity' with different sizes: " +
+          std::to_string(command.name.size()) + " compared to " +
+          std::to_string(command.velocity.size()) + ".");
   }
 
   inline bool isMovingJoint(int type)
@@ -148,18 +170,220 @@ namespace iai_naive_kinematics_sim
     return state;
   }
 
-  inline std::map<std::string, Watchdog> makeWatchdogs(const urdf::Model& model,
+  inline WatchdogManager makeWatchdogs(const urdf::Model& model,
       const std::vector<std::string>& controlled_joints, const ros::Duration watchdog_period)
   {
-    std::map<std::string, Watchdog> watchdogs;
+    std::vector<ros::Duration> periods;
     for(size_t i=0; i<controlled_joints.size(); ++i)
       if (!modelHasMovableJoint(model, controlled_joints[i]))
         throw std::runtime_error("URDF model has no movable joint with name '" +
             controlled_joints[i] + "'.");
       else
-        watchdogs[controlled_joints[i]] = Watchdog(watchdog_period);
+        periods.push_back(watchdog_period);
+
+    return WatchdogManager(periods);
+  }
+
+  // resolves watchdog periods given by joint or group name into periods by joint; periods
+  // of joints override those of their groups
+  inline std::map<std::string, double> resolveWatchdogPeriods(
+      const std::map<std::string, double>& periods,
+      const std::map<std::string, std::vector<std::string> >& groups,
+      const std::vector<std::string>& controlled_joints)
+  {
+    std::set<std::string> controlled(controlled_joints.begin(), controlled_joints.end());
+    std::map<std::string, double> result;
+
+    for (std::map<std::string, double>::const_iterator it=periods.begin(); it!=periods.end(); ++it)
+    {
+      if (it->second <= 0.0)
+        throw std::runtime_error("Watchdog period for '" + it->first + "' is not positive.");
+      if (controlled.count(it->first))
+        continue;
+
+      std::map<std::string, std::vector<std::string> >::const_iterator group =
+        groups.find(it->first);
+      if (group == groups.end())
+        throw std::runtime_error("Watchdog period given for '" + it->first +
+            "', which is neither a controlled joint nor a group.");
+
+      for (size_t i=0; i<group->second.size(); ++i)
+        if (!controlled.count(group->second[i]))
+          throw std::runtime_error("Watchdog group '" + it->first + "' contains joint '" +
+              group->second[i] + "', which is not controlled.");
+        else
+          result[group->second[i]] = it->second;
+    }
+
+    for (std::map<std::string, double>::const_iterator it=periods.begin(); it!=periods.end(); ++it)
+      if (controlled.count(it->first))
+        result[it->first] = it->second;
+
+    return result;
+  }
+
+  // a joint state that puts the given joints at the given positions, at rest
+  inline sensor_msgs::JointState makeStartConfig(const std::map<std::string, double>& start_config)
+  {
+    sensor_msgs::JointState joint_state;
+    for (std::map<std::string, double>::const_iterator it=start_config.begin();
+        it!=start_config.end(); ++it)
+      pushBackJointState(joint_state, it->first, it->second, 0.0, 0.0);
+
+    return joint_state;
+  }
+
+  // per-joint information that the simulator needs in its update loop, resolved
+  // once at init-time so that the loop itself can work on indices only
+  struct JointInfo
+  {
+    JointInfo() :
+      type(urdf::Joint::UNKNOWN), limited(false), lower(0.0), upper(0.0),
+      controlled(false), watchdog_slot(0) {}
+
+    int type;
+    bool limited;
+    double lower, upper;
+    bool controlled;
+    size_t watchdog_slot;
+  };
+
+  inline std::vector<JointInfo> makeJointInfos(const urdf::Model& model,
+      const std::vector<std::string>& joint_names,
+      const std::map<std::string, size_t>& watchdog_index_map)
+  {
+    std::vector<JointInfo> infos(joint_names.size());
+    for (size_t i=0; i<joint_names.size(); ++i)
+    {
+      boost::shared_ptr<const urdf::Joint> joint = model.getJoint(joint_names[i]);
+      if (!joint.get())
+        throw std::runtime_error("URDF has no joint with name '" + joint_names[i] + "'.");
+
+      infos[i].type = joint->type;
+      if ((joint->type == urdf::Joint::REVOLUTE || joint->type == urdf::Joint::PRISMATIC) &&
+          joint->limits.get())
+      {
+        infos[i].limited = true;
+        infos[i].lower = joint->limits->lower;
+        infos[i].upper = joint->limits->upper;
+      }
+
+      std::map<std::string, size_t>::const_iterator it = watchdog_index_map.find(joint_names[i]);
+      if (it != watchdog_index_map.end())
+      {
+        infos[i].controlled = true;
+        infos[i].watchdog_slot = it->second;
+      }
+    }
+
+    return infos;
+  }
+
+  inline JointLimitArrays makeJointLimitArrays(const std::vector<JointInfo>& infos)
+  {
+    JointLimitArrays limits;
+    limits.resize(infos.size());
+    for (size_t i=0; i<infos.size(); ++i)
+      if (infos[i].limited)
+      {
+        limits.lower[i] = infos[i].lower;
+        limits.upper[i] = infos[i].upper;
+      }
+
+    return limits;
+  }
+
+  // copies positions, velocities and efforts into a message with the same joint layout
+  inline void copyJointArrays(const JointArrays& arrays, sensor_msgs::JointState& state)
+  {
+    state.position.assign(arrays.position.begin(), arrays.position.end());
+    state.velocity.assign(arrays.velocity.begin(), arrays.velocity.end());
+    state.effort.assign(arrays.effort.begin(), arrays.effort.end());
+  }
+
+  inline void copyJointArrays(const JointArrays& arrays, CompactJointState& state)
+  {
+    state.position.assign(arrays.position.begin(), arrays.position.end());
+    state.velocity.assign(arrays.velocity.begin(), arrays.velocity.end());
+    state.effort.assign(arrays.effort.begin(), arrays.effort.end());
+  }
+
+  // identifies a joint layout by the FNV-1a hash of its names, so that the same joints in
+  // the same order always get the same id
+  inline uint32_t layoutId(const std::vector<std::string>& names)
+  {
+    uint32_t hash = 2166136261u;
+    for (size_t i=0; i<names.size(); ++i)
+      for (size_t j=0; j<=names[i].size(); ++j)
+      {
+        // hash the terminating '\0' as well, so that ["ab", "c"] and ["a", "bc"] differ
+        hash ^= static_cast<unsigned char>(names[i].c_str()[j]);
+        hash *= 16777619u;
+      }
+
+    return hash;
+  }
+
+  inline JointStateLayout makeJointStateLayout(const std::vector<std::string>& names)
+  {
+    JointStateLayout layout;
+    layout.id = layoutId(names);
+    layout.name = names;
+
+    return layout;
+  }
+
+  inline diagnostic_msgs::KeyValue makeKeyValue(const std::string& key, double value)
+  {
+    diagnostic_msgs::KeyValue key_value;
+    key_value.key = key;
+    std::ostringstream out;
+    out << value;
+    key_value.value = out.str();
+
+    return key_value;
+  }
+
+  // for counts, which would lose digits in the floating-point format
+  inline diagnostic_msgs::KeyValue makeKeyValue(const std::string& key, uint64_t value)
+  {
+    diagnostic_msgs::KeyValue key_value;
+    key_value.key = key;
+    key_value.value = std::to_string(value);
+
+    return key_value;
+  }
+
+  // summary of the latencies of snapshot in microseconds
+  inline diagnostic_msgs::DiagnosticStatus makeLatencyStatus(const std::string& name,
+      const LatencySnapshot& snapshot)
+  {
+    diagnostic_msgs::DiagnosticStatus status;
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.name = name;
+    status.message = std::to_string(snapshot.count) + " samples";
+    status.values.push_back(makeKeyValue("count", snapshot.count));
+    status.values.push_back(makeKeyValue("mean_us", 1e-3 * snapshot.mean()));
+    status.values.push_back(makeKeyValue("min_us", 1e-3 * snapshot.min()));
+    status.values.push_back(makeKeyValue("p50_us", 1e-3 * snapshot.percentile(0.5)));
+    status.values.push_back(makeKeyValue("p90_us", 1e-3 * snapshot.percentile(0.9)));
+    status.values.push_back(makeKeyValue("p99_us", 1e-3 * snapshot.percentile(0.99)));
+    status.values.push_back(makeKeyValue("p999_us", 1e-3 * snapshot.percentile(0.999)));
+    status.values.push_back(makeKeyValue("max_us", 1e-3 * snapshot.max()));
+
+    return status;
+  }
+
+  // the non-empty buckets of snapshot, one per line as the largest value of the bucket in
+  // nanoseconds followed by its count
+  inline std::string formatLatencyHistogram(const LatencySnapshot& snapshot)
+  {
+    std::ostringstream out;
+    for (size_t i=0; i<snapshot.counts.size(); ++i)
+      if (snapshot.counts[i] > 0)
+        out << LatencyHistogram::bucketUpperBound(i) << " " << snapshot.counts[i] << "\n";
 
-    return watchdogs;
+    return out.str();
   }
 
   template <class T>
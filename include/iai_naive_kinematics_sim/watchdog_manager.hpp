@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_WATCHDOG_MANAGER_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_WATCHDOG_MANAGER_HPP
+
+#include <ros/ros.h>
+#include <algorithm>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace iai_naive_kinematics_sim
+{
+  // when the watchdogs of a WatchdogManager were last petted and when they expire, by slot
+  struct WatchdogSnapshot
+  {
+    WatchdogSnapshot() : next_tick(0) {}
+
+    std::vector<int64_t> last_pets, deadlines;
+    std::vector<bool> armed;
+    int64_t next_tick;
+  };
+
+  // The watchdogs of all controlled joints, addressed by slot. A watchdog expires once more
+  // than its period has passed since it was last petted, like Watchdog::barks, but the manager
+  // reports that only once, when it happens. Deadlines are kept in a hashed timer wheel: every
+  // armed watchdog sits in the bucket of its deadline, so advancing the time only looks at
+  // the buckets that the time passed, and petting is constant time. Pets only move deadlines,
+  // and a watchdog whose deadline moved on is put into its new bucket when its old one comes up.
+  class WatchdogManager
+  {
+    public:
+      WatchdogManager(const std::vector<ros::Duration>& periods = std::vector<ros::Duration>(),
+          const ros::Duration& resolution = ros::Duration(0.001), size_t buckets = 256) :
+        buckets_(buckets), next_tick_(0), visits_(0)
+      {
+        if (resolution.toNSec() <= 0 || buckets == 0)
+          throw std::runtime_error("Asked to create a watchdog timer wheel without buckets.");
+        resolution_ = resolution.toNSec();
+
+        for (size_t i=0; i<periods.size(); ++i)
+          periods_.push_back(periods[i].toNSec());
+        last_pets_.assign(periods.size(), 0);
+        deadlines_.assign(periods.size(), 0);
+        scheduled_.assign(periods.size(), 0);
+        // never petted watchdogs start out expired, just like a Watchdog at time 0
+        armed_.assign(periods.size(), false);
+        visited_.assign(periods.size(), 0);
+      }
+
+      ~WatchdogManager() {}
+
+      size_t size() const
+      {
+        return periods_.size();
+      }
+
+      ros::Duration getPeriod(size_t slot) const
+      {
+        ros::Duration period;
+        period.fromNSec(periods_.at(slot));
+        return period;
+      }
+
+      // takes effect with the next pet
+      void setPeriod(size_t slot, const ros::Duration& period)
+      {
+        periods_.at(slot) = period.toNSec();
+      }
+
+      ros::Time getLastPetTime(size_t slot) const
+      {
+        ros::Time time;
+        time.fromNSec(last_pets_.at(slot));
+        return time;
+      }
+
+      bool isExpired(size_t slot) const
+      {
+        return !armed_.at(slot);
+      }
+
+      void pet(size_t slot, const ros::Time& now)
+      {
+        int64_t stamp = now.toNSec();
+        last_pets_[slot] = stamp;
+        deadlines_[slot] = stamp + periods_[slot] + 1;
+
+        int64_t tick = tickOf(deadlines_[slot]);
+        if (!armed_[slot] || tick < scheduled_[slot])
+        {
+          armed_[slot] = true;
+          schedule(slot, tick);
+        }
+      }
+
+      // assigns into snapshot, so that a snapshot that is taken repeatedly does not allocate
+      void snapshot(WatchdogSnapshot& snapshot) const
+      {
+        snapshot.last_pets = last_pets_;
+        snapshot.deadlines = deadlines_;
+        snapshot.armed = armed_;
+        snapshot.next_tick = next_tick_;
+      }
+
+      // sets the watchdogs back to a snapshot of a manager with as many slots; the periods
+      // stay as they are, and take effect with the next pet
+      void restore(const WatchdogSnapshot& snapshot)
+      {
+        if (snapshot.last_pets.size() != size() || snapshot.deadlines.size() != size() ||
+            snapshot.armed.size() != size())
+          throw std::runtime_error("Asked to restore a snapshot of " +
+              std::to_string(snapshot.armed.size()) + " watchdogs into a manager of " +
+              std::to_string(size()) + " watchdogs.");
+
+        last_pets_ = snapshot.last_pets;
+        deadlines_ = snapshot.deadlines;
+        armed_ = snapshot.armed;
+        next_tick_ = snapshot.next_tick;
+        for (size_t i=0; i<buckets_.size(); ++i)
+          buckets_[i].clear();
+        for (size_t slot=0; slot<size(); ++slot)
+          if (armed_[slot])
+            schedule(slot, tickOf(deadlines_[slot]));
+      }
+
+      // returns the slots that expired since the previous call, in no particular order
+      const std::vector<size_t>& advance(const ros::Time& now)
+      {
+        int64_t stamp = now.toNSec();
+        int64_t tick = tickOf(stamp);
+        expired_.clear();
+
+        // after time jumped back, the buckets are simply visited again
+        int64_t first = std::max(next_tick_, tick - static_cast<int64_t>(buckets_.size()) + 1);
+        if (tick < next_tick_)
+          first = tick;
+
+        for (int64_t t=first; t<=tick; ++t)
+          visit(t, stamp);
+
+        // the current bucket may hold deadlines later in this tick, so visit it again next time
+        next_tick_ = tick;
+        return expired_;
+      }
+
+    private:
+      int64_t resolution_;
+      std::vector< std::vector<size_t> > buckets_;
+      int64_t next_tick_;
+
+      // by slot; deadline is the first time at which the watchdog counts as expired
+      std::vector<int64_t> periods_, last_pets_, deadlines_, scheduled_;
+      std::vector<bool> armed_;
+      // number of the visit that last looked at each slot, to skip duplicate bucket entries
+      std::vector<uint64_t> visited_;
+      uint64_t visits_;
+
+      std::vector<size_t> expired_, visiting_;
+
+      int64_t tickOf(int64_t stamp) const
+      {
+        return stamp / resolution_;
+      }
+
+      std::vector<size_t>& bucket(int64_t tick)
+      {
+        return buckets_[static_cast<uint64_t>(tick) % buckets_.size()];
+      }
+
+      void schedule(size_t slot, int64_t tick)
+      {
+        scheduled_[slot] = tick;
+        bucket(tick).push_back(slot);
+      }
+
+      void visit(int64_t tick, int64_t now)
+      {
+        std::vector<size_t>& current = bucket(tick);
+        visiting_.swap(current);
+        visits_++;
+
+        for (size_t i=0; i<visiting_.size(); ++i)
+        {
+          size_t slot = visiting_[i];
+
+          // disarmed, re-scheduled into another bucket by an earlier deadline, or seen already
+          if (!armed_[slot] || &bucket(scheduled_[slot]) != &current || visited_[slot] == visits_)
+            continue;
+          visited_[slot] = visits_;
+
+          if (deadlines_[slot] <= now)
+          {
+            armed_[slot] = false;
+            expired_.push_back(slot);
+          }
+          else
+            schedule(slot, tickOf(deadlines_[slot]));
+        }
+
+        visiting_.clear();
+      }
+  };
+}
+
+#endif
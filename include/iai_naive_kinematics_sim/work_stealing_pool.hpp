@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_WORK_STEALING_POOL_HPP
+#define IAI_NAIVE_KINEMATICS_SIM_WORK_STEALING_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <iai_naive_kinematics_sim/threads.hpp>
+
+namespace iai_naive_kinematics_sim
+{
+  // a fixed set of worker threads, each with its own task queue. Tasks given to run() from
+  // outside are dealt to the queues in turn; tasks that a running task gives to run() go to
+  // the back of the queue of its own worker. A worker takes the newest task from the back of
+  // its own queue, and when that runs dry, steals the oldest task from the front of the
+  // queues of the workers after it, in order of their index.
+  class WorkStealingPool
+  {
+    public:
+      // starts the given number of workers; if cpus is not empty, worker i is pinned to
+      // cpus[i % cpus.size()]
+      WorkStealingPool(size_t threads, const std::vector<int>& cpus = std::vector<int>()) :
+        queued_(0), next_queue_(0), stop_(false)
+      {
+        if (threads == 0)
+          throw std::runtime_error("Asked to start a thread pool without threads.");
+
+        for (size_t i=0; i<threads; ++i)
+          queues_.push_back(std::unique_ptr<Queue>(new Queue()));
+
+        try
+        {
+          for (size_t i=0; i<threads; ++i)
+          {
+            workers_.push_back(std::thread(&WorkStealingPool::work, this, i));
+            if (!cpus.empty())
+              pinThread(workers_.back(), cpus[i % cpus.size()]);
+          }
+        }
+        catch (...)
+        {
+          shutdown();
+          throw;
+        }
+      }
+
+      ~WorkStealingPool()
+      {
+        shutdown();
+      }
+
+      size_t size() const
+      {
+        return workers_.size();
+      }
+
+      // runs all tasks on the workers, and blocks until they are done; the first exception
+      // thrown by any of the tasks is re-thrown; several threads may call this concurrently,
+      // and so may the tasks themselves, whose worker then runs tasks instead of blocking;
+      // throws once the pool shuts down
+      void run(const std::vector< std::function<void()> >& tasks)
+      {
+        std::shared_ptr<Batch> batch(new Batch(tasks.size()));
+        const Worker& worker = currentWorker();
+        bool nested = worker.pool == this;
+
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (stop_)
+            throw std::runtime_error("Asked to run tasks on a thread pool that shut down.");
+          for (size_t i=0; i<tasks.size(); ++i)
+          {
+            Queue& queue = *queues_[nested ? worker.index : next_queue_++ % queues_.size()];
+            std::lock_guard<std::mutex> queue_lock(queue.mutex);
+            queue.tasks.push_back(makeTask(tasks[i], batch));
+          }
+          queued_ += tasks.size();
+        }
+        wake_.notify_all();
+
+        // a worker that waited here could take the last free worker, and stall its own tasks
+        if (nested)
+        {
+          std::function<void()> task;
+          while (!batch->isDone() && pop(worker.index, task))
+            task();
+        }
+
+        std::unique_lock<std::mutex> lock(batch->mutex);
+        batch->done.wait(lock, [&batch] { return batch->remaining == 0; });
+        if (batch->error)
+          std::rethrow_exception(batch->error);
+      }
+
+      // runs the tasks that are still queued, and stops the workers; calls of run() that
+      // wait for their tasks return normally
+      void shutdown()
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          stop_ = true;
+        }
+        wake_.notify_all();
+
+        for (size_t i=0; i<workers_.size(); ++i)
+          if (workers_[i].joinable())
+            workers_[i].join();
+      }
+
+    private:
+      struct Queue
+      {
+        std::mutex mutex;
+        std::deque< std::function<void()> > tasks;
+      };
+
+      // book-keeping of the tasks given to a single call of run()
+      struct Batch
+      {
+        Batch(size_t size) : remaining(size) {}
+
+        bool isDone()
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          return remaining == 0;
+        }
+
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t remaining;
+        std::exception_ptr error;
+      };
+
+      std::vector< std::unique_ptr<Queue> > queues_;
+      std::vector<std::thread> workers_;
+
+      // number of tasks sitting in any of the queues; guarded by mutex_ when raised, so that
+      // sleeping workers cannot miss new tasks
+      std::atomic<size_t> queued_;
+      size_t next_queue_;
+      bool stop_;
+      std::mutex mutex_;
+      std::condition_variable wake_;
+
+      // the pool and queue of the worker running on this thread, if any
+      struct Worker
+      {
+        Worker() : pool(0), index(0) {}
+
+        const WorkStealingPool* pool;
+        size_t index;
+      };
+
+      static Worker& currentWorker()
+      {
+        static thread_local Worker worker;
+        return worker;
+      }
+
+      static std::function<void()> makeTask(const std::function<void()>& task,
+          const std::shared_ptr<Batch>& batch)
+      {
+        return [task, batch]()
+        {
+          std::exception_ptr error;
+          try
+          {
+            task();
+          }
+          catch (...)
+          {
+            error = std::current_exception();
+          }
+
+          std::lock_guard<std::mutex> lock(batch->mutex);
+          if (error && !batch->error)
+            batch->error = error;
+          if (--batch->remaining == 0)
+            batch->done.notify_all();
+        };
+      }
+
+      bool pop(size_t index, std::function<void()>& task)
+      {
+        for (size_t i=0; i<queues_.size(); ++i)
+        {
+          Queue& queue = *queues_[(index + i) % queues_.size()];
+          std::lock_guard<std::mutex> lock(queue.mutex);
+          if (queue.tasks.empty())
+            continue;
+
+          if (i == 0)
+          {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+          }
+          else
+          {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+          }
+          queued_--;
+          return true;
+        }
+
+        return false;
+      }
+
+      void work(size_t index)
+      {
+        currentWorker().pool = this;
+        currentWorker().index = index;
+
+        while (true)
+        {
+          std::function<void()> task;
+          if (pop(index, task))
+          {
+            task();
+            continue;
+          }
+
+          std::unique_lock<std::mutex> lock(mutex_);
+          wake_.wait(lock, [this] { return stop_ || queued_ > 0; });
+          // the queues are only left behind empty, so nobody waits for their tasks forever
+          if (stop_ && queued_ == 0)
+            return;
+        }
+      }
+  };
+}
+
+#endif
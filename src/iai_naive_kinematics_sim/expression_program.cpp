@@ -0,0 +1,281 @@
+#include "iai_naive_kinematics_sim/expression_program.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace iai_naive_kinematics_sim {
+
+	static inline double& jointValue(JointArrays& state, OpCode op, size_t joint) {
+		switch (op) {
+			case OP_LOAD_VEL:
+			case OP_STORE_VEL: return state.velocity[joint];
+			case OP_LOAD_EFF:
+			case OP_STORE_EFF: return state.effort[joint];
+			default: return state.position[joint];
+		}
+	}
+
+	void ExpressionProgram::initState(ProgramState& state) const {
+		state.registers = initialRegisters;
+		state.inputs.assign(inputs.size(), 0.0);
+		state.outputs.assign(segments.size(), 0.0);
+		state.valid = false;
+	}
+
+	// FNV-1a, like layoutId()
+	static inline void hashBytes(uint32_t& hash, const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 16777619u;
+		}
+	}
+
+	template<class T>
+	static inline void hashValue(uint32_t& hash, const T& value) {
+		hashBytes(hash, &value, sizeof(value));
+	}
+
+	uint32_t ExpressionProgram::fingerprint() const {
+		uint32_t hash = 2166136261u;
+		// the sizes keep programs that only differ in where a vector ends apart
+		hashValue(hash, code.size());
+		for (size_t i = 0; i < code.size(); i++) {
+			hashValue(hash, static_cast<uint32_t>(code[i].op));
+			hashValue(hash, code[i].dst);
+			hashValue(hash, code[i].a);
+			hashValue(hash, code[i].b);
+		}
+		hashValue(hash, initialRegisters.size());
+		for (size_t i = 0; i < initialRegisters.size(); i++)
+			hashValue(hash, initialRegisters[i]);
+		hashValue(hash, segments.size());
+		for (size_t i = 0; i < segments.size(); i++) {
+			hashValue(hash, segments[i].begin);
+			hashValue(hash, segments[i].end);
+			hashValue(hash, segments[i].inputsBegin);
+			hashValue(hash, segments[i].inputsEnd);
+		}
+		hashValue(hash, inputs.size());
+		for (size_t i = 0; i < inputs.size(); i++) {
+			hashValue(hash, static_cast<uint32_t>(inputs[i].first));
+			hashValue(hash, inputs[i].second);
+		}
+		return hash;
+	}
+
+	void ExpressionProgram::run(JointArrays& state, const JointLimitArrays& limits, ProgramState& programState) const {
+		double* r = programState.registers.data();
+
+		for (size_t s = 0; s < segments.size(); s++) {
+			const Segment& segment = segments[s];
+			const Instruction& store = code[segment.end - 1];
+			bool dirty = !programState.valid || jointValue(state, store.op, store.dst) != programState.outputs[s];
+
+			for (uint32_t i = segment.inputsBegin; i < segment.inputsEnd; i++) {
+				double value = jointValue(state, inputs[i].first, inputs[i].second);
+				if (value != programState.inputs[i]) {
+					programState.inputs[i] = value;
+					dirty = true;
+				}
+			}
+
+			if (dirty) {
+				execute(segment, state, limits, r);
+				programState.outputs[s] = jointValue(state, store.op, store.dst);
+			}
+		}
+
+		programState.valid = true;
+	}
+
+	void ExpressionProgram::execute(const Segment& segment, JointArrays& state, const JointLimitArrays& limits, double* r) const {
+		const Instruction* end = code.data() + segment.end;
+
+		for (const Instruction* in = code.data() + segment.begin; in != end; in++) {
+			switch (in->op) {
+				case OP_LOAD_POS: r[in->dst] = state.position[in->a]; break;
+				case OP_LOAD_VEL: r[in->dst] = state.velocity[in->a]; break;
+				case OP_LOAD_EFF: r[in->dst] = state.effort[in->a]; break;
+				case OP_ADD: r[in->dst] = r[in->a] + r[in->b]; break;
+				case OP_SUB: r[in->dst] = r[in->a] - r[in->b]; break;
+				case OP_MUL: r[in->dst] = r[in->a] * r[in->b]; break;
+				case OP_DIV: r[in->dst] = r[in->a] / r[in->b]; break;
+				case OP_MIN: r[in->dst] = min(r[in->a], r[in->b]); break;
+				case OP_MAX: r[in->dst] = max(r[in->a], r[in->b]); break;
+				case OP_ABS: r[in->dst] = abs(r[in->a]); break;
+				case OP_SIN: r[in->dst] = sin(r[in->a]); break;
+				case OP_COS: r[in->dst] = cos(r[in->a]); break;
+				case OP_STORE_POS:
+					state.position[in->dst] = r[in->a];
+					clampJoint(state.position[in->dst], state.velocity[in->dst],
+						limits.lower[in->dst], limits.upper[in->dst]);
+					break;
+				case OP_STORE_VEL: state.velocity[in->dst] = r[in->a]; break;
+				case OP_STORE_EFF: state.effort[in->dst] = r[in->a]; break;
+			}
+		}
+	}
+
+	void ExpressionProgram::initBatchRegisters(size_t worlds, vector<double>& registers) const {
+		registers.resize(initialRegisters.size() * worlds);
+		for (size_t i = 0; i < initialRegisters.size(); i++)
+			fill(registers.begin() + i * worlds, registers.begin() + (i + 1) * worlds, initialRegisters[i]);
+	}
+
+	void ExpressionProgram::runBatch(JointArrays& state, const JointLimitArrays& limits, size_t worlds, vector<double>& registers) const {
+		double* r = registers.data();
+
+		for (size_t i = 0; i < code.size(); i++) {
+			const Instruction& in = code[i];
+
+			// loads and stores address joints, everything else registers
+			if (in.op == OP_LOAD_POS || in.op == OP_LOAD_VEL || in.op == OP_LOAD_EFF) {
+				const double* src = &jointValue(state, in.op, in.a * worlds);
+				copy(src, src + worlds, r + in.dst * worlds);
+				continue;
+			}
+
+			const double* a = r + in.a * worlds;
+			if (in.op == OP_STORE_POS || in.op == OP_STORE_VEL || in.op == OP_STORE_EFF) {
+				double* dst = &jointValue(state, in.op, in.dst * worlds);
+				copy(a, a + worlds, dst);
+				if (in.op == OP_STORE_POS) {
+					for (size_t j = in.dst * worlds; j < (in.dst + 1) * worlds; j++)
+						clampJoint(state.position[j], state.velocity[j], limits.lower[j], limits.upper[j]);
+				}
+				continue;
+			}
+
+			double* dst = r + in.dst * worlds;
+			const double* b = r + in.b * worlds;
+			switch (in.op) {
+				case OP_ADD: for (size_t w = 0; w < worlds; w++) dst[w] = a[w] + b[w]; break;
+				case OP_SUB: for (size_t w = 0; w < worlds; w++) dst[w] = a[w] - b[w]; break;
+				case OP_MUL: for (size_t w = 0; w < worlds; w++) dst[w] = a[w] * b[w]; break;
+				case OP_DIV: for (size_t w = 0; w < worlds; w++) dst[w] = a[w] / b[w]; break;
+				case OP_MIN: for (size_t w = 0; w < worlds; w++) dst[w] = min(a[w], b[w]); break;
+				case OP_MAX: for (size_t w = 0; w < worlds; w++) dst[w] = max(a[w], b[w]); break;
+				case OP_ABS: for (size_t w = 0; w < worlds; w++) dst[w] = abs(a[w]); break;
+				case OP_SIN: for (size_t w = 0; w < worlds; w++) dst[w] = sin(a[w]); break;
+				case OP_COS: for (size_t w = 0; w < worlds; w++) dst[w] = cos(a[w]); break;
+				default: break;
+			}
+		}
+	}
+
+	double evaluateOp(OpCode op, double a, double b) {
+		switch (op) {
+			case OP_ADD: return a + b;
+			case OP_SUB: return a - b;
+			case OP_MUL: return a * b;
+			case OP_DIV: return a / b;
+			case OP_MIN: return min(a, b);
+			case OP_MAX: return max(a, b);
+			case OP_ABS: return abs(a);
+			case OP_SIN: return sin(a);
+			case OP_COS: return cos(a);
+			default: break;
+		}
+
+		throw runtime_error("Op code " + to_string(op) + " is no arithmetic operation.");
+	}
+
+	uint32_t ExpressionCompiler::newRegister(double value, bool isConstant) {
+		prog.initialRegisters.push_back(value);
+		constantRegisters.push_back(isConstant);
+		registerInputs.push_back(set<JointValue>());
+		return prog.initialRegisters.size() - 1;
+	}
+
+	uint32_t ExpressionCompiler::emit(OpCode op, uint32_t a, uint32_t b) {
+		ValueKey key(op, a, b);
+		auto it = values.find(key);
+		if (it != values.end())
+			return it->second;
+
+		uint32_t dst = newRegister(0.0, false);
+		prog.code.push_back(Instruction(op, dst, a, b));
+		values[key] = dst;
+		if (op == OP_LOAD_POS || op == OP_LOAD_VEL || op == OP_LOAD_EFF) {
+			registerInputs[dst].insert(JointValue(op, a));
+		} else {
+			registerInputs[dst] = registerInputs[a];
+			if (op != OP_ABS && op != OP_SIN && op != OP_COS)
+				registerInputs[dst].insert(registerInputs[b].begin(), registerInputs[b].end());
+		}
+		return dst;
+	}
+
+	uint32_t ExpressionCompiler::constant(double value) {
+		uint64_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		auto it = constants.find(bits);
+		if (it != constants.end())
+			return it->second;
+
+		uint32_t dst = newRegister(value, true);
+		constants[bits] = dst;
+		return dst;
+	}
+
+	uint32_t ExpressionCompiler::load(OpCode op, size_t joint) {
+		// loads are keyed by the version of the joint value instead of a second argument
+		return emit(op, joint, versions[make_pair(op, joint)]);
+	}
+
+	uint32_t ExpressionCompiler::unary(OpCode op, uint32_t a) {
+		if (constantRegisters[a])
+			return constant(evaluateOp(op, prog.initialRegisters[a], 0.0));
+
+		return emit(op, a, 0);
+	}
+
+	uint32_t ExpressionCompiler::binary(OpCode op, uint32_t a, uint32_t b) {
+		if (constantRegisters[a] && constantRegisters[b])
+			return constant(evaluateOp(op, prog.initialRegisters[a], prog.initialRegisters[b]));
+
+		// addition and multiplication commute bit-exactly, so they share a canonical order
+		if ((op == OP_ADD || op == OP_MUL) && b < a)
+			swap(a, b);
+
+		return emit(op, a, b);
+	}
+
+	void ExpressionCompiler::store(OpCode op, size_t joint, uint32_t a) {
+		prog.code.push_back(Instruction(op, joint, a, 0));
+
+		// everything since the previous store belongs to the segment of this one
+		Segment segment;
+		segment.begin = prog.segments.empty() ? 0 : prog.segments.back().end;
+		segment.end = prog.code.size();
+		segment.inputsBegin = prog.inputs.size();
+		prog.inputs.insert(prog.inputs.end(), registerInputs[a].begin(), registerInputs[a].end());
+		segment.inputsEnd = prog.inputs.size();
+		prog.segments.push_back(segment);
+
+		set<JointValue> written = writtenBy(op, joint);
+		for (auto it = written.begin(); it != written.end(); it++)
+			versions[*it]++;
+	}
+
+	set<JointValue> writtenBy(OpCode store, size_t joint) {
+		set<JointValue> written;
+		switch (store) {
+			case OP_STORE_POS:
+				// storing a position clamps it, which may also stop the joint
+				written.insert(JointValue(OP_LOAD_POS, joint));
+				written.insert(JointValue(OP_LOAD_VEL, joint));
+				break;
+			case OP_STORE_VEL: written.insert(JointValue(OP_LOAD_VEL, joint)); break;
+			case OP_STORE_EFF: written.insert(JointValue(OP_LOAD_EFF, joint)); break;
+			default: break;
+		}
+		return written;
+	}
+
+}
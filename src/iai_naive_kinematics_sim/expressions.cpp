@@ -2,6 +2,9 @@
 #include "iai_naive_kinematics_sim/simulator.hpp"
 
 #include <iostream>
+#include <map>
+#include <set>
+#include <stdexcept>
 
 namespace iai_naive_kinematics_sim {
 
@@ -10,6 +13,10 @@ namespace iai_naive_kinematics_sim {
 		   unordered_map<size_t, Expression<double>*>& velExprs,
 		   unordered_map<size_t, Expression<double>*>& effExprs) {
 
+		// accept whole configuration files, as well as their list of fake controllers
+		if (root.IsMap() && root["fake-controllers"])
+			return parseYAML(root["fake-controllers"], posExprs, velExprs, effExprs);
+
 		if (root.IsSequence()) {
 
 			for (size_t i = 0; i < root.size(); i++)
@@ -34,12 +41,14 @@ namespace iai_naive_kinematics_sim {
 							}
 						}
 
-						if (root[i].begin()->second["velocitiy"]) {
-							Expression<double>* velExp = parseDoubleExpr(root[i].begin()->second["velocitiy"]);
+						// 'velocitiy' is still accepted for older configurations
+						string velKey = root[i].begin()->second["velocity"] ? "velocity" : "velocitiy";
+						if (root[i].begin()->second[velKey]) {
+							Expression<double>* velExp = parseDoubleExpr(root[i].begin()->second[velKey]);
 							if (velExp) {
 								velExprs[idx] = velExp;
 							} else {
-								cerr << "Parsing of velocitiy expression for joint '" << jointName << "' failed! Node: " << endl << root[i].begin()->second << endl;
+								cerr << "Parsing of velocity expression for joint '" << jointName << "' failed! Node: " << endl << root[i].begin()->second << endl;
 								return false;
 							}
 						}
@@ -69,6 +78,81 @@ namespace iai_naive_kinematics_sim {
 		return true;
 	}
 
+	ExpressionProgram ExpressionTree::compile(const unordered_map<size_t, Expression<double>*>& posExprs,
+											  const unordered_map<size_t, Expression<double>*>& velExprs,
+											  const unordered_map<size_t, Expression<double>*>& effExprs) {
+		// targets ordered by joint index, so that the program does not depend on hashing
+		map<pair<size_t, OpCode>, Expression<double>*> targets;
+		for (auto it = posExprs.begin(); it != posExprs.end(); it++)
+			targets[make_pair(it->first, OP_STORE_POS)] = it->second;
+		for (auto it = velExprs.begin(); it != velExprs.end(); it++)
+			targets[make_pair(it->first, OP_STORE_VEL)] = it->second;
+		for (auto it = effExprs.begin(); it != effExprs.end(); it++)
+			targets[make_pair(it->first, OP_STORE_EFF)] = it->second;
+
+		vector<size_t> joints;
+		vector<OpCode> stores;
+		vector<Expression<double>*> exprs;
+		for (auto it = targets.begin(); it != targets.end(); it++) {
+			joints.push_back(it->first.first);
+			stores.push_back(it->first.second);
+			exprs.push_back(it->second);
+		}
+
+		// find out which joint values each expression reads, using a throw-away compiler
+		ExpressionCompiler scratch;
+		vector<set<JointValue>> reads;
+		for (size_t i = 0; i < exprs.size(); i++)
+			reads.push_back(scratch.inputsOf(exprs[i]->compile(scratch)));
+
+		vector<size_t> missing(exprs.size(), 0);
+		vector<vector<size_t>> dependents(exprs.size());
+		for (size_t k = 0; k < exprs.size(); k++) {
+			set<JointValue> written = writtenBy(stores[k], joints[k]);
+			for (size_t i = 0; i < exprs.size(); i++) {
+				if (i == k)
+					continue;
+
+				for (auto it = written.begin(); it != written.end(); it++) {
+					if (reads[i].count(*it)) {
+						dependents[k].push_back(i);
+						missing[i]++;
+						break;
+					}
+				}
+			}
+		}
+
+		// topological sort, always picking the lowest ready target to stay deterministic
+		set<size_t> ready;
+		for (size_t i = 0; i < exprs.size(); i++)
+			if (missing[i] == 0)
+				ready.insert(i);
+
+		ExpressionCompiler compiler;
+		size_t compiled = 0;
+		while (!ready.empty()) {
+			size_t i = *ready.begin();
+			ready.erase(ready.begin());
+			compiler.store(stores[i], joints[i], exprs[i]->compile(compiler));
+			compiled++;
+
+			for (size_t k = 0; k < dependents[i].size(); k++)
+				if (--missing[dependents[i][k]] == 0)
+					ready.insert(dependents[i][k]);
+		}
+
+		if (compiled < exprs.size()) {
+			string names;
+			for (size_t i = 0; i < exprs.size(); i++)
+				if (missing[i] > 0)
+					names += " '" + sim->state_msg_.name[joints[i]] + "'";
+			throw runtime_error("Fake controllers of the joints" + names + " depend on each other in a cycle.");
+		}
+
+		return compiler.program();
+	}
+
 	Expression<double>* ExpressionTree::parseDoubleExpr(const YAML::Node& node){
 		switch(node.Type()) {
 			case YAML::NodeType::Scalar:
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iai_naive_kinematics_sim/robot_generator.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+using namespace iai_naive_kinematics_sim;
+
+static void usage(const char* program)
+{
+  std::cerr << "Usage: " << program << " [options] OUTPUT_PREFIX" << std::endl <<
+    "Writes OUTPUT_PREFIX.urdf, OUTPUT_PREFIX_config.yaml and, if the robot has fingers, " <<
+    "OUTPUT_PREFIX_fake_controllers.yaml." << std::endl << std::endl <<
+    "Options:" << std::endl <<
+    "  --name NAME               name of the robot" << std::endl <<
+    "  --chains N                number of chains attached to the base link" << std::endl <<
+    "  --depth N                 number of joints per chain" << std::endl <<
+    "  --joint-types T1,T2,...   types of the joints along each chain, repeated as needed;" << std::endl <<
+    "                            revolute, continuous, prismatic or fixed" << std::endl <<
+    "  --fingers N               number of fake-controlled fingers at the end of each chain" << std::endl <<
+    "  --expression-depth N      nesting depth of the fake controller expressions" << std::endl <<
+    "  --sharing N               number of fingers that follow the same joint" << std::endl;
+}
+
+static size_t parseCount(const std::string& option, const std::string& value)
+{
+  char* end = 0;
+  long count = std::strtol(value.c_str(), &end, 10);
+  if (value.empty() || *end != '\0' || count < 0)
+    throw std::runtime_error("Option " + option + " needs a non-negative number, got '" + value + "'.");
+  return count;
+}
+
+static std::vector<std::string> parseList(const std::string& value)
+{
+  std::vector<std::string> list;
+  std::istringstream in(value);
+  std::string item;
+  while (std::getline(in, item, ','))
+    list.push_back(item);
+  return list;
+}
+
+static void writeFile(const std::string& path, const std::string& content)
+{
+  std::ofstream out(path.c_str());
+  out << content;
+  if (!out)
+    throw std::runtime_error("Could not write '" + path + "'.");
+  std::cout << "Wrote " << path << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+  try
+  {
+    RobotGeneratorConfig config;
+    std::string prefix;
+    for (int i=1; i<argc; ++i)
+    {
+      std::string arg = argv[i];
+      if (arg == "-h" || arg == "--help")
+      {
+        usage(argv[0]);
+        return 0;
+      }
+      else if (arg.compare(0, 2, "--") != 0)
+      {
+        if (!prefix.empty())
+          throw std::runtime_error("Got more than one output prefix.");
+        prefix = arg;
+        continue;
+      }
+
+      if (i+1 == argc)
+        throw std::runtime_error("Option " + arg + " needs a value.");
+      std::string value = argv[++i];
+      if (arg == "--name")
+        config.name = value;
+      else if (arg == "--chains")
+        config.chains = parseCount(arg, value);
+      else if (arg == "--depth")
+        config.chain_depth = parseCount(arg, value);
+      else if (arg == "--joint-types")
+        config.joint_types = parseList(value);
+      else if (arg == "--fingers")
+        config.fingers = parseCount(arg, value);
+      else if (arg == "--expression-depth")
+        config.expression_depth = parseCount(arg, value);
+      else if (arg == "--sharing")
+        config.sharing = parseCount(arg, value);
+      else
+        throw std::runtime_error("Unknown option " + arg + ".");
+    }
+
+    if (prefix.empty())
+    {
+      usage(argv[0]);
+      return 1;
+    }
+
+    RobotGenerator generator(config);
+    writeFile(prefix + ".urdf", generator.makeURDF());
+
+    std::string fake_controllers_uri;
+    if (config.fingers > 0)
+    {
+      std::string path = prefix + "_fake_controllers.yaml";
+      writeFile(path, YAML::Dump(generator.makeFakeControllers()) + "\n");
+      char* absolute = realpath(path.c_str(), 0);
+      fake_controllers_uri = "file://" + std::string(absolute ? absolute : path.c_str());
+      std::free(absolute);
+    }
+
+    writeFile(prefix + "_config.yaml", YAML::Dump(generator.makeConfig(fake_controllers_uri)) + "\n");
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iai_naive_kinematics_sim/kinematics_sim.hpp>
+#include <iai_naive_kinematics_sim/simulator.hpp>
+#include <yaml-cpp/yaml.h>
+#include <fstream>
+#include <sstream>
+
+namespace iai_naive_kinematics_sim
+{
+  static ros::Time toTime(int64_t stamp)
+  {
+    if (stamp < 0)
+      throw std::runtime_error("Asked to simulate at a negative time stamp.");
+
+    ros::Time time;
+    time.fromNSec(stamp);
+    return time;
+  }
+
+  static ros::Duration toDuration(int64_t duration)
+  {
+    ros::Duration result;
+    result.fromNSec(duration);
+    return result;
+  }
+
+  static int64_t toNSec(KinematicsSim::Clock::duration duration)
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+  }
+
+  KinematicsSimSnapshot::KinematicsSimSnapshot() : snapshot_(new SimulatorSnapshot()) {}
+
+  KinematicsSimSnapshot::KinematicsSimSnapshot(const KinematicsSimSnapshot& other) :
+    snapshot_(new SimulatorSnapshot(*other.snapshot_)) {}
+
+  KinematicsSimSnapshot& KinematicsSimSnapshot::operator=(const KinematicsSimSnapshot& other)
+  {
+    *snapshot_ = *other.snapshot_;
+    return *this;
+  }
+
+  KinematicsSimSnapshot::~KinematicsSimSnapshot() {}
+
+  KinematicsSim::KinematicsSim() : sim_(new Simulator()) {}
+
+  KinematicsSim::KinematicsSim(const KinematicsSim& other) : sim_(new Simulator(*other.sim_)) {}
+
+  KinematicsSim& KinematicsSim::operator=(const KinematicsSim& other)
+  {
+    *sim_ = *other.sim_;
+    return *this;
+  }
+
+  KinematicsSim::~KinematicsSim() {}
+
+  void KinematicsSim::init(const std::string& urdf, const KinematicsSimConfig& config)
+  {
+    urdf::Model model;
+    if (!model.initString(urdf))
+      throw std::runtime_error("Could not parse given robot description.");
+    if (config.watchdog_period <= 0.0)
+      throw std::runtime_error("Read a non-positive watchdog period.");
+
+    sim_->init(model, config.simulated_joints, config.controlled_joints,
+        ros::Duration(config.watchdog_period), YAML::Load(config.fake_controllers));
+
+    std::map<std::string, double> periods = resolveWatchdogPeriods(config.watchdog_periods,
+        config.watchdog_groups, config.controlled_joints);
+    for (std::map<std::string, double>::const_iterator it=periods.begin(); it!=periods.end(); ++it)
+      sim_->setWatchdogPeriod(it->first, ros::Duration(it->second));
+
+    if (!config.start_config.empty())
+      sim_->setSubJointState(makeStartConfig(config.start_config));
+  }
+
+  void KinematicsSim::initFile(const std::string& urdf_path, const KinematicsSimConfig& config)
+  {
+    std::ifstream file(urdf_path.c_str());
+    if (!file)
+      throw std::runtime_error("Could not read URDF '" + urdf_path + "'.");
+
+    std::stringstream urdf;
+    urdf << file.rdbuf();
+    init(urdf.str(), config);
+  }
+
+  size_t KinematicsSim::size() const
+  {
+    return sim_->size();
+  }
+
+  const std::vector<std::string>& KinematicsSim::getJointNames() const
+  {
+    return sim_->getJointNames();
+  }
+
+  JointLayout KinematicsSim::resolveLayout(const std::vector<std::string>& names) const
+  {
+    return sim_->resolveLayout(names);
+  }
+
+  void KinematicsSim::setState(const JointLayout& layout, const double* positions,
+      const double* velocities, const double* efforts)
+  {
+    sim_->setSubJointState(layout, positions, velocities, efforts);
+  }
+
+  void KinematicsSim::setCommand(const JointLayout& layout, const double* velocities,
+      int64_t now)
+  {
+    sim_->setSubCommand(layout, velocities, toTime(now));
+  }
+
+  void KinematicsSim::setCommand(const JointLayout& layout, const double* velocities,
+      Clock::time_point now)
+  {
+    setCommand(layout, velocities, toNSec(now.time_since_epoch()));
+  }
+
+  void KinematicsSim::update(int64_t now, int64_t dt, size_t substeps)
+  {
+    sim_->substep(toTime(now), toDuration(dt), substeps);
+  }
+
+  void KinematicsSim::update(Clock::time_point now, Clock::duration dt, size_t substeps)
+  {
+    update(toNSec(now.time_since_epoch()), toNSec(dt), substeps);
+  }
+
+  const double* KinematicsSim::getPositions() const
+  {
+    return sim_->getJointArrays().position.data();
+  }
+
+  const double* KinematicsSim::getVelocities() const
+  {
+    return sim_->getJointArrays().velocity.data();
+  }
+
+  const double* KinematicsSim::getEfforts() const
+  {
+    return sim_->getJointArrays().effort.data();
+  }
+
+  int64_t KinematicsSim::getStamp() const
+  {
+    return sim_->getHeader().stamp.toNSec();
+  }
+
+  uint32_t KinematicsSim::getSequence() const
+  {
+    return sim_->getHeader().seq;
+  }
+
+  void KinematicsSim::snapshot(KinematicsSimSnapshot& snapshot) const
+  {
+    sim_->snapshot(*snapshot.snapshot_);
+  }
+
+  void KinematicsSim::restore(const KinematicsSimSnapshot& snapshot)
+  {
+    sim_->restore(*snapshot.snapshot_);
+  }
+
+  std::vector<std::string> KinematicsSim::popExpiredWatchdogs()
+  {
+    return sim_->popExpiredWatchdogs();
+  }
+
+  Simulator& KinematicsSim::simulator()
+  {
+    return *sim_;
+  }
+
+  const Simulator& KinematicsSim::simulator() const
+  {
+    return *sim_;
+  }
+}
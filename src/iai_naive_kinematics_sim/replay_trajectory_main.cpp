@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iai_naive_kinematics_sim/kinematics_sim.hpp>
+#include <iai_naive_kinematics_sim/trajectory_replay.hpp>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace iai_naive_kinematics_sim;
+
+// reads the fake controllers of a file:// URI or a plain path; other URIs need ROS
+static std::string loadFakeControllers(const std::string& uri)
+{
+  std::string prefix = "file://";
+  std::string path = uri;
+  if (uri.compare(0, prefix.size(), prefix) == 0)
+    path = uri.substr(prefix.size());
+  else if (uri.find("://") != std::string::npos)
+    throw std::runtime_error("Cannot read fake controllers from '" + uri + "' without ROS.");
+
+  std::ifstream file(path.c_str());
+  if (!file)
+    throw std::runtime_error("Could not read fake controllers '" + path + "'.");
+  std::stringstream text;
+  text << file.rdbuf();
+  return text.str();
+}
+
+// the parameters of SimulatorNode::init, up to the point where the node starts recording
+static KinematicsSimConfig readConfig(const YAML::Node& config)
+{
+  KinematicsSimConfig result;
+  result.simulated_joints = config["simulated_joints"].as< std::vector<std::string> >();
+  result.controlled_joints = config["controlled_joints"].as< std::vector<std::string> >();
+  result.watchdog_period = config["watchdog_period"].as<double>();
+  if (config["fake_controllers"])
+    result.fake_controllers = loadFakeControllers(config["fake_controllers"].as<std::string>());
+  if (config["watchdog_periods"])
+    result.watchdog_periods = config["watchdog_periods"].as< std::map<std::string, double> >();
+  for (std::map<std::string, double>::const_iterator it=result.watchdog_periods.begin();
+      it!=result.watchdog_periods.end(); ++it)
+    if (config["watchdog_groups"] && config["watchdog_groups"][it->first])
+      result.watchdog_groups[it->first] =
+        config["watchdog_groups"][it->first].as< std::vector<std::string> >();
+
+  return result;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc != 4)
+  {
+    std::cerr << "Usage: " << argv[0] << " ROBOT.urdf CONFIG.yaml LOG" << std::endl <<
+      "Replays a trajectory log recorded with ~record by a simulator with the given URDF " <<
+      "and parameters, and checks that every recorded state is reproduced bit for bit." <<
+      std::endl;
+    return 1;
+  }
+
+  try
+  {
+    KinematicsSim sim;
+    sim.initFile(argv[1], readConfig(YAML::LoadFile(argv[2])));
+
+    TrajectoryLogReader log;
+    log.open(argv[3]);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ReplayStatistics statistics = replayTrajectory(log, sim.simulator());
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Replayed " << statistics.records << " records with " << statistics.updates <<
+      " updates in " << seconds << "s." << std::endl;
+    if (statistics.mismatches > 0)
+    {
+      std::cout << statistics.mismatches << " of " << statistics.states <<
+        " recorded states differ, the first one at record " << statistics.first_mismatch <<
+        "." << std::endl;
+      return 2;
+    }
+    std::cout << "All " << statistics.states << " recorded states reproduced." << std::endl;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -38,7 +38,12 @@ int main(int argc, char *argv[])
   try
   {
     sim.init();
-    ros::spin();
+
+    // commands are thread-safe, everything else is serialized by the node
+    int spinner_threads = 1;
+    ros::NodeHandle("~").param("spinner_threads", spinner_threads, 1);
+    ros::MultiThreadedSpinner spinner(std::max(1, spinner_threads));
+    ros::spin(spinner);
   }
   catch (const std::exception& e)
   {
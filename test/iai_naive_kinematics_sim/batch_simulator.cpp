@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+
+using namespace iai_naive_kinematics_sim;
+
+class BatchSimulatorTest : public ::testing::Test
+{
+   protected:
+    virtual void SetUp()
+    {
+      now_ = ros::Time(2.0);
+      dt_ = ros::Duration(0.01);
+      model_.initFile("test_robot.urdf");
+      simulated_joints_.push_back("joint1");
+      simulated_joints_.push_back("joint2");
+      controlled_joints_.push_back("joint1");
+      fake_controllers_ = YAML::Load(
+          "- joint2: {position: {add: [{mul: [{f-pos-of: joint1}, {pos-lim-len-of: joint2}]}, "
+          "{pos-lim-low-of: joint2}]}, effort: {sin: [{vel-of: joint1}]}}\n");
+
+      ASSERT_NO_THROW(sim_.init(model_, simulated_joints_, controlled_joints_,
+          ros::Duration(0.05), fake_controllers_));
+      sensor_msgs::JointState start;
+      pushBackJointState(start, "joint1", 2.9, 0.0, 0.0);
+      ASSERT_NO_THROW(sim_.setSubJointState(start));
+    }
+
+    virtual void TearDown(){}
+
+    urdf::Model model_;
+    std::vector<std::string> simulated_joints_, controlled_joints_;
+    YAML::Node fake_controllers_;
+    Simulator sim_;
+    ros::Time now_;
+    ros::Duration dt_;
+
+    // a schedule that sends one velocity command every few steps, and then stops
+    std::vector<sensor_msgs::JointState> makeSchedule(double velocity, size_t every) const
+    {
+      std::vector<sensor_msgs::JointState> commands(20);
+      for (size_t i=0; i<commands.size(); i+=every)
+        pushBackJointState(commands[i], "joint1", 0.0, velocity * (1.0 + 0.1 * i), 0.0);
+      return commands;
+    }
+
+    void checkJointStatesEquality(const sensor_msgs::JointState& a, const sensor_msgs::JointState& b) const
+    {
+      EXPECT_EQ(a.header.seq, b.header.seq);
+      EXPECT_EQ(a.header.stamp, b.header.stamp);
+      ASSERT_EQ(a.name.size(), b.name.size());
+      for(size_t i=0; i<a.name.size(); ++i)
+      {
+        EXPECT_STREQ(a.name[i].c_str(), b.name[i].c_str());
+        EXPECT_DOUBLE_EQ(a.position[i], b.position[i]);
+        EXPECT_DOUBLE_EQ(a.velocity[i], b.velocity[i]);
+        EXPECT_DOUBLE_EQ(a.effort[i], b.effort[i]);
+      }
+    }
+};
+
+TEST_F(BatchSimulatorTest, Init)
+{
+  BatchSimulator batch;
+  EXPECT_THROW(batch.init(sim_, 0), std::runtime_error);
+  ASSERT_NO_THROW(batch.init(sim_, 5));
+
+  EXPECT_EQ(5, batch.worlds());
+  EXPECT_EQ(2, batch.size());
+  for (size_t w=0; w<batch.worlds(); ++w)
+    checkJointStatesEquality(batch.getJointState(w), sim_.getJointState());
+  EXPECT_THROW(batch.getJointState(5), std::range_error);
+}
+
+TEST_F(BatchSimulatorTest, RolloutMatchesSimulators)
+{
+  std::vector< std::vector<sensor_msgs::JointState> > schedules;
+  schedules.push_back(makeSchedule(1.0, 3));
+  schedules.push_back(makeSchedule(-2.0, 2));
+  schedules.push_back(makeSchedule(0.5, 7));
+  schedules.push_back(std::vector<sensor_msgs::JointState>());
+  schedules.push_back(makeSchedule(6.0, 1));
+
+  BatchSimulator batch;
+  ASSERT_NO_THROW(batch.init(sim_, schedules.size()));
+  std::vector< std::vector<sensor_msgs::JointState> > trajectories;
+  ASSERT_NO_THROW(batch.rollout(now_, dt_, 25, schedules, 4, trajectories));
+  ASSERT_EQ(schedules.size(), trajectories.size());
+
+  for (size_t w=0; w<schedules.size(); ++w)
+  {
+    Simulator sim = sim_;
+    std::vector<sensor_msgs::JointState> trajectory;
+    ASSERT_NO_THROW(sim.rollout(now_, dt_, 25, schedules[w], 4, trajectory));
+
+    ASSERT_EQ(trajectory.size(), trajectories[w].size());
+    for (size_t i=0; i<trajectory.size(); ++i)
+      checkJointStatesEquality(trajectory[i], trajectories[w][i]);
+  }
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+#include <thread>
+
+using namespace iai_naive_kinematics_sim;
+
+class CommandInboxTest : public ::testing::Test
+{
+   protected:
+    virtual void SetUp()
+    {
+      now_ = ros::Time(1.0);
+      model_.initFile("test_robot.urdf");
+      simulated_joints_.push_back("joint1");
+      simulated_joints_.push_back("joint2");
+      controlled_joints_.push_back("joint1");
+      controlled_joints_.push_back("joint2");
+      ASSERT_NO_THROW(sim_.init(model_, simulated_joints_, controlled_joints_,
+          ros::Duration(0.1)));
+
+      pushBackJointState(command_, "joint2", 0.0, 0.3, 0.0);
+      pushBackJointState(command_, "not_a_joint", 0.0, 7.0, 0.0);
+      pushBackJointState(command_, "joint1", 0.0, -0.2, 0.0);
+    }
+
+    virtual void TearDown(){}
+
+    urdf::Model model_;
+    std::vector<std::string> simulated_joints_, controlled_joints_;
+    Simulator sim_;
+    ros::Time now_;
+    sensor_msgs::JointState command_;
+};
+
+TEST_F(CommandInboxTest, Init)
+{
+  CommandInbox inbox;
+  EXPECT_THROW(inbox.push(command_, now_), std::runtime_error);
+  inbox.init(sim_);
+  EXPECT_NO_THROW(inbox.push(command_, now_));
+
+  command_.velocity.pop_back();
+  EXPECT_THROW(inbox.push(command_, now_), std::runtime_error);
+}
+
+TEST_F(CommandInboxTest, AppliesLikeSetSubCommand)
+{
+  Simulator reference = sim_;
+  CommandInbox inbox;
+  inbox.init(sim_);
+
+  ASSERT_TRUE(inbox.push(command_, now_));
+  command_.velocity[2] = 0.5;
+  ASSERT_TRUE(inbox.push(command_, now_));
+  EXPECT_EQ(0.0, sim_.getCommand().velocity[0]);
+
+  EXPECT_EQ(2, inbox.apply(sim_));
+  EXPECT_EQ(0, inbox.apply(sim_));
+  reference.setSubCommand(command_, now_);
+  EXPECT_EQ(reference.getCommand().velocity, sim_.getCommand().velocity);
+  EXPECT_EQ(0.5, sim_.getCommand().velocity[0]);
+  EXPECT_EQ(0.3, sim_.getCommand().velocity[1]);
+
+  // the commands pet the watchdogs, too
+  ros::Duration dt(0.05);
+  ASSERT_NO_THROW(sim_.update(now_ + dt, dt));
+  ASSERT_NO_THROW(reference.update(now_ + dt, dt));
+  EXPECT_EQ(reference.getJointState().position, sim_.getJointState().position);
+  EXPECT_NE(0.0, sim_.getJointState().position[0]);
+}
+
+TEST_F(CommandInboxTest, DropsWhenFull)
+{
+  CommandInbox inbox(2);
+  inbox.init(sim_);
+  EXPECT_TRUE(inbox.push(command_, now_));
+  EXPECT_TRUE(inbox.push(command_, now_));
+  EXPECT_FALSE(inbox.push(command_, now_));
+  EXPECT_EQ(2, inbox.apply(sim_));
+}
+
+TEST_F(CommandInboxTest, ManySenders)
+{
+  CommandInbox inbox(16);
+  inbox.init(sim_);
+
+  // every sender commands its own joint, with rising velocities
+  std::vector<std::thread> senders;
+  for (size_t j=0; j<2; ++j)
+    senders.push_back(std::thread([this, &inbox, j]()
+    {
+      for (size_t i=1; i<=5000; ++i)
+      {
+        sensor_msgs::JointState command;
+        pushBackJointState(command, simulated_joints_[j], 0.0, i, 0.0);
+        while (!inbox.push(command, now_)) {}
+      }
+    }));
+
+  std::vector<double> last(2, 0.0);
+  while (last[0] < 5000 || last[1] < 5000)
+  {
+    inbox.apply(sim_);
+    for (size_t j=0; j<2; ++j)
+    {
+      ASSERT_LE(last[j], sim_.getCommand().velocity[j]);
+      last[j] = sim_.getCommand().velocity[j];
+    }
+  }
+
+  for (size_t j=0; j<senders.size(); ++j)
+    senders[j].join();
+}
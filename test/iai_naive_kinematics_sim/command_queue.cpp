@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+#include <atomic>
+#include <thread>
+
+using namespace iai_naive_kinematics_sim;
+
+TEST(CommandQueueTest, Init)
+{
+  EXPECT_THROW(CommandQueue<int>(0), std::runtime_error);
+  EXPECT_EQ(1, CommandQueue<int>(1).capacity());
+  EXPECT_EQ(8, CommandQueue<int>(5).capacity());
+}
+
+TEST(CommandQueueTest, FirstInFirstOut)
+{
+  CommandQueue<int> queue(4);
+  int value;
+  EXPECT_FALSE(queue.pop(value));
+
+  for (int round=0; round<3; ++round)
+  {
+    for (int i=0; i<4; ++i)
+      EXPECT_TRUE(queue.push(10 * round + i));
+    EXPECT_FALSE(queue.push(-1));
+
+    for (int i=0; i<4; ++i)
+    {
+      ASSERT_TRUE(queue.pop(value));
+      EXPECT_EQ(10 * round + i, value);
+    }
+    EXPECT_FALSE(queue.pop(value));
+  }
+}
+
+TEST(CommandQueueTest, ManyProducers)
+{
+  CommandQueue<size_t> queue(64);
+  size_t producers = 4, values = 10000;
+  // lets the producers give up on a full queue once the consumer stopped
+  std::atomic<bool> consuming(true);
+
+  std::vector<std::thread> threads;
+  for (size_t p=0; p<producers; ++p)
+    threads.push_back(std::thread([&queue, &consuming, p, values]()
+    {
+      for (size_t i=0; i<values; ++i)
+        while (!queue.push(p * values + i))
+        {
+          if (!consuming)
+            return;
+          std::this_thread::yield();
+        }
+    }));
+
+  // every producer's values arrive complete and in order
+  std::vector<size_t> next(producers, 0);
+  size_t received = 0;
+  while (received < producers * values)
+  {
+    size_t value;
+    if (!queue.pop(value))
+    {
+      std::this_thread::yield();
+      continue;
+    }
+
+    size_t p = value / values;
+    if (p >= producers || next[p] != value % values)
+    {
+      ADD_FAILURE() << "Received " << value << " out of order.";
+      break;
+    }
+    next[p]++;
+    received++;
+  }
+
+  consuming = false;
+  for (size_t p=0; p<producers; ++p)
+    threads[p].join();
+
+  EXPECT_EQ(producers * values, received);
+}
@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+#include <memory>
+
+using namespace iai_naive_kinematics_sim;
+
+class ExpressionsTest : public ::testing::Test
+{
+   protected:
+    virtual void SetUp()
+    {
+      state_.resize(3);
+      limits_.resize(3);
+      state_.position[0] = 0.3;
+      state_.velocity[1] = -1.5;
+      state_.effort[2] = 2.5;
+      limits_.lower[2] = -1.0;
+      limits_.upper[2] = 1.0;
+
+      model_.initFile("test_robot.urdf");
+      simulated_joints_.push_back("joint1");
+      simulated_joints_.push_back("joint2");
+      controlled_joints_.push_back("joint1");
+      fake_controllers_ = YAML::LoadFile("test_fake_controllers.yaml");
+    }
+
+    virtual void TearDown(){}
+
+    JointArrays state_;
+    JointLimitArrays limits_;
+    urdf::Model model_;
+    std::vector<std::string> simulated_joints_, controlled_joints_;
+    YAML::Node fake_controllers_;
+
+    double mimicPosition(double joint1_position) const
+    {
+      return (joint1_position + 3.007) / 6.014 * 0.2 - 0.1;
+    }
+};
+
+TEST_F(ExpressionsTest, CompiledProgramMatchesTree)
+{
+  PositionExpr pos(state_, 0);
+  VelocityExpr vel(state_, 1);
+  EffortExpr eff(state_, 2);
+  ConstDoubleExpr two(2.0), three(3.0);
+  SinExpr sin_pos(&pos);
+  MulExpr mul(&sin_pos, &two);
+  AbsExpr abs_vel(&vel);
+  MaxExpr max_eff(&eff, &three);
+  DivExpr div(&abs_vel, &max_eff);
+  SubExpr sub(&mul, &div);
+  CosExpr cos_sub(&sub);
+  MinExpr min(&cos_sub, &eff);
+  AddExpr add(&min, &pos);
+
+  ExpressionCompiler compiler;
+  compiler.store(OP_STORE_POS, 1, add.compile(compiler));
+  ExpressionProgram program = compiler.program();
+  ProgramState program_state;
+  program.initState(program_state);
+
+  double expected = add.value();
+  program.run(state_, limits_, program_state);
+  EXPECT_DOUBLE_EQ(expected, state_.position[1]);
+
+  state_.position[0] = -0.7;
+  expected = add.value();
+  program.run(state_, limits_, program_state);
+  EXPECT_DOUBLE_EQ(expected, state_.position[1]);
+}
+
+TEST_F(ExpressionsTest, CompiledStoreClampsPositions)
+{
+  EffortExpr eff(state_, 2);
+
+  ExpressionCompiler compiler;
+  compiler.store(OP_STORE_POS, 2, eff.compile(compiler));
+  ExpressionProgram program = compiler.program();
+  ProgramState program_state;
+  program.initState(program_state);
+
+  state_.velocity[2] = 0.4;
+  program.run(state_, limits_, program_state);
+  EXPECT_DOUBLE_EQ(1.0, state_.position[2]);
+  EXPECT_DOUBLE_EQ(0.0, state_.velocity[2]);
+}
+
+TEST_F(ExpressionsTest, SharedSubexpressions)
+{
+  // two mimic joints reading the same fraction of a third one
+  boost::shared_ptr<urdf::JointLimits> limits(new urdf::JointLimits());
+  limits->lower = -2.0;
+  limits->upper = 2.0;
+  PositionFracExpr frac1(state_, 0, limits), frac2(state_, 0, limits);
+  PosLimitSpreadExpr spread1(limits), spread2(limits);
+  MulExpr mul1(&frac1, &spread1), mul2(&spread2, &frac2);
+
+  ExpressionCompiler compiler;
+  compiler.store(OP_STORE_POS, 1, mul1.compile(compiler));
+  compiler.store(OP_STORE_POS, 2, mul2.compile(compiler));
+  ExpressionProgram program = compiler.program();
+
+  // load, sub, div and mul are emitted once, followed by the two stores
+  ASSERT_EQ(6, program.code.size());
+  EXPECT_EQ(OP_STORE_POS, program.code[4].op);
+  EXPECT_EQ(OP_STORE_POS, program.code[5].op);
+  EXPECT_EQ(program.code[4].a, program.code[5].a);
+
+  JointLimitArrays unlimited;
+  unlimited.resize(state_.size());
+  ProgramState program_state;
+  program.initState(program_state);
+  program.run(state_, unlimited, program_state);
+  EXPECT_DOUBLE_EQ(mul1.value(), state_.position[1]);
+  EXPECT_DOUBLE_EQ(mul1.value(), state_.position[2]);
+}
+
+TEST_F(ExpressionsTest, LoadsAfterStoresAreNotShared)
+{
+  PositionExpr pos(state_, 0);
+  ConstDoubleExpr two(2.0);
+  MulExpr mul(&pos, &two);
+
+  ExpressionCompiler compiler;
+  compiler.store(OP_STORE_POS, 0, mul.compile(compiler));
+  compiler.store(OP_STORE_POS, 1, mul.compile(compiler));
+  ExpressionProgram program = compiler.program();
+  ProgramState program_state;
+  program.initState(program_state);
+  program.run(state_, limits_, program_state);
+
+  EXPECT_DOUBLE_EQ(0.6, state_.position[0]);
+  EXPECT_DOUBLE_EQ(1.2, state_.position[1]);
+}
+
+TEST_F(ExpressionsTest, ConstantFolding)
+{
+  boost::shared_ptr<urdf::JointLimits> limits(new urdf::JointLimits());
+  limits->lower = -0.5;
+  limits->upper = 1.5;
+  ConstDoubleExpr half(0.5);
+  PosLimitSpreadExpr spread(limits);
+  PosLowLimitExpr low(limits);
+  MulExpr mul(&half, &spread);
+  AddExpr add(&mul, &low);
+  CosExpr cos_add(&add);
+
+  ExpressionCompiler compiler;
+  compiler.store(OP_STORE_POS, 0, cos_add.compile(compiler));
+  ExpressionProgram program = compiler.program();
+
+  ASSERT_EQ(1, program.code.size());
+  EXPECT_DOUBLE_EQ(cos(0.5), program.initialRegisters[program.code[0].a]);
+}
+
+TEST_F(ExpressionsTest, SimulatorFakePositions)
+{
+  Simulator sim;
+  ASSERT_NO_THROW(sim.init(model_, simulated_joints_, controlled_joints_, ros::Duration(0.1),
+      fake_controllers_));
+
+  sensor_msgs::JointState command;
+  pushBackJointState(command, "joint1", 0.0, 1.0, 0.0);
+  ASSERT_NO_THROW(sim.setSubCommand(command, ros::Time(1.0)));
+  ASSERT_NO_THROW(sim.update(ros::Time(1.0), ros::Duration(0.5)));
+
+  EXPECT_DOUBLE_EQ(0.5, sim.getJointState().position[0]);
+  EXPECT_DOUBLE_EQ(mimicPosition(0.5), sim.getJointState().position[1]);
+}
+
+TEST_F(ExpressionsTest, ForksEvaluateTheirOwnState)
+{
+  std::unique_ptr<Simulator> sim(new Simulator());
+  ASSERT_NO_THROW(sim->init(model_, simulated_joints_, controlled_joints_, ros::Duration(0.1),
+      fake_controllers_));
+  Simulator fork = *sim;
+
+  // change the parent, and let it go before the fork evaluates its fake controllers
+  sensor_msgs::JointState state;
+  pushBackJointState(state, "joint1", 0.3, 0.0, 0.0);
+  sim->setSubJointState(state);
+  sim->update(ros::Time(1.0), ros::Duration(0.5));
+  EXPECT_DOUBLE_EQ(mimicPosition(0.3), sim->getJointState().position[1]);
+  sim.reset();
+
+  sensor_msgs::JointState fork_state;
+  pushBackJointState(fork_state, "joint1", 0.2, 0.0, 0.0);
+  fork.setSubJointState(fork_state);
+  fork.update(ros::Time(1.0), ros::Duration(0.5));
+  EXPECT_DOUBLE_EQ(0.2, fork.getJointState().position[0]);
+  EXPECT_DOUBLE_EQ(mimicPosition(0.2), fork.getJointState().position[1]);
+}
+
+TEST_F(ExpressionsTest, SkipsCleanSegments)
+{
+  PositionExpr pos(state_, 0);
+  ConstDoubleExpr two(2.0);
+  MulExpr mul(&pos, &two);
+
+  ExpressionCompiler compiler;
+  compiler.store(OP_STORE_POS, 1, mul.compile(compiler));
+  ExpressionProgram program = compiler.program();
+  ProgramState program_state;
+  program.initState(program_state);
+  program.run(state_, limits_, program_state);
+  EXPECT_DOUBLE_EQ(0.6, state_.position[1]);
+
+  // tamper with the constant: a clean segment is not re-run and keeps its output ...
+  size_t constant = std::find(program.initialRegisters.begin(), program.initialRegisters.end(),
+      2.0) - program.initialRegisters.begin();
+  ASSERT_LT(constant, program.initialRegisters.size());
+  program_state.registers[constant] = 3.0;
+  program.run(state_, limits_, program_state);
+  EXPECT_DOUBLE_EQ(0.6, state_.position[1]);
+
+  // ... while changing its input, or its output, makes it run again
+  state_.position[0] = 0.4;
+  program.run(state_, limits_, program_state);
+  EXPECT_DOUBLE_EQ(1.2, state_.position[1]);
+  program_state.registers[constant] = 2.0;
+  state_.position[1] = 0.0;
+  program.run(state_, limits_, program_state);
+  EXPECT_DOUBLE_EQ(0.8, state_.position[1]);
+}
+
+TEST_F(ExpressionsTest, DependencyOrder)
+{
+  // joint1 reads joint2, which comes later in the joint state but has to be computed first
+  YAML::Node fake_controllers = YAML::Load(
+      "- joint1: {position: {mul: [{pos-of: joint2}, 2.0]}}\n"
+      "- joint2: {position: 0.05}\n");
+
+  Simulator sim;
+  ASSERT_NO_THROW(sim.init(model_, simulated_joints_, controlled_joints_, ros::Duration(0.1),
+      fake_controllers));
+  ASSERT_NO_THROW(sim.update(ros::Time(1.0), ros::Duration(0.5)));
+
+  EXPECT_DOUBLE_EQ(0.1, sim.getJointState().position[0]);
+  EXPECT_DOUBLE_EQ(0.05, sim.getJointState().position[1]);
+}
+
+TEST_F(ExpressionsTest, RejectsCycles)
+{
+  YAML::Node fake_controllers = YAML::Load(
+      "- joint1: {position: {pos-of: joint2}}\n"
+      "- joint2: {position: {vel-of: joint1}}\n");
+
+  Simulator sim;
+  EXPECT_THROW(sim.init(model_, simulated_joints_, controlled_joints_, ros::Duration(0.1),
+      fake_controllers), std::runtime_error);
+}
+
+TEST_F(ExpressionsTest, FakeVelocitiesAndEfforts)
+{
+  YAML::Node fake_controllers = YAML::Load(
+      "- joint1: {effort: {mul: [{vel-of: joint1}, 2.0]}}\n"
+      "- joint2: {velocity: {mul: [{pos-of: joint1}, 0.1]}}\n");
+
+  Simulator sim;
+  ASSERT_NO_THROW(sim.init(model_, simulated_joints_, controlled_joints_, ros::Duration(1.0),
+      fake_controllers));
+
+  sensor_msgs::JointState command;
+  pushBackJointState(command, "joint1", 0.0, 1.0, 0.0);
+  ASSERT_NO_THROW(sim.setSubCommand(command, ros::Time(1.0)));
+
+  // fake velocities are integrated in the next update, like commands
+  ASSERT_NO_THROW(sim.update(ros::Time(1.0), ros::Duration(0.5)));
+  EXPECT_DOUBLE_EQ(0.5, sim.getJointState().position[0]);
+  EXPECT_DOUBLE_EQ(2.0, sim.getJointState().effort[0]);
+  EXPECT_DOUBLE_EQ(0.0, sim.getJointState().position[1]);
+  EXPECT_DOUBLE_EQ(0.05, sim.getJointState().velocity[1]);
+
+  ASSERT_NO_THROW(sim.update(ros::Time(1.5), ros::Duration(0.5)));
+  EXPECT_DOUBLE_EQ(1.0, sim.getJointState().position[0]);
+  EXPECT_DOUBLE_EQ(2.0, sim.getJointState().effort[0]);
+  EXPECT_DOUBLE_EQ(0.025, sim.getJointState().position[1]);
+  EXPECT_DOUBLE_EQ(0.1, sim.getJointState().velocity[1]);
+}
+
+TEST_F(ExpressionsTest, RejectsFakeVelocitiesOfControlledJoints)
+{
+  YAML::Node fake_controllers = YAML::Load("- joint1: {velocity: 0.1}\n");
+
+  Simulator sim;
+  EXPECT_THROW(sim.init(model_, simulated_joints_, controlled_joints_, ros::Duration(0.1),
+      fake_controllers), std::runtime_error);
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+#include <thread>
+
+using namespace iai_naive_kinematics_sim;
+
+TEST(ClockThrottleTest, Leads)
+{
+  ClockThrottle throttle(10, 0);
+  EXPECT_TRUE(throttle.mayAdvance(1000));
+
+  throttle.expect("controller", 0);
+  EXPECT_EQ(1, throttle.size());
+  EXPECT_FALSE(throttle.mayAdvance(10));
+
+  throttle.acknowledge("controller", 100, 0);
+  EXPECT_TRUE(throttle.mayAdvance(110));
+  EXPECT_FALSE(throttle.mayAdvance(111));
+
+  // the slowest subscriber holds the clock back; old acknowledgements do not
+  throttle.acknowledge("monitor", 50, 0);
+  throttle.acknowledge("controller", 90, 0);
+  EXPECT_TRUE(throttle.mayAdvance(60));
+  EXPECT_FALSE(throttle.mayAdvance(61));
+  throttle.acknowledge("monitor", 200, 0);
+  EXPECT_TRUE(throttle.mayAdvance(110));
+  EXPECT_EQ(2, throttle.size());
+
+  // without a timeout, nobody is dropped
+  EXPECT_TRUE(throttle.dropStale(1000, 1000000000).empty());
+}
+
+TEST(ClockThrottleTest, Timeouts)
+{
+  ClockThrottle throttle(10, 100);
+  throttle.expect("controller", 0);
+  throttle.acknowledge("monitor", 1000, 0);
+  EXPECT_TRUE(throttle.dropStale(20, 100).empty());
+
+  // only subscribers that hold the clock back time out
+  std::vector<std::string> dropped = throttle.dropStale(20, 101);
+  ASSERT_EQ(1, dropped.size());
+  EXPECT_EQ("controller", dropped[0]);
+  EXPECT_EQ(1, throttle.size());
+  EXPECT_TRUE(throttle.mayAdvance(20));
+
+  dropped = throttle.dropStale(2000, 200);
+  ASSERT_EQ(1, dropped.size());
+  EXPECT_EQ("monitor", dropped[0]);
+  EXPECT_EQ(0, throttle.size());
+}
+
+TEST(FreeRunningLoopTest, AsFastAsPossible)
+{
+  FreeRunningLoop loop;
+  std::vector<int64_t> stamps;
+  loop.start(1000, 10, 0.0, ClockThrottle(), [&stamps](int64_t stamp) { stamps.push_back(stamp); });
+  EXPECT_TRUE(loop.isRunning());
+  while (loop.ticks() < 1000)
+    std::this_thread::yield();
+  loop.stop();
+  EXPECT_FALSE(loop.isRunning());
+
+  ASSERT_LE(1000, stamps.size());
+  for (size_t i=0; i<stamps.size(); ++i)
+    ASSERT_EQ(1010 + 10 * static_cast<int64_t>(i), stamps[i]);
+  EXPECT_EQ(stamps.back(), loop.now());
+  EXPECT_THROW(loop.start(0, 0, 0.0, ClockThrottle(), [](int64_t) {}), std::runtime_error);
+}
+
+TEST(FreeRunningLoopTest, RealTimeFactor)
+{
+  // 10ms of simulated time per 1ms of wall time
+  FreeRunningLoop loop;
+  loop.start(0, 10000000, 10.0, ClockThrottle(), [](int64_t) {});
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  loop.stop();
+
+  EXPECT_LE(50, loop.ticks());
+  EXPECT_GE(101, loop.ticks());
+}
+
+TEST(FreeRunningLoopTest, WaitsForSubscribers)
+{
+  ClockThrottle throttle(10, 0);
+  throttle.expect("controller", 0);
+  FreeRunningLoop loop;
+  std::atomic<int64_t> acknowledged(-1), max_lead(0);
+  loop.start(0, 10, 0.0, throttle, [&acknowledged, &max_lead](int64_t stamp)
+  {
+    max_lead = std::max<int64_t>(max_lead, stamp - acknowledged);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(0, loop.ticks());
+
+  // a subscriber that acknowledges every tick lets the clock advance in lockstep
+  for (int64_t stamp=0; stamp<500; stamp=loop.now())
+  {
+    acknowledged = stamp;
+    loop.acknowledge("controller", stamp);
+    while (loop.now() == stamp)
+      std::this_thread::yield();
+  }
+  loop.stop();
+  EXPECT_EQ(10, max_lead);
+  EXPECT_TRUE(loop.popDropped().empty());
+}
+
+TEST(FreeRunningLoopTest, DropsSilentSubscribers)
+{
+  ClockThrottle throttle(10, 20000000);
+  throttle.expect("controller", 0);
+  FreeRunningLoop loop;
+  loop.start(0, 10, 0.0, throttle, [](int64_t) {});
+  while (loop.ticks() == 0)
+    std::this_thread::yield();
+  loop.stop();
+
+  std::vector<std::string> dropped = loop.popDropped();
+  ASSERT_EQ(1, dropped.size());
+  EXPECT_EQ("controller", dropped[0]);
+  EXPECT_TRUE(loop.popDropped().empty());
+}
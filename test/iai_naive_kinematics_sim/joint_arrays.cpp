@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+#include <cmath>
+#include <limits>
+
+using namespace iai_naive_kinematics_sim;
+
+class JointArraysTest : public ::testing::Test
+{
+   protected:
+    virtual void SetUp()
+    {
+      // odd number of joints to exercise both the vectorized part and the scalar remainder
+      size_ = 11;
+      state_.resize(size_);
+      limits_.resize(size_);
+      for (size_t i=0; i<size_; ++i)
+      {
+        state_.position[i] = 0.1 * i;
+        state_.velocity[i] = (i % 2 == 0) ? 1.0 : -1.0;
+        if (i % 3 != 0)
+        {
+          limits_.lower[i] = -0.2;
+          limits_.upper[i] = 0.9;
+        }
+      }
+    }
+
+    virtual void TearDown(){}
+
+    size_t size_;
+    JointArrays state_;
+    JointLimitArrays limits_;
+};
+
+TEST_F(JointArraysTest, Alignment)
+{
+  EXPECT_EQ(0, reinterpret_cast<size_t>(state_.position.data()) % 32);
+  EXPECT_EQ(0, reinterpret_cast<size_t>(state_.velocity.data()) % 32);
+  EXPECT_EQ(0, reinterpret_cast<size_t>(limits_.lower.data()) % 32);
+}
+
+TEST_F(JointArraysTest, IntegrateAndClamp)
+{
+  JointArrays expected = state_;
+  for (size_t i=0; i<size_; ++i)
+  {
+    expected.position[i] += expected.velocity[i] * 0.5;
+    clampJoint(expected.position[i], expected.velocity[i], limits_.lower[i], limits_.upper[i]);
+  }
+
+  integrateAndClamp(state_, limits_, 0.5);
+
+  for (size_t i=0; i<size_; ++i)
+  {
+    EXPECT_DOUBLE_EQ(expected.position[i], state_.position[i]);
+    EXPECT_DOUBLE_EQ(expected.velocity[i], state_.velocity[i]);
+  }
+
+  // unlimited joints keep moving, limited ones are stopped at their limits
+  EXPECT_DOUBLE_EQ(0.5, state_.position[0]);
+  EXPECT_DOUBLE_EQ(1.0, state_.velocity[0]);
+  EXPECT_DOUBLE_EQ(0.9, state_.position[8]);
+  EXPECT_DOUBLE_EQ(0.0, state_.velocity[8]);
+  EXPECT_DOUBLE_EQ(-0.2, state_.position[1]);
+  EXPECT_DOUBLE_EQ(0.0, state_.velocity[1]);
+  EXPECT_DOUBLE_EQ(0.0, state_.position[5]);
+  EXPECT_DOUBLE_EQ(-1.0, state_.velocity[5]);
+}
+
+TEST_F(JointArraysTest, NaNPositions)
+{
+  // every joint, limited or not, and whether it lands in a vector lane or in the scalar
+  // remainder, keeps its NaN position and its velocity
+  for (size_t i=0; i<size_; ++i)
+    state_.position[i] = std::numeric_limits<double>::quiet_NaN();
+  JointArrays velocities = state_;
+  integrateAndClamp(state_, limits_, 0.5);
+
+  for (size_t i=0; i<size_; ++i)
+  {
+    EXPECT_TRUE(std::isnan(state_.position[i])) << "joint " << i;
+    EXPECT_EQ(velocities.velocity[i], state_.velocity[i]) << "joint " << i;
+  }
+  // joint 0 is unlimited, joint 1 limited
+  EXPECT_TRUE(std::isinf(limits_.upper[0]));
+  EXPECT_FALSE(std::isinf(limits_.upper[1]));
+
+  // the same for NaN velocities
+  for (size_t i=0; i<size_; ++i)
+  {
+    state_.position[i] = 0.1 * i;
+    state_.velocity[i] = std::numeric_limits<double>::quiet_NaN();
+  }
+  integrateAndClamp(state_, limits_, 0.5);
+  for (size_t i=0; i<size_; ++i)
+  {
+    EXPECT_TRUE(std::isnan(state_.position[i])) << "joint " << i;
+    EXPECT_TRUE(std::isnan(state_.velocity[i])) << "joint " << i;
+  }
+}
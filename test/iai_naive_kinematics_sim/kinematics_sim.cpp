@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+// nothing but the library interface, to check that it builds without ROS types
+#include <iai_naive_kinematics_sim/kinematics_sim.hpp>
+#include <stdexcept>
+
+using namespace iai_naive_kinematics_sim;
+
+class KinematicsSimTest : public ::testing::Test
+{
+   protected:
+    virtual void SetUp()
+    {
+      config_.simulated_joints.push_back("joint1");
+      config_.simulated_joints.push_back("joint2");
+      config_.controlled_joints.push_back("joint1");
+      config_.watchdog_period = 0.1;
+      config_.fake_controllers = "- joint2: {position: {mul: [{pos-of: joint1}, 0.01]}}\n";
+      ASSERT_NO_THROW(sim_.initFile("test_robot.urdf", config_));
+      joint1_ = sim_.resolveLayout(std::vector<std::string>(1, "joint1"));
+    }
+
+    virtual void TearDown(){}
+
+    KinematicsSimConfig config_;
+    KinematicsSim sim_;
+    JointLayout joint1_;
+
+    static const int64_t MS = 1000000;
+};
+
+TEST_F(KinematicsSimTest, Init)
+{
+  ASSERT_EQ(2, sim_.size());
+  EXPECT_EQ("joint1", sim_.getJointNames()[0]);
+  EXPECT_EQ("joint2", sim_.getJointNames()[1]);
+  EXPECT_EQ(0.0, sim_.getPositions()[0]);
+
+  KinematicsSim sim;
+  EXPECT_THROW(sim.initFile("no_such_robot.urdf", config_), std::runtime_error);
+  EXPECT_THROW(sim.init("<robot", config_), std::runtime_error);
+  KinematicsSimConfig config = config_;
+  config.watchdog_period = 0.0;
+  EXPECT_THROW(sim.initFile("test_robot.urdf", config), std::runtime_error);
+  config = config_;
+  config.watchdog_periods["joint2"] = 0.2;
+  EXPECT_THROW(sim.initFile("test_robot.urdf", config), std::runtime_error);
+}
+
+TEST_F(KinematicsSimTest, StartConfig)
+{
+  config_.start_config["joint1"] = 0.5;
+  ASSERT_NO_THROW(sim_.initFile("test_robot.urdf", config_));
+  EXPECT_EQ(0.5, sim_.getPositions()[0]);
+  EXPECT_EQ(0.0, sim_.getVelocities()[0]);
+}
+
+TEST_F(KinematicsSimTest, CommandsAndWatchdogs)
+{
+  double velocity = 1.0;
+  sim_.setCommand(joint1_, &velocity, 1000 * MS);
+  sim_.update(1100 * MS, 100 * MS);
+  EXPECT_DOUBLE_EQ(0.1, sim_.getPositions()[0]);
+  EXPECT_DOUBLE_EQ(1.0, sim_.getVelocities()[0]);
+  EXPECT_DOUBLE_EQ(0.001, sim_.getPositions()[1]);
+  EXPECT_EQ(1100 * MS, sim_.getStamp());
+  EXPECT_EQ(1, sim_.getSequence());
+
+  // substeps only change how the period is split
+  sim_.setCommand(joint1_, &velocity, 1100 * MS);
+  sim_.update(1200 * MS, 100 * MS, 4);
+  EXPECT_DOUBLE_EQ(0.2, sim_.getPositions()[0]);
+  EXPECT_EQ(5, sim_.getSequence());
+  EXPECT_TRUE(sim_.popExpiredWatchdogs().empty());
+
+  // the watchdog stops the joint after its period
+  sim_.update(1300 * MS, 100 * MS);
+  EXPECT_DOUBLE_EQ(0.0, sim_.getVelocities()[0]);
+  EXPECT_EQ(std::vector<std::string>(1, "joint1"), sim_.popExpiredWatchdogs());
+}
+
+TEST_F(KinematicsSimTest, SteadyClock)
+{
+  KinematicsSim::Clock::time_point now = KinematicsSim::Clock::now();
+  double velocity = -1.0;
+  sim_.setCommand(joint1_, &velocity, now);
+  sim_.update(now + std::chrono::milliseconds(50), std::chrono::milliseconds(50));
+  EXPECT_DOUBLE_EQ(-0.05, sim_.getPositions()[0]);
+  EXPECT_EQ(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        (now + std::chrono::milliseconds(50)).time_since_epoch()).count(), sim_.getStamp());
+}
+
+TEST_F(KinematicsSimTest, States)
+{
+  std::vector<std::string> names;
+  names.push_back("joint2");
+  names.push_back("not_a_joint");
+  JointLayout layout = sim_.resolveLayout(names);
+  double positions[] = {0.05, 1.0}, velocities[] = {0.0, 0.0};
+  EXPECT_THROW(sim_.setState(layout, positions, velocities, 0), std::runtime_error);
+
+  names.pop_back();
+  layout = sim_.resolveLayout(names);
+  sim_.setState(layout, positions, velocities, 0);
+  EXPECT_EQ(0.05, sim_.getPositions()[1]);
+  EXPECT_THROW(sim_.update(-1, 100 * MS), std::runtime_error);
+}
+
+TEST_F(KinematicsSimTest, ForksAndSnapshots)
+{
+  double velocity = 1.0;
+  sim_.setCommand(joint1_, &velocity, 1000 * MS);
+  KinematicsSimSnapshot snapshot;
+  sim_.snapshot(snapshot);
+  KinematicsSim fork = sim_;
+
+  sim_.update(1050 * MS, 50 * MS);
+  EXPECT_EQ(0.0, fork.getPositions()[0]);
+  fork.update(1050 * MS, 50 * MS);
+  EXPECT_EQ(sim_.getPositions()[0], fork.getPositions()[0]);
+
+  sim_.update(1100 * MS, 50 * MS);
+  sim_.restore(snapshot);
+  EXPECT_EQ(0.0, sim_.getPositions()[0]);
+  sim_.update(1050 * MS, 50 * MS);
+  EXPECT_EQ(fork.getPositions()[0], sim_.getPositions()[0]);
+  EXPECT_EQ(fork.getPositions()[1], sim_.getPositions()[1]);
+}
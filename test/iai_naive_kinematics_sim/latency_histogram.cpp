@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+#include <thread>
+
+using namespace iai_naive_kinematics_sim;
+
+TEST(LatencyHistogramTest, Buckets)
+{
+  size_t buckets = LatencyHistogram::BUCKETS;
+  EXPECT_EQ(0, LatencyHistogram::bucketIndex(0));
+  EXPECT_EQ(63, LatencyHistogram::bucketIndex(63));
+  EXPECT_EQ(buckets - 1, LatencyHistogram::bucketIndex(uint64_t(1) << 41));
+  EXPECT_EQ(buckets - 1, LatencyHistogram::bucketIndex(~uint64_t(0)));
+
+  // buckets follow each other without gaps, and get no wider than about 3% of their values
+  for (size_t i=1; i<buckets; ++i)
+  {
+    ASSERT_EQ(LatencyHistogram::bucketUpperBound(i-1) + 1, LatencyHistogram::bucketLowerBound(i));
+    EXPECT_EQ(i, LatencyHistogram::bucketIndex(LatencyHistogram::bucketLowerBound(i)));
+    EXPECT_EQ(i, LatencyHistogram::bucketIndex(LatencyHistogram::bucketUpperBound(i)));
+    EXPECT_LE(LatencyHistogram::bucketUpperBound(i) - LatencyHistogram::bucketLowerBound(i),
+        LatencyHistogram::bucketLowerBound(i) / 32);
+  }
+}
+
+TEST(LatencyHistogramTest, Statistics)
+{
+  LatencyHistogram histogram;
+  LatencySnapshot empty = histogram.snapshot();
+  EXPECT_EQ(0, empty.count);
+  EXPECT_EQ(0, empty.max());
+  EXPECT_EQ(0, empty.percentile(0.5));
+
+  for (uint64_t i=1; i<=1000; ++i)
+    histogram.record(1000 * i);
+
+  LatencySnapshot snapshot = histogram.snapshot();
+  EXPECT_EQ(1000, snapshot.count);
+  EXPECT_DOUBLE_EQ(500500.0, snapshot.mean());
+  EXPECT_NEAR(1000, snapshot.min(), 1000 / 32);
+  EXPECT_NEAR(500000, snapshot.percentile(0.5), 500000 / 32);
+  EXPECT_NEAR(990000, snapshot.percentile(0.99), 990000 / 32);
+  EXPECT_NEAR(1000000, snapshot.max(), 1000000 / 32);
+  EXPECT_GE(snapshot.max(), 1000000);
+  EXPECT_EQ(snapshot.max(), snapshot.percentile(1.0));
+
+  histogram.record(5);
+  LatencySnapshot since = histogram.snapshot() - snapshot;
+  EXPECT_EQ(1, since.count);
+  EXPECT_EQ(5, since.min());
+  EXPECT_EQ(5, since.max());
+
+  histogram.reset();
+  EXPECT_EQ(0, histogram.snapshot().count);
+}
+
+TEST(LatencyHistogramTest, ConcurrentRecords)
+{
+  LatencyHistogram histogram;
+  size_t writers = 4, values = 100000;
+
+  std::vector<std::thread> threads;
+  for (size_t w=0; w<writers; ++w)
+    threads.push_back(std::thread([&histogram, values]()
+    {
+      for (size_t i=0; i<values; ++i)
+        histogram.record(i % 2000);
+    }));
+  for (size_t w=0; w<writers; ++w)
+    threads[w].join();
+
+  LatencySnapshot snapshot = histogram.snapshot();
+  EXPECT_EQ(writers * values, snapshot.count);
+  EXPECT_EQ(writers * (values / 2000) * (1999 * 2000 / 2), snapshot.sum);
+}
+
+TEST(LatencyHistogramTest, ScopedTimer)
+{
+  Instrumentation instrumentation;
+  {
+    ScopedTimer timer(&instrumentation, STAGE_UPDATE);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  {
+    ScopedTimer timer(&instrumentation, STAGE_PUBLISH);
+    timer.discard();
+  }
+  {
+    ScopedTimer timer(0, STAGE_PUBLISH);
+    EXPECT_EQ(0, timer.elapsed());
+  }
+  instrumentation.recordOverrun();
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_NO_INSTRUMENTATION
+  LatencySnapshot update = instrumentation.histogram(STAGE_UPDATE).snapshot();
+  ASSERT_EQ(1, update.count);
+  EXPECT_LE(2000000, update.max());
+  EXPECT_EQ(0, instrumentation.histogram(STAGE_PUBLISH).snapshot().count);
+  EXPECT_EQ(1, instrumentation.overruns());
+#endif
+
+  instrumentation.reset();
+  EXPECT_EQ(0, instrumentation.histogram(STAGE_UPDATE).snapshot().count);
+  EXPECT_EQ(0, instrumentation.overruns());
+  EXPECT_STREQ("fake_controllers", Instrumentation::stageName(STAGE_FAKE_CONTROLLERS));
+}
+
+TEST(LatencyHistogramTest, SimulatorUpdates)
+{
+  urdf::Model model;
+  ASSERT_TRUE(model.initFile("test_robot.urdf"));
+  std::vector<std::string> joints;
+  joints.push_back("joint1");
+  joints.push_back("joint2");
+
+  Instrumentation instrumentation;
+  Simulator sim;
+  sim.init(model, joints, joints, ros::Duration(0.1));
+  sim.setInstrumentation(&instrumentation);
+  sim.updateN(ros::Time(1.0), ros::Duration(0.01), 10);
+
+  // copies record into the same instrumentation
+  Simulator copy = sim;
+  copy.update(ros::Time(2.0), ros::Duration(0.01));
+  sim.setInstrumentation(0);
+  sim.update(ros::Time(3.0), ros::Duration(0.01));
+
+#ifndef IAI_NAIVE_KINEMATICS_SIM_NO_INSTRUMENTATION
+  EXPECT_EQ(11, instrumentation.histogram(STAGE_UPDATE).snapshot().count);
+  EXPECT_EQ(11, instrumentation.histogram(STAGE_FAKE_CONTROLLERS).snapshot().count);
+#endif
+}
+
+TEST(LatencyHistogramTest, LatencyStatus)
+{
+  LatencyHistogram histogram;
+  histogram.record(1000);
+  histogram.record(3000);
+
+  diagnostic_msgs::DiagnosticStatus status = makeLatencyStatus("update", histogram.snapshot());
+  EXPECT_EQ("update", status.name);
+  EXPECT_EQ(diagnostic_msgs::DiagnosticStatus::OK, status.level);
+  ASSERT_EQ(8, status.values.size());
+  EXPECT_EQ("count", status.values[0].key);
+  EXPECT_EQ("2", status.values[0].value);
+  EXPECT_EQ("mean_us", status.values[1].key);
+  EXPECT_EQ("2", status.values[1].value);
+
+  // counts keep all their digits
+  EXPECT_EQ("1234567", makeKeyValue("overruns", static_cast<uint64_t>(1234567)).value);
+
+  std::string expected = std::to_string(LatencyHistogram::bucketUpperBound(
+        LatencyHistogram::bucketIndex(1000))) + " 1\n" + std::to_string(
+      LatencyHistogram::bucketUpperBound(LatencyHistogram::bucketIndex(3000))) + " 1\n";
+  EXPECT_EQ(expected, formatLatencyHistogram(histogram.snapshot()));
+}
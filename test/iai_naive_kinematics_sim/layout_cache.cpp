@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+
+using namespace iai_naive_kinematics_sim;
+
+class LayoutCacheTest : public ::testing::Test
+{
+   protected:
+    virtual void SetUp()
+    {
+      index_map_["joint1"] = 0;
+      index_map_["joint2"] = 1;
+      index_map_["joint3"] = 2;
+      watchdog_index_map_["joint3"] = 0;
+      watchdog_index_map_["joint1"] = 1;
+
+      names_.push_back("joint3");
+      names_.push_back("joint2");
+    }
+
+    virtual void TearDown(){}
+
+    std::map<std::string, size_t> index_map_, watchdog_index_map_;
+    std::vector<std::string> names_;
+};
+
+TEST_F(LayoutCacheTest, Resolve)
+{
+  names_.push_back("joint4");
+  JointLayout layout = resolveJointLayout(names_, index_map_, watchdog_index_map_);
+  EXPECT_EQ(names_, layout.names);
+  ASSERT_EQ(3, layout.joints.size());
+  ASSERT_EQ(3, layout.slots.size());
+  EXPECT_EQ(2, layout.joints[0]);
+  EXPECT_EQ(0, layout.slots[0]);
+  EXPECT_EQ(1, layout.joints[1]);
+  EXPECT_TRUE(layout.slots[1] == JointLayout::NONE);
+  EXPECT_TRUE(layout.joints[2] == JointLayout::NONE);
+  EXPECT_THROW(checkJointsKnown(layout), std::runtime_error);
+
+  names_.pop_back();
+  EXPECT_NO_THROW(checkJointsKnown(resolveJointLayout(names_, index_map_,
+      watchdog_index_map_)));
+}
+
+TEST_F(LayoutCacheTest, Fingerprint)
+{
+  std::vector<std::string> other;
+  other.push_back("joint3joint2");
+  EXPECT_EQ(nameFingerprint(names_), nameFingerprint(names_));
+  EXPECT_NE(nameFingerprint(names_), nameFingerprint(other));
+  std::swap(names_[0], names_[1]);
+  EXPECT_NE(nameFingerprint(names_), nameFingerprint(other));
+}
+
+TEST_F(LayoutCacheTest, FindAndEvict)
+{
+  EXPECT_THROW(LayoutCache(0), std::runtime_error);
+
+  LayoutCache cache(2);
+  EXPECT_FALSE(cache.find(names_));
+  LayoutCache::LayoutPtr layout =
+    cache.insert(resolveJointLayout(names_, index_map_, watchdog_index_map_));
+  EXPECT_EQ(layout, cache.find(names_));
+
+  std::vector<std::string> a(1, "joint1"), b(1, "joint2");
+  cache.insert(resolveJointLayout(a, index_map_, watchdog_index_map_));
+  EXPECT_EQ(2, cache.size());
+  EXPECT_EQ(layout, cache.find(names_));
+
+  // the oldest layout goes first, but stays valid for whoever still holds it
+  cache.insert(resolveJointLayout(b, index_map_, watchdog_index_map_));
+  EXPECT_EQ(2, cache.size());
+  EXPECT_FALSE(cache.find(names_));
+  EXPECT_TRUE(cache.find(a));
+  EXPECT_TRUE(cache.find(b));
+  EXPECT_EQ(names_, layout->names);
+
+  cache.clear();
+  EXPECT_EQ(0, cache.size());
+  EXPECT_FALSE(cache.find(a));
+}
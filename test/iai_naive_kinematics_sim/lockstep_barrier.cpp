@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+#include <thread>
+
+using namespace iai_naive_kinematics_sim;
+
+static std::vector<std::string> sources()
+{
+  std::vector<std::string> result;
+  result.push_back("arm");
+  result.push_back("base");
+  result.push_back("gripper");
+  return result;
+}
+
+TEST(LockstepBarrierTest, Init)
+{
+  LockstepBarrier barrier;
+  EXPECT_THROW(barrier.init(std::vector<std::string>(), 0), std::runtime_error);
+  EXPECT_THROW(barrier.init(sources(), -1), std::runtime_error);
+
+  std::vector<std::string> twice = sources();
+  twice.push_back("arm");
+  EXPECT_THROW(barrier.init(twice, 0), std::runtime_error);
+
+  barrier.init(sources(), 100);
+  EXPECT_FALSE(barrier.isOpen());
+  EXPECT_EQ(100, barrier.timeout());
+}
+
+TEST(LockstepBarrierTest, ReleasesOnce)
+{
+  LockstepBarrier barrier;
+  barrier.init(sources(), 0);
+
+  // nothing counts before the barrier opens
+  EXPECT_FALSE(barrier.arrive("arm", 1000));
+
+  barrier.open(1000, 0);
+  EXPECT_TRUE(barrier.isOpen());
+  EXPECT_EQ(1000, barrier.stamp());
+  EXPECT_FALSE(barrier.arrive("arm", 1000));
+  // repeated commands, unknown sources, and answers to older states do not count
+  EXPECT_FALSE(barrier.arrive("arm", 1000));
+  EXPECT_FALSE(barrier.arrive("teleop", 1000));
+  EXPECT_FALSE(barrier.arrive("base", 999));
+  EXPECT_FALSE(barrier.arrive("base", 1001));
+  EXPECT_TRUE(barrier.arrive("gripper", 1000));
+  EXPECT_FALSE(barrier.isOpen());
+  EXPECT_FALSE(barrier.arrive("gripper", 1000));
+
+  // every tick starts from scratch
+  barrier.open(2000, 0);
+  EXPECT_FALSE(barrier.arrive("arm", 1000));
+  EXPECT_FALSE(barrier.arrive("arm", 2000));
+  EXPECT_FALSE(barrier.arrive("base", 2000));
+  EXPECT_TRUE(barrier.arrive("gripper", 2000));
+}
+
+TEST(LockstepBarrierTest, Timeout)
+{
+  LockstepBarrier barrier;
+  barrier.init(sources(), 100);
+  std::vector<std::string> missing;
+  EXPECT_FALSE(barrier.expire(1000, missing));
+
+  barrier.open(1000, 50);
+  EXPECT_FALSE(barrier.arrive("base", 1000));
+  EXPECT_FALSE(barrier.expire(149, missing));
+  EXPECT_TRUE(barrier.isOpen());
+  EXPECT_TRUE(barrier.expire(150, missing));
+  ASSERT_EQ(2, missing.size());
+  EXPECT_EQ("arm", missing[0]);
+  EXPECT_EQ("gripper", missing[1]);
+
+  // released by the timeout, so late commands do not release it again
+  EXPECT_FALSE(barrier.isOpen());
+  EXPECT_FALSE(barrier.arrive("arm", 1000));
+  EXPECT_FALSE(barrier.arrive("gripper", 1000));
+  EXPECT_FALSE(barrier.expire(1000, missing));
+
+  // released by commands, so the timeout does not release it again
+  barrier.open(2000, 200);
+  barrier.arrive("arm", 2000);
+  barrier.arrive("base", 2000);
+  EXPECT_TRUE(barrier.arrive("gripper", 2000));
+  EXPECT_FALSE(barrier.expire(1000, missing));
+}
+
+TEST(LockstepBarrierTest, Remaining)
+{
+  LockstepBarrier barrier;
+  barrier.init(sources(), 100);
+  EXPECT_EQ(0, barrier.remaining(0));
+
+  barrier.open(1000, 50);
+  EXPECT_EQ(100, barrier.remaining(50));
+  std::vector<std::string> missing;
+  EXPECT_FALSE(barrier.expire(120, missing));
+  EXPECT_EQ(30, barrier.remaining(120));
+  EXPECT_EQ(0, barrier.remaining(150));
+
+  // opening again restarts the timeout
+  barrier.open(2000, 140);
+  EXPECT_EQ(100, barrier.remaining(140));
+  EXPECT_TRUE(barrier.expire(240, missing));
+  EXPECT_EQ(0, barrier.remaining(200));
+
+  barrier.init(sources(), 0);
+  barrier.open(3000, 0);
+  EXPECT_EQ(0, barrier.remaining(0));
+}
+
+TEST(LockstepBarrierTest, WaitsForever)
+{
+  LockstepBarrier barrier;
+  barrier.init(sources(), 0);
+  barrier.open(1000, 0);
+  std::vector<std::string> missing;
+  EXPECT_FALSE(barrier.expire(1000000000000, missing));
+  EXPECT_TRUE(barrier.isOpen());
+}
+
+TEST(LockstepBarrierTest, ConcurrentSources)
+{
+  std::vector<std::string> names;
+  for (size_t i=0; i<8; ++i)
+    names.push_back("controller" + std::to_string(i));
+  LockstepBarrier barrier;
+  barrier.init(names, 0);
+
+  // exactly one command releases the barrier, however the sources race
+  for (int64_t stamp=1; stamp<=100; ++stamp)
+  {
+    barrier.open(stamp, 0);
+    std::vector<int> released(names.size(), 0);
+    std::vector<std::thread> threads;
+    for (size_t i=0; i<names.size(); ++i)
+      threads.push_back(std::thread([&barrier, &names, &released, i, stamp]() {
+            released[i] = barrier.arrive(names[i], stamp); }));
+    for (size_t i=0; i<threads.size(); ++i)
+      threads[i].join();
+
+    int count = 0;
+    for (size_t i=0; i<released.size(); ++i)
+      count += released[i];
+    EXPECT_EQ(1, count);
+  }
+}
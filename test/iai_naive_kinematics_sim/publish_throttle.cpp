@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+
+using namespace iai_naive_kinematics_sim;
+
+TEST(PublishThrottleTest, Init)
+{
+  EXPECT_THROW(PublishThrottle(0.0), std::runtime_error);
+  EXPECT_THROW(PublishThrottle(-1.0), std::runtime_error);
+  EXPECT_NO_THROW(PublishThrottle(30.0));
+}
+
+TEST(PublishThrottleTest, DefaultLetsEverythingThrough)
+{
+  PublishThrottle throttle;
+  for (size_t i=0; i<10; ++i)
+    EXPECT_TRUE(throttle.due(ros::Time(1.0 + 0.001 * i)));
+}
+
+TEST(PublishThrottleTest, KeepsRate)
+{
+  // 1 kHz stamps throttled to 50 Hz
+  PublishThrottle throttle(50.0);
+  size_t published = 0;
+  for (size_t i=0; i<1000; ++i)
+    if (throttle.due(ros::Time(1.0 + 0.001 * i)))
+      published++;
+  EXPECT_EQ(50, published);
+}
+
+TEST(PublishThrottleTest, ToleratesJitter)
+{
+  // stamps at the publish rate that are up to a few ms early or late
+  PublishThrottle throttle(50.0);
+  for (size_t i=0; i<100; ++i)
+    EXPECT_TRUE(throttle.due(ros::Time(1.0 + 0.02 * i + (i % 2 ? 0.004 : -0.004))));
+}
+
+TEST(PublishThrottleTest, TimeJumps)
+{
+  PublishThrottle throttle(10.0);
+  EXPECT_TRUE(throttle.due(ros::Time(5.0)));
+  EXPECT_FALSE(throttle.due(ros::Time(5.01)));
+  EXPECT_TRUE(throttle.due(ros::Time(2.0)));
+  EXPECT_FALSE(throttle.due(ros::Time(2.01)));
+  EXPECT_TRUE(throttle.due(ros::Time(9.0)));
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+#include <chrono>
+#include <thread>
+
+using namespace iai_naive_kinematics_sim;
+
+TEST(RealtimeLoopTest, Start)
+{
+  RealtimeLoop loop;
+  EXPECT_FALSE(loop.isRunning());
+  EXPECT_THROW(loop.start(0, [](size_t) {}), std::runtime_error);
+  EXPECT_FALSE(loop.isRunning());
+  EXPECT_EQ(0, loop.statistics().ticks);
+  EXPECT_EQ(0, loop.error());
+}
+
+TEST(RealtimeLoopTest, Ticks)
+{
+  RealtimeLoop loop;
+  std::atomic<size_t> periods(0);
+  ASSERT_NO_THROW(loop.start(1000000, [&periods](size_t p) { periods += p; }));
+  EXPECT_TRUE(loop.isRunning());
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  loop.stop();
+  EXPECT_FALSE(loop.isRunning());
+  EXPECT_EQ(0, loop.error());
+
+  // the loop keeps time, even if some ticks were late
+  EXPECT_GT(periods, 50);
+  EXPECT_LT(periods, 150);
+
+  TickStatistics stats = loop.statistics();
+  EXPECT_LE(stats.ticks, periods);
+  EXPECT_EQ(periods, stats.ticks + stats.overruns);
+  EXPECT_LE(0, stats.min_latency);
+  EXPECT_LE(stats.min_latency, stats.mean_latency);
+  EXPECT_LE(stats.mean_latency, stats.max_latency);
+
+  stats = loop.statistics(true);
+  EXPECT_LT(0, stats.ticks);
+  EXPECT_EQ(0, loop.statistics().ticks);
+}
+
+TEST(RealtimeLoopTest, CatchesUpAfterOverruns)
+{
+  RealtimeLoop loop;
+  std::atomic<size_t> periods(0), ticks(0);
+  ASSERT_NO_THROW(loop.start(1000000, [&periods, &ticks](size_t p)
+  {
+    periods += p;
+    ticks++;
+    std::this_thread::sleep_for(std::chrono::milliseconds(3));
+  }));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  loop.stop();
+
+  EXPECT_LT(ticks, 50);
+  EXPECT_GT(periods, 50);
+  EXPECT_LT(0, loop.statistics().overruns);
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+#include <algorithm>
+#include <cmath>
+
+using namespace iai_naive_kinematics_sim;
+
+class RobotGeneratorTest : public ::testing::Test
+{
+   protected:
+    virtual void SetUp()
+    {
+      config_.chains = 2;
+      config_.chain_depth = 3;
+      config_.joint_types.clear();
+      config_.joint_types.push_back("revolute");
+      config_.joint_types.push_back("fixed");
+      config_.joint_types.push_back("prismatic");
+      config_.fingers = 3;
+      config_.sharing = 2;
+    }
+
+    virtual void TearDown(){}
+
+    RobotGeneratorConfig config_;
+
+    void initSimulator(Simulator& sim, const RobotGenerator& generator) const
+    {
+      urdf::Model model;
+      ASSERT_TRUE(model.initString(generator.makeURDF()));
+      sim.init(model, generator.getSimulatedJoints(), generator.getControlledJoints(),
+          ros::Duration(0.1), generator.makeFakeControllers());
+    }
+
+    double position(const Simulator& sim, const std::string& name) const
+    {
+      const std::vector<std::string>& names = sim.getJointNames();
+      size_t index = std::find(names.begin(), names.end(), name) - names.begin();
+      return sim.getJointState().position.at(index);
+    }
+};
+
+TEST_F(RobotGeneratorTest, JointNames)
+{
+  RobotGenerator generator(config_);
+
+  std::vector<std::string> controlled;
+  controlled.push_back("chain0_joint0");
+  controlled.push_back("chain0_joint2");
+  controlled.push_back("chain1_joint0");
+  controlled.push_back("chain1_joint2");
+  EXPECT_EQ(controlled, generator.getControlledJoints());
+
+  ASSERT_EQ(10, generator.getSimulatedJoints().size());
+  EXPECT_EQ("chain0_joint2", generator.getSimulatedJoints()[1]);
+  EXPECT_EQ("chain0_finger0_joint", generator.getSimulatedJoints()[2]);
+  EXPECT_EQ("chain1_joint0", generator.getSimulatedJoints()[5]);
+  EXPECT_EQ("chain1_finger2_joint", generator.getSimulatedJoints()[9]);
+}
+
+TEST_F(RobotGeneratorTest, URDF)
+{
+  RobotGenerator generator(config_);
+  urdf::Model model;
+  ASSERT_TRUE(model.initString(generator.makeURDF()));
+
+  EXPECT_EQ(urdf::Joint::REVOLUTE, model.getJoint("chain1_joint0")->type);
+  EXPECT_EQ(urdf::Joint::FIXED, model.getJoint("chain1_joint1")->type);
+  EXPECT_EQ(urdf::Joint::PRISMATIC, model.getJoint("chain1_joint2")->type);
+  EXPECT_EQ(urdf::Joint::REVOLUTE, model.getJoint("chain1_finger1_joint")->type);
+  EXPECT_DOUBLE_EQ(0.3, model.getJoint("chain1_joint2")->limits->upper);
+}
+
+TEST_F(RobotGeneratorTest, Config)
+{
+  RobotGenerator generator(config_);
+  YAML::Node config = YAML::Load(YAML::Dump(generator.makeConfig("file:///tmp/fake.yaml")));
+
+  EXPECT_EQ(generator.getSimulatedJoints(), config["simulated_joints"].as< std::vector<std::string> >());
+  EXPECT_EQ(generator.getControlledJoints(), config["controlled_joints"].as< std::vector<std::string> >());
+  EXPECT_FALSE(config["projection_mode"].as<bool>());
+  EXPECT_DOUBLE_EQ(0.1, config["watchdog_period"].as<double>());
+  EXPECT_EQ("file:///tmp/fake.yaml", config["fake_controllers"].as<std::string>());
+  EXPECT_FALSE(generator.makeConfig()["fake_controllers"]);
+}
+
+TEST_F(RobotGeneratorTest, FingersFollowTheirJoints)
+{
+  RobotGenerator generator(config_);
+  Simulator sim;
+  initSimulator(sim, generator);
+
+  sensor_msgs::JointState state;
+  pushBackJointState(state, "chain0_joint0", 1.5, 0.0, 0.0);
+  pushBackJointState(state, "chain0_joint2", 0.06, 0.0, 0.0);
+  sim.setSubJointState(state);
+  sim.update(ros::Time(1.0), ros::Duration(0.01));
+
+  // with a sharing of 2, fingers 0 and 1 follow the first joint and finger 2 the second
+  EXPECT_NEAR(-2.5 + 0.8 * 5.0, position(sim, "chain0_finger0_joint"), 1e-9);
+  EXPECT_NEAR(-2.5 + 0.8 * 5.0, position(sim, "chain0_finger1_joint"), 1e-9);
+  EXPECT_NEAR(-2.5 + 0.2 * 5.0, position(sim, "chain0_finger2_joint"), 1e-9);
+  EXPECT_NEAR(-2.5 + 0.5 * 5.0, position(sim, "chain1_finger0_joint"), 1e-9);
+}
+
+TEST_F(RobotGeneratorTest, ExpressionDepth)
+{
+  config_.expression_depth = 3;
+  RobotGenerator generator(config_);
+  Simulator sim;
+  initSimulator(sim, generator);
+
+  sensor_msgs::JointState state;
+  pushBackJointState(state, "chain0_joint0", 1.5, 0.0, 0.0);
+  sim.setSubJointState(state);
+  sim.update(ros::Time(1.0), ros::Duration(0.01));
+
+  double fraction = 0.5 * std::sin(0.5 * std::sin(0.8) + 0.5) + 0.5;
+  EXPECT_NEAR(-2.5 + fraction * 5.0,
+      position(sim, "chain0_finger0_joint"), 1e-9);
+}
+
+TEST_F(RobotGeneratorTest, ScalesToLargeRobots)
+{
+  config_.chains = 8;
+  config_.chain_depth = 100;
+  config_.joint_types.push_back("continuous");
+  config_.fingers = 4;
+  config_.expression_depth = 4;
+  RobotGenerator generator(config_);
+  Simulator sim;
+  initSimulator(sim, generator);
+  ASSERT_EQ(8 * (75 + 4), sim.size());
+
+  sensor_msgs::JointState command;
+  for (size_t i=0; i<generator.getControlledJoints().size(); ++i)
+    pushBackJointState(command, generator.getControlledJoints()[i], 0.0, 0.1, 0.0);
+  ros::Time now(1.0);
+  for (size_t i=0; i<100; ++i, now += ros::Duration(0.01))
+  {
+    sim.setSubCommand(command, now);
+    sim.update(now, ros::Duration(0.01));
+  }
+
+  const sensor_msgs::JointState& state = sim.getJointState();
+  EXPECT_NEAR(0.1, position(sim, "chain7_joint98"), 1e-9);
+  EXPECT_NEAR(0.1, position(sim, "chain7_joint99"), 1e-9);
+  for (size_t i=0; i<state.name.size(); ++i)
+    if (state.name[i].find("finger") != std::string::npos)
+    {
+      EXPECT_LE(-2.5, state.position[i]);
+      EXPECT_GE(2.5, state.position[i]);
+    }
+}
+
+TEST_F(RobotGeneratorTest, InvalidConfigs)
+{
+  RobotGeneratorConfig config = config_;
+  config.chain_depth = 0;
+  EXPECT_ANY_THROW(RobotGenerator generator(config));
+
+  config = config_;
+  config.joint_types.push_back("planar");
+  EXPECT_ANY_THROW(RobotGenerator generator(config));
+
+  config = config_;
+  config.sharing = 0;
+  EXPECT_ANY_THROW(RobotGenerator generator(config));
+
+  // fingers cannot follow joints without limits
+  config = config_;
+  config.joint_types.assign(1, "continuous");
+  EXPECT_ANY_THROW(RobotGenerator generator(config));
+  config.fingers = 0;
+  EXPECT_NO_THROW(RobotGenerator generator(config));
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+#include <atomic>
+#include <thread>
+
+using namespace iai_naive_kinematics_sim;
+
+class RolloutSchedulerTest : public ::testing::Test
+{
+   protected:
+    virtual void SetUp()
+    {
+      now_ = ros::Time(2.0);
+      dt_ = ros::Duration(0.01);
+      model_.initFile("test_robot.urdf");
+      simulated_joints_.push_back("joint1");
+      simulated_joints_.push_back("joint2");
+      controlled_joints_.push_back("joint1");
+      fake_controllers_ = YAML::Load(
+          "- joint2: {position: {add: [{mul: [{f-pos-of: joint1}, {pos-lim-len-of: joint2}]}, "
+          "{pos-lim-low-of: joint2}]}, effort: {sin: [{vel-of: joint1}]}}\n");
+
+      ASSERT_NO_THROW(sim_.init(model_, simulated_joints_, controlled_joints_,
+          ros::Duration(0.05), fake_controllers_));
+
+      // one schedule per world, all of them different
+      for (size_t w=0; w<37; ++w)
+      {
+        std::vector<sensor_msgs::JointState> commands(30);
+        for (size_t i=0; i<commands.size(); i+=1+w%5)
+          pushBackJointState(commands[i], "joint1", 0.0, 0.1 * w - 1.5 + 0.05 * i, 0.0);
+        schedules_.push_back(commands);
+      }
+    }
+
+    virtual void TearDown(){}
+
+    urdf::Model model_;
+    std::vector<std::string> simulated_joints_, controlled_joints_;
+    YAML::Node fake_controllers_;
+    Simulator sim_;
+    ros::Time now_;
+    ros::Duration dt_;
+    std::vector< std::vector<sensor_msgs::JointState> > schedules_;
+
+    // expects bit-identical trajectories
+    void checkTrajectoriesEquality(const std::vector< std::vector<sensor_msgs::JointState> >& a,
+        const std::vector< std::vector<sensor_msgs::JointState> >& b) const
+    {
+      ASSERT_EQ(a.size(), b.size());
+      for (size_t w=0; w<a.size(); ++w)
+      {
+        ASSERT_EQ(a[w].size(), b[w].size());
+        for (size_t i=0; i<a[w].size(); ++i)
+        {
+          EXPECT_EQ(a[w][i].header.stamp, b[w][i].header.stamp);
+          EXPECT_EQ(a[w][i].name, b[w][i].name);
+          EXPECT_EQ(a[w][i].position, b[w][i].position);
+          EXPECT_EQ(a[w][i].velocity, b[w][i].velocity);
+          EXPECT_EQ(a[w][i].effort, b[w][i].effort);
+        }
+      }
+    }
+};
+
+TEST(WorkStealingPoolTest, Init)
+{
+  EXPECT_THROW(WorkStealingPool(0), std::runtime_error);
+
+  WorkStealingPool pool(3);
+  EXPECT_EQ(3, pool.size());
+}
+
+TEST(WorkStealingPoolTest, RunsAllTasks)
+{
+  WorkStealingPool pool(4);
+  std::vector<int> done(1000, 0);
+  std::vector< std::function<void()> > tasks;
+  for (size_t i=0; i<done.size(); ++i)
+    tasks.push_back([&done, i]() { done[i]++; });
+
+  ASSERT_NO_THROW(pool.run(tasks));
+  for (size_t i=0; i<done.size(); ++i)
+    EXPECT_EQ(1, done[i]);
+
+  ASSERT_NO_THROW(pool.run(std::vector< std::function<void()> >()));
+}
+
+TEST(WorkStealingPoolTest, RethrowsErrors)
+{
+  WorkStealingPool pool(2);
+  std::atomic<int> done(0);
+  std::vector< std::function<void()> > tasks;
+  for (size_t i=0; i<10; ++i)
+    tasks.push_back([&done, i]()
+    {
+      done++;
+      if (i == 5)
+        throw std::runtime_error("task failed");
+    });
+
+  EXPECT_THROW(pool.run(tasks), std::runtime_error);
+  EXPECT_EQ(10, done);
+}
+
+TEST(WorkStealingPoolTest, NestedTasks)
+{
+  // with a single worker, tasks that waited for their own tasks would never finish
+  WorkStealingPool pool(1);
+  std::atomic<int> done(0);
+  std::vector< std::function<void()> > tasks;
+  for (size_t i=0; i<4; ++i)
+    tasks.push_back([&pool, &done]()
+    {
+      std::vector< std::function<void()> > nested(3, [&done]() { done++; });
+      pool.run(nested);
+      done++;
+    });
+
+  ASSERT_NO_THROW(pool.run(tasks));
+  EXPECT_EQ(16, done);
+}
+
+TEST(WorkStealingPoolTest, ShutdownRunsQueuedTasks)
+{
+  WorkStealingPool pool(1);
+  std::atomic<bool> started(false), go(false);
+  std::atomic<int> done(0);
+  std::vector< std::function<void()> > tasks;
+  tasks.push_back([&]()
+  {
+    started = true;
+    while (!go)
+      std::this_thread::yield();
+    done++;
+  });
+  tasks.push_back([&done]() { done++; });
+  tasks.push_back([&done]() { done++; });
+
+  std::thread caller([&pool, &tasks]() { EXPECT_NO_THROW(pool.run(tasks)); });
+  while (!started)
+    std::this_thread::yield();
+  std::thread stopper([&pool]() { pool.shutdown(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  go = true;
+  caller.join();
+  stopper.join();
+
+  EXPECT_EQ(3, done);
+  EXPECT_THROW(pool.run(tasks), std::runtime_error);
+}
+
+TEST_F(RolloutSchedulerTest, Init)
+{
+  EXPECT_THROW(RolloutScheduler(2, std::vector<int>(), 0), std::runtime_error);
+
+  RolloutScheduler scheduler(2, std::vector<int>(), 5);
+  EXPECT_EQ(2, scheduler.threads());
+  EXPECT_EQ(5, scheduler.batchSize());
+}
+
+TEST_F(RolloutSchedulerTest, IndependentOfThreadsAndBatches)
+{
+  BatchSimulator batch;
+  ASSERT_NO_THROW(batch.init(sim_, schedules_.size()));
+  std::vector< std::vector<sensor_msgs::JointState> > expected;
+  ASSERT_NO_THROW(batch.rollout(now_, dt_, 40, schedules_, 3, expected));
+
+  size_t threads[] = {1, 2, 5};
+  size_t batch_sizes[] = {1, 4, 8, 64};
+  for (size_t t=0; t<3; ++t)
+    for (size_t b=0; b<4; ++b)
+    {
+      RolloutScheduler scheduler(threads[t], std::vector<int>(), batch_sizes[b]);
+      std::vector< std::vector<sensor_msgs::JointState> > trajectories;
+      ASSERT_NO_THROW(scheduler.rollout(sim_, now_, dt_, 40, schedules_, 3, trajectories));
+      checkTrajectoriesEquality(expected, trajectories);
+    }
+}
+
+TEST_F(RolloutSchedulerTest, RethrowsErrors)
+{
+  schedules_[20].resize(50);
+
+  RolloutScheduler scheduler(3, std::vector<int>(), 4);
+  std::vector< std::vector<sensor_msgs::JointState> > trajectories;
+  EXPECT_THROW(scheduler.rollout(sim_, now_, dt_, 40, schedules_, 3, trajectories),
+      std::runtime_error);
+}
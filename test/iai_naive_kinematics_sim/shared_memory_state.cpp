@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+#include <thread>
+
+using namespace iai_naive_kinematics_sim;
+
+class SharedMemoryStateTest : public ::testing::Test
+{
+   protected:
+    virtual void SetUp()
+    {
+      name_ = "/iai_naive_kinematics_sim_test_" + std::to_string(getpid());
+      names_.push_back("joint1");
+      names_.push_back("a_rather_long_joint_name");
+      names_.push_back("joint3");
+    }
+
+    virtual void TearDown(){}
+
+    std::string name_;
+    std::vector<std::string> names_;
+};
+
+TEST_F(SharedMemoryStateTest, Open)
+{
+  SharedMemoryStateReader reader;
+  EXPECT_THROW(reader.open(name_), std::runtime_error);
+
+  SharedMemoryStatePublisher publisher;
+  EXPECT_FALSE(publisher.isOpen());
+  EXPECT_THROW(publisher.open(name_, names_, 0), std::runtime_error);
+  ASSERT_NO_THROW(publisher.open(name_, names_, 4));
+  EXPECT_TRUE(publisher.isOpen());
+
+  ASSERT_NO_THROW(reader.open(name_));
+  EXPECT_TRUE(reader.isAlive());
+  EXPECT_EQ(names_, reader.names());
+
+  SharedJointState state;
+  EXPECT_FALSE(reader.read(state));
+
+  publisher.close();
+  EXPECT_FALSE(reader.isAlive());
+  EXPECT_FALSE(reader.read(state));
+  SharedMemoryStateReader other;
+  EXPECT_THROW(other.open(name_), std::runtime_error);
+}
+
+TEST_F(SharedMemoryStateTest, TakeOver)
+{
+  SharedMemoryStatePublisher first;
+  ASSERT_NO_THROW(first.open(name_, names_, 4));
+  SharedMemoryStateReader reader;
+  ASSERT_NO_THROW(reader.open(name_));
+
+  SharedMemoryStatePublisher second;
+  EXPECT_THROW(second.open(name_, names_, 4), std::runtime_error);
+  EXPECT_FALSE(second.isOpen());
+  EXPECT_TRUE(reader.isAlive());
+
+  ASSERT_NO_THROW(second.open(name_, names_, 4, true));
+  EXPECT_FALSE(reader.isAlive());
+
+  // closing the replaced publisher leaves the name to the new one
+  first.close();
+  SharedMemoryStateReader other;
+  ASSERT_NO_THROW(other.open(name_));
+  EXPECT_TRUE(other.isAlive());
+
+  second.close();
+  EXPECT_FALSE(other.isAlive());
+  EXPECT_THROW(reader.open(name_), std::runtime_error);
+}
+
+TEST_F(SharedMemoryStateTest, ReadsLatestState)
+{
+  SharedMemoryStatePublisher publisher;
+  ASSERT_NO_THROW(publisher.open(name_, names_, 2));
+  SharedMemoryStateReader reader;
+  ASSERT_NO_THROW(reader.open(name_));
+
+  SharedJointState state;
+  for (size_t i=0; i<5; ++i)
+  {
+    double position[] = {1.0 * i, 2.0, 3.0};
+    double velocity[] = {-1.0, -2.0 * i, -3.0};
+    double effort[] = {0.1, 0.2, 0.3 * i};
+    publisher.publish(10 + i, 1000 * i, position, velocity, effort);
+
+    ASSERT_TRUE(reader.read(state));
+    EXPECT_EQ(i + 1, state.count);
+    EXPECT_EQ(10 + i, state.seq);
+    EXPECT_EQ(1000 * i, state.stamp);
+    EXPECT_EQ(std::vector<double>(position, position + 3), state.position);
+    EXPECT_EQ(std::vector<double>(velocity, velocity + 3), state.velocity);
+    EXPECT_EQ(std::vector<double>(effort, effort + 3), state.effort);
+  }
+}
+
+TEST_F(SharedMemoryStateTest, ConcurrentReadsAreConsistent)
+{
+  SharedMemoryStatePublisher publisher;
+  ASSERT_NO_THROW(publisher.open(name_, names_, 2));
+  SharedMemoryStateReader reader;
+  ASSERT_NO_THROW(reader.open(name_));
+
+  // every published state holds its own number in all fields, so torn reads would show
+  std::thread writer([&publisher]()
+  {
+    for (size_t i=1; i<=20000; ++i)
+    {
+      double values[] = {1.0 * i, 1.0 * i, 1.0 * i};
+      publisher.publish(i, i, values, values, values);
+    }
+  });
+
+  SharedJointState state;
+  uint64_t last = 0;
+  while (last < 20000)
+  {
+    if (!reader.read(state))
+      continue;
+
+    ASSERT_GE(state.count, last);
+    ASSERT_EQ(state.count, state.seq);
+    ASSERT_EQ(state.count, state.stamp);
+    for (size_t j=0; j<names_.size(); ++j)
+    {
+      ASSERT_EQ(state.count, state.position[j]);
+      ASSERT_EQ(state.count, state.velocity[j]);
+      ASSERT_EQ(state.count, state.effort[j]);
+    }
+    last = state.count;
+  }
+
+  writer.join();
+}
@@ -209,3 +209,221 @@ TEST_F(SimulatorTest, HasJoint)
   EXPECT_FALSE(sim.hasControlledJoint("joint3"));
 
 }
+
+TEST_F(SimulatorTest, ControlledJointsNotSimulated)
+{
+  iai_naive_kinematics_sim::Simulator sim;
+  std::vector<std::string> simulated_joints;
+  simulated_joints.push_back("joint1");
+
+  EXPECT_THROW(sim.init(model_, simulated_joints, controlled_joints_, watchdog_period_),
+      std::runtime_error);
+}
+
+TEST_F(SimulatorTest, Rollout)
+{
+  iai_naive_kinematics_sim::Simulator sim, reference;
+  ASSERT_NO_THROW(sim.init(model_, simulated_joints_, controlled_joints_, watchdog_period_));
+  ASSERT_NO_THROW(reference.init(model_, simulated_joints_, controlled_joints_, watchdog_period_));
+
+  // joint2 is commanded in the first step only, so its watchdog stops it after 0.1s
+  sensor_msgs::JointState command;
+  iai_naive_kinematics_sim::pushBackJointState(command, "joint2", 0.0, 0.1, 0.0);
+  std::vector<sensor_msgs::JointState> commands(1, command);
+  ros::Duration dt(0.05);
+
+  std::vector<sensor_msgs::JointState> trajectory;
+  ASSERT_NO_THROW(sim.rollout(now_, dt, 5, commands, 2, trajectory));
+
+  ASSERT_EQ(3, trajectory.size());
+  std::vector<sensor_msgs::JointState> expected;
+  ros::Time t = now_;
+  for (size_t i=0; i<5; ++i, t += dt)
+  {
+    if (i == 0)
+      ASSERT_NO_THROW(reference.setSubCommand(command, t));
+    ASSERT_NO_THROW(reference.update(t, dt));
+    if (i == 1 || i == 3 || i == 4)
+      expected.push_back(reference.getJointState());
+  }
+
+  for (size_t i=0; i<trajectory.size(); ++i)
+    checkJointStatesEquality(trajectory[i], expected[i]);
+  checkJointStatesEquality(sim.getJointState(), reference.getJointState());
+  EXPECT_DOUBLE_EQ(0.015, sim.getJointState().position[1]);
+}
+
+TEST_F(SimulatorTest, RolloutFinalState)
+{
+  iai_naive_kinematics_sim::Simulator sim;
+  ASSERT_NO_THROW(sim.init(model_, simulated_joints_, controlled_joints_, watchdog_period_));
+
+  std::vector<sensor_msgs::JointState> trajectory, commands;
+  ASSERT_NO_THROW(sim.rollout(now_, dt_, 3, commands, 0, trajectory));
+  ASSERT_EQ(1, trajectory.size());
+  EXPECT_EQ(3, trajectory[0].header.seq);
+  EXPECT_EQ(now_ + dt_ + dt_, trajectory[0].header.stamp);
+
+  commands.resize(4);
+  EXPECT_THROW(sim.rollout(now_, dt_, 3, commands, 0, trajectory), std::runtime_error);
+}
+
+TEST_F(SimulatorTest, CompactJointState)
+{
+  iai_naive_kinematics_sim::Simulator sim;
+  ASSERT_NO_THROW(sim.init(model_, simulated_joints_, controlled_joints_, watchdog_period_));
+  ASSERT_NO_THROW(sim.setSubJointState(state1_));
+  ASSERT_NO_THROW(sim.setSubCommand(state3_, now_));
+  ASSERT_NO_THROW(sim.update(now_, dt_));
+
+  iai_naive_kinematics_sim::JointStateLayout layout =
+    iai_naive_kinematics_sim::makeJointStateLayout(sim.getJointNames());
+  EXPECT_EQ(state3_.name, layout.name);
+
+  const iai_naive_kinematics_sim::CompactJointState& compact = sim.getCompactJointState();
+  EXPECT_EQ(layout.id, compact.layout_id);
+  EXPECT_EQ(state3_.header.seq, compact.header.seq);
+  EXPECT_EQ(state3_.header.stamp, compact.header.stamp);
+  EXPECT_EQ(sim.getJointState().position, compact.position);
+  EXPECT_EQ(sim.getJointState().velocity, compact.velocity);
+  EXPECT_EQ(sim.getJointState().effort, compact.effort);
+}
+
+TEST_F(SimulatorTest, LayoutId)
+{
+  std::vector<std::string> a, b, c;
+  a.push_back("ab");
+  a.push_back("c");
+  b.push_back("a");
+  b.push_back("bc");
+  c.push_back("c");
+  c.push_back("ab");
+
+  EXPECT_EQ(iai_naive_kinematics_sim::layoutId(a), iai_naive_kinematics_sim::layoutId(a));
+  EXPECT_NE(iai_naive_kinematics_sim::layoutId(a), iai_naive_kinematics_sim::layoutId(b));
+  EXPECT_NE(iai_naive_kinematics_sim::layoutId(a), iai_naive_kinematics_sim::layoutId(c));
+}
+
+TEST_F(SimulatorTest, Substep)
+{
+  iai_naive_kinematics_sim::Simulator sim, reference;
+  ASSERT_NO_THROW(sim.init(model_, simulated_joints_, controlled_joints_, watchdog_period_));
+  ASSERT_NO_THROW(reference.init(model_, simulated_joints_, controlled_joints_, watchdog_period_));
+  ASSERT_NO_THROW(sim.setSubJointState(state1_));
+  ASSERT_NO_THROW(reference.setSubJointState(state1_));
+  ASSERT_NO_THROW(sim.setSubCommand(state3_, now_));
+  ASSERT_NO_THROW(reference.setSubCommand(state3_, now_));
+
+  EXPECT_THROW(sim.substep(now_, dt_, 0), std::runtime_error);
+
+  // one substep is a plain update
+  ASSERT_NO_THROW(sim.substep(now_, dt_, 1));
+  ASSERT_NO_THROW(reference.update(now_, dt_));
+  checkJointStatesEquality(sim.getJointState(), reference.getJointState());
+
+  // the substeps cover the whole period, and the last one carries the stamp
+  ros::Duration third(0.01);
+  ros::Time later = now_ + third + third + third;
+  ASSERT_NO_THROW(sim.setSubCommand(state3_, later));
+  ASSERT_NO_THROW(reference.setSubCommand(state3_, later));
+  ASSERT_NO_THROW(sim.substep(later, third + third + third, 3));
+  for (size_t i=0; i<3; ++i)
+    ASSERT_NO_THROW(reference.update(later - ros::Duration(0.01 * (2 - i)), third));
+  checkJointStatesEquality(sim.getJointState(), reference.getJointState());
+  EXPECT_EQ(later, sim.getJointState().header.stamp);
+  EXPECT_EQ(4, sim.getJointState().header.seq);
+}
+
+TEST_F(SimulatorTest, RepeatedLayouts)
+{
+  iai_naive_kinematics_sim::Simulator sim;
+  ASSERT_NO_THROW(sim.init(model_, simulated_joints_, simulated_joints_, watchdog_period_));
+
+  // the same names over and over, as controllers send them, and then in another order
+  for (size_t i=0; i<3; ++i)
+  {
+    ASSERT_NO_THROW(sim.setSubJointState(state1_));
+    checkJointStatesEquality(sim.getJointState(), state1_);
+    ASSERT_NO_THROW(sim.setSubCommand(state1_, now_));
+    EXPECT_EQ(state1_.velocity, sim.getCommand().velocity);
+  }
+
+  sensor_msgs::JointState reversed;
+  iai_naive_kinematics_sim::pushBackJointState(reversed, "joint2", 0.5, 0.6, 0.7);
+  iai_naive_kinematics_sim::pushBackJointState(reversed, "joint1", 0.1, 0.2, 0.3);
+  ASSERT_NO_THROW(sim.setSubJointState(reversed));
+  ASSERT_NO_THROW(sim.setSubCommand(reversed, now_));
+  EXPECT_DOUBLE_EQ(0.1, sim.getJointState().position[0]);
+  EXPECT_DOUBLE_EQ(0.5, sim.getJointState().position[1]);
+  EXPECT_DOUBLE_EQ(0.2, sim.getCommand().velocity[0]);
+  EXPECT_DOUBLE_EQ(0.6, sim.getCommand().velocity[1]);
+}
+
+TEST_F(SimulatorTest, RejectedStatesChangeNothing)
+{
+  iai_naive_kinematics_sim::Simulator sim;
+  ASSERT_NO_THROW(sim.init(model_, simulated_joints_, controlled_joints_, watchdog_period_));
+
+  sensor_msgs::JointState state = state2_;
+  iai_naive_kinematics_sim::pushBackJointState(state, "not_a_joint", 1.0, 1.0, 1.0);
+  EXPECT_THROW(sim.setSubJointState(state), std::runtime_error);
+  checkJointStatesEquality(sim.getJointState(), zero_state_);
+
+  sensor_msgs::JointState command = state2_;
+  command.velocity.pop_back();
+  EXPECT_THROW(sim.setSubCommand(command, now_), std::range_error);
+
+  // states without efforts keep the current efforts
+  ASSERT_NO_THROW(sim.setSubJointState(state1_));
+  state = state2_;
+  state.effort.clear();
+  ASSERT_NO_THROW(sim.setSubJointState(state));
+  EXPECT_EQ(state2_.position, sim.getJointState().position);
+  EXPECT_EQ(state1_.effort, sim.getJointState().effort);
+}
+
+TEST_F(SimulatorTest, ExpiredWatchdogs)
+{
+  iai_naive_kinematics_sim::Simulator sim;
+  ASSERT_NO_THROW(sim.init(model_, simulated_joints_, controlled_joints_, watchdog_period_));
+  ASSERT_NO_THROW(sim.update(now_, dt_));
+  EXPECT_TRUE(sim.popExpiredWatchdogs().empty());
+
+  ASSERT_NO_THROW(sim.setSubCommand(state4_, now_));
+  ros::Duration dt(0.05);
+  ASSERT_NO_THROW(sim.update(now_ + dt, dt));
+  EXPECT_TRUE(sim.popExpiredWatchdogs().empty());
+  EXPECT_DOUBLE_EQ(7.75, sim.getCommand().velocity[1]);
+
+  ASSERT_NO_THROW(sim.update(now_ + dt + dt + dt, dt));
+  EXPECT_EQ(std::vector<std::string>(1, "joint2"), sim.popExpiredWatchdogs());
+  EXPECT_TRUE(sim.popExpiredWatchdogs().empty());
+  EXPECT_DOUBLE_EQ(0.0, sim.getCommand().velocity[1]);
+  EXPECT_DOUBLE_EQ(0.0, sim.getJointState().velocity[1]);
+}
+
+TEST_F(SimulatorTest, WatchdogPeriods)
+{
+  iai_naive_kinematics_sim::Simulator sim;
+  ASSERT_NO_THROW(sim.init(model_, simulated_joints_, simulated_joints_, watchdog_period_));
+  EXPECT_EQ(watchdog_period_, sim.getWatchdogPeriod("joint1"));
+  EXPECT_THROW(sim.getWatchdogPeriod("joint3"), std::runtime_error);
+  EXPECT_THROW(sim.setWatchdogPeriod("joint3", ros::Duration(0.1)), std::runtime_error);
+  EXPECT_THROW(sim.setWatchdogPeriod("joint1", ros::Duration(0.0)), std::runtime_error);
+
+  // joint1 is commanded slowly and tolerates it, joint2 stops right away
+  ASSERT_NO_THROW(sim.setWatchdogPeriod("joint1", ros::Duration(0.5)));
+  ASSERT_NO_THROW(sim.setWatchdogPeriod("joint2", ros::Duration(0.005)));
+  EXPECT_EQ(ros::Duration(0.5), sim.getWatchdogPeriod("joint1"));
+
+  sensor_msgs::JointState command;
+  iai_naive_kinematics_sim::pushBackJointState(command, "joint1", 0.0, 0.1, 0.0);
+  iai_naive_kinematics_sim::pushBackJointState(command, "joint2", 0.0, 0.1, 0.0);
+  ASSERT_NO_THROW(sim.setSubCommand(command, now_));
+
+  ros::Duration dt(0.01);
+  ASSERT_NO_THROW(sim.update(now_ + dt, dt));
+  EXPECT_DOUBLE_EQ(0.1, sim.getCommand().velocity[0]);
+  EXPECT_DOUBLE_EQ(0.0, sim.getCommand().velocity[1]);
+  EXPECT_EQ(std::vector<std::string>(1, "joint2"), sim.popExpiredWatchdogs());
+}
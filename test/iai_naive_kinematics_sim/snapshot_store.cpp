@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+
+using namespace iai_naive_kinematics_sim;
+
+class SnapshotTest : public ::testing::Test
+{
+   protected:
+    virtual void SetUp()
+    {
+      RobotGeneratorConfig config;
+      config.chains = 2;
+      config.chain_depth = 3;
+      config.fingers = 2;
+      generator_.reset(new RobotGenerator(config));
+      ASSERT_TRUE(model_.initString(generator_->makeURDF()));
+      sim_.init(model_, generator_->getSimulatedJoints(), generator_->getControlledJoints(),
+          ros::Duration(0.1), generator_->makeFakeControllers());
+
+      const std::vector<std::string>& controlled = generator_->getControlledJoints();
+      for (size_t i=0; i<controlled.size(); ++i)
+        pushBackJointState(command_, controlled[i], 0.0, 0.1 * (i+1), 0.0);
+    }
+
+    virtual void TearDown(){}
+
+    std::unique_ptr<RobotGenerator> generator_;
+    urdf::Model model_;
+    Simulator sim_;
+    sensor_msgs::JointState command_;
+
+    // steps the simulator, and sends the command only in the first steps, so that the
+    // watchdogs expire in between
+    void simulate(Simulator& sim, const ros::Time& start, size_t steps, size_t commanded) const
+    {
+      ros::Duration dt(0.01);
+      ros::Time now = start;
+      for (size_t i=0; i<steps; ++i, now += dt)
+      {
+        if (i < commanded)
+          sim.setSubCommand(command_, now);
+        sim.update(now, dt);
+      }
+    }
+
+    void expectSameState(const Simulator& a, const Simulator& b) const
+    {
+      EXPECT_EQ(a.getHeader().stamp, b.getHeader().stamp);
+      EXPECT_EQ(a.getJointState().position, b.getJointState().position);
+      EXPECT_EQ(a.getJointState().velocity, b.getJointState().velocity);
+      EXPECT_EQ(a.getJointState().effort, b.getJointState().effort);
+      EXPECT_EQ(a.getCommand().velocity, b.getCommand().velocity);
+    }
+};
+
+TEST_F(SnapshotTest, RestoreContinuesLikeAFork)
+{
+  simulate(sim_, ros::Time(1.0), 10, 10);
+  SimulatorSnapshot snapshot;
+  sim_.snapshot(snapshot);
+  Simulator reference = sim_;
+
+  // the reference runs on from the snapshot, sim_ diverges and is set back
+  simulate(reference, ros::Time(1.1), 30, 5);
+  simulate(sim_, ros::Time(1.1), 50, 50);
+  sim_.restore(snapshot);
+  EXPECT_EQ(snapshot.stamp, sim_.getHeader().stamp);
+  simulate(sim_, ros::Time(1.1), 30, 5);
+
+  // including the watchdogs, which stopped the joints in both of them
+  expectSameState(reference, sim_);
+  for (size_t i=0; i<sim_.getCommand().velocity.size(); ++i)
+    EXPECT_EQ(0.0, sim_.getCommand().velocity[i]);
+}
+
+TEST_F(SnapshotTest, RestoresRepeatedly)
+{
+  simulate(sim_, ros::Time(1.0), 10, 10);
+  SimulatorSnapshot snapshot;
+  sim_.snapshot(snapshot);
+
+  simulate(sim_, ros::Time(1.1), 20, 20);
+  Simulator first = sim_;
+  for (size_t i=0; i<3; ++i)
+  {
+    sim_.restore(snapshot);
+    simulate(sim_, ros::Time(1.1), 20, 20);
+    expectSameState(first, sim_);
+  }
+}
+
+TEST_F(SnapshotTest, RejectsOtherRobots)
+{
+  SimulatorSnapshot snapshot;
+  sim_.snapshot(snapshot);
+
+  RobotGeneratorConfig config;
+  config.chains = 3;
+  RobotGenerator generator(config);
+  urdf::Model model;
+  ASSERT_TRUE(model.initString(generator.makeURDF()));
+  Simulator other;
+  other.init(model, generator.getSimulatedJoints(), generator.getControlledJoints(),
+      ros::Duration(0.1), generator.makeFakeControllers());
+  EXPECT_THROW(other.restore(snapshot), std::runtime_error);
+
+  // same joints, but without fake controllers
+  Simulator plain;
+  plain.init(model_, generator_->getSimulatedJoints(), generator_->getControlledJoints(),
+      ros::Duration(0.1));
+  EXPECT_THROW(plain.restore(snapshot), std::runtime_error);
+
+  // same joints, and fake controllers of the same shape that compute something else
+  YAML::Node controllers = generator_->makeFakeControllers();
+  YAML::Node position = controllers["fake-controllers"][0].begin()->second["position"];
+  YAML::Node arguments = position["add"];
+  position.remove("add");
+  position["sub"] = arguments;
+  Simulator changed;
+  changed.init(model_, generator_->getSimulatedJoints(), generator_->getControlledJoints(),
+      ros::Duration(0.1), controllers);
+  EXPECT_THROW(changed.restore(snapshot), std::runtime_error);
+
+  // same joints and fake controllers
+  Simulator same;
+  same.init(model_, generator_->getSimulatedJoints(), generator_->getControlledJoints(),
+      ros::Duration(0.1), generator_->makeFakeControllers());
+  EXPECT_NO_THROW(same.restore(snapshot));
+}
+
+TEST_F(SnapshotTest, ForksShareTheModel)
+{
+  simulate(sim_, ros::Time(1.0), 10, 10);
+  Simulator fork = sim_;
+
+  // forks simulate independently
+  simulate(fork, ros::Time(1.1), 10, 0);
+  EXPECT_NE(sim_.getJointState().position, fork.getJointState().position);
+
+  // loading other fake controllers into a fork leaves the original alone
+  Simulator reference = sim_;
+  fork.loadFakeJoints(YAML::Node());
+  simulate(sim_, ros::Time(1.1), 10, 10);
+  simulate(reference, ros::Time(1.1), 10, 10);
+  expectSameState(reference, sim_);
+  SimulatorSnapshot snapshot;
+  sim_.snapshot(snapshot);
+  EXPECT_THROW(fork.restore(snapshot), std::runtime_error);
+}
+
+TEST(SnapshotStoreTest, Handles)
+{
+  EXPECT_THROW(SnapshotStore(0), std::runtime_error);
+
+  Simulator sim;
+  SnapshotStore store(2);
+  EXPECT_EQ(2, store.capacity());
+  uint64_t first = store.save(sim);
+  uint64_t second = store.save(sim);
+  EXPECT_NE(0, first);
+  EXPECT_NE(first, second);
+  EXPECT_EQ(2, store.size());
+  EXPECT_NO_THROW(store.get(first));
+
+  // the oldest snapshot is evicted
+  uint64_t third = store.save(sim);
+  EXPECT_FALSE(store.contains(first));
+  EXPECT_THROW(store.get(first), std::range_error);
+  EXPECT_TRUE(store.contains(second));
+  EXPECT_TRUE(store.contains(third));
+
+  // handles are not reused after release
+  EXPECT_TRUE(store.release(second));
+  EXPECT_FALSE(store.release(second));
+  EXPECT_EQ(1, store.size());
+  uint64_t fourth = store.save(sim);
+  EXPECT_NE(second, fourth);
+  EXPECT_TRUE(store.contains(third));
+  EXPECT_TRUE(store.contains(fourth));
+}
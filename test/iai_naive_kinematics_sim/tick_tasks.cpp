@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+using namespace iai_naive_kinematics_sim;
+
+TEST(TickTasksTest, RunsInOrder)
+{
+  TickTasks tasks;
+  EXPECT_EQ(0, tasks.run());
+
+  std::vector<int> order;
+  std::future<void> first = tasks.push([&order]() { order.push_back(1); });
+  std::future<void> second = tasks.push([&order]() { order.push_back(2); });
+  EXPECT_EQ(std::future_status::timeout, first.wait_for(std::chrono::seconds(0)));
+
+  EXPECT_EQ(2, tasks.run());
+  ASSERT_EQ(2, order.size());
+  EXPECT_EQ(1, order[0]);
+  EXPECT_EQ(2, order[1]);
+  EXPECT_NO_THROW(first.get());
+  EXPECT_NO_THROW(second.get());
+  EXPECT_EQ(0, tasks.run());
+}
+
+TEST(TickTasksTest, PassesExceptions)
+{
+  TickTasks tasks;
+  std::future<void> failed = tasks.push([]() { throw std::runtime_error("failed"); });
+  std::future<void> next = tasks.push([]() {});
+
+  // a failing task does not keep the others from running
+  EXPECT_EQ(2, tasks.run());
+  EXPECT_THROW(failed.get(), std::runtime_error);
+  EXPECT_NO_THROW(next.get());
+}
+
+TEST(TickTasksTest, ServiceThreads)
+{
+  TickTasks tasks;
+  std::atomic<bool> running(true);
+  int counter = 0;
+  std::thread simulation([&]() {
+      while (running)
+      {
+        tasks.run();
+        std::this_thread::yield();
+      }
+      tasks.run();
+  });
+
+  std::vector<std::thread> services;
+  for (size_t i=0; i<4; ++i)
+    services.push_back(std::thread([&]() {
+        for (size_t j=0; j<100; ++j)
+          tasks.push([&counter]() { counter++; }).get();
+    }));
+  for (size_t i=0; i<services.size(); ++i)
+    services[i].join();
+  running = false;
+  simulation.join();
+
+  // only the simulation thread touched the counter
+  EXPECT_EQ(400, counter);
+}
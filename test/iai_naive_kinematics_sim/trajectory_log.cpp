@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+#include <fstream>
+#include <unistd.h>
+
+using namespace iai_naive_kinematics_sim;
+
+class TrajectoryLogTest : public ::testing::Test
+{
+   protected:
+    virtual void SetUp()
+    {
+      ASSERT_TRUE(model_.initFile("test_robot.urdf"));
+      simulated_joints_.push_back("joint1");
+      simulated_joints_.push_back("joint2");
+      controlled_joints_.push_back("joint1");
+      fake_controllers_ = YAML::LoadFile("test_fake_controllers.yaml");
+      path_ = "/tmp/iai_naive_kinematics_sim_test_" + std::to_string(getpid()) + ".log";
+    }
+
+    virtual void TearDown()
+    {
+      unlink(path_.c_str());
+      unlink((path_ + ".index").c_str());
+    }
+
+    urdf::Model model_;
+    std::vector<std::string> simulated_joints_, controlled_joints_;
+    YAML::Node fake_controllers_;
+    std::string path_;
+
+    void initSimulator(Simulator& sim, double watchdog_period = 0.1) const
+    {
+      sim.init(model_, simulated_joints_, controlled_joints_, ros::Duration(watchdog_period),
+          fake_controllers_);
+    }
+
+    // simulates ticks of 10ms like the node does, with a command every 7th tick; waits for
+    // the writer every 20 ticks
+    void record(Simulator& sim, TrajectoryRecorder& recorder, size_t ticks) const
+    {
+      sensor_msgs::JointState start;
+      pushBackJointState(start, "joint1", 0.3, 0.0, 0.5);
+      sim.setSubJointState(start);
+
+      ros::Duration period(0.01);
+      ros::Time now(100.0);
+      for (size_t i=0; i<ticks; ++i, now += period)
+      {
+        if (i % 7 == 0)
+        {
+          sensor_msgs::JointState command;
+          pushBackJointState(command, "joint2", 0.0, 1.0, 0.0);
+          pushBackJointState(command, "joint1", 0.0, std::sin(0.1 * i), 0.0);
+          sim.setSubCommand(command, now - ros::Duration(0.003));
+        }
+
+        recorder.recordClock(now.toNSec(), period.toNSec(), 3);
+        sim.substep(now, period, 3);
+        const JointArrays& state = sim.getJointArrays();
+        recorder.recordState(sim.getHeader().seq, sim.getHeader().stamp.toNSec(),
+            state.position.data(), state.velocity.data(), state.effort.data());
+        if (i % 20 == 19)
+          recorder.flush();
+      }
+    }
+};
+
+TEST_F(TrajectoryLogTest, RecordAndReplay)
+{
+  Simulator sim;
+  initSimulator(sim);
+  TrajectoryRecorder recorder;
+  recorder.open(path_, sim.getJointNames(), 128);
+  sim.setRecorder(&recorder);
+  record(sim, recorder, 200);
+  recorder.close();
+  ASSERT_EQ(0, recorder.dropped());
+
+  TrajectoryLogReader log;
+  log.open(path_);
+  EXPECT_EQ(simulated_joints_, log.names());
+  // one start state, 29 commands, and a clock, 3 updates and a state per tick
+  ASSERT_EQ(1 + 29 + 200 * 5, log.size());
+  EXPECT_EQ(trajectory_log::SET_STATE, log.record(0)->type);
+  EXPECT_TRUE(log.isNamed(log.record(0), 0));
+  EXPECT_FALSE(log.isNamed(log.record(0), 1));
+  EXPECT_EQ(trajectory_log::COMMAND, log.record(1)->type);
+  // the command names joint2, which is not controlled
+  EXPECT_TRUE(log.isNamed(log.record(1), 0));
+  EXPECT_FALSE(log.isNamed(log.record(1), 1));
+  EXPECT_THROW(log.record(log.size()), std::range_error);
+
+  ASSERT_EQ(200, log.clocks());
+  EXPECT_EQ(log.size(), log.findClock(ros::Time(99.0).toNSec()));
+  size_t clock = log.findClock(ros::Time(100.105).toNSec());
+  ASSERT_LT(clock, log.size());
+  EXPECT_EQ(trajectory_log::CLOCK, log.record(clock)->type);
+  EXPECT_EQ(ros::Time(100.1).toNSec(), log.record(clock)->stamp);
+  EXPECT_EQ(3, log.record(clock)->seq);
+
+  Simulator replayed;
+  initSimulator(replayed);
+  ReplayStatistics statistics = replayTrajectory(log, replayed);
+  EXPECT_EQ(log.size(), statistics.records);
+  EXPECT_EQ(600, statistics.updates);
+  EXPECT_EQ(200, statistics.states);
+  EXPECT_EQ(0, statistics.mismatches);
+  EXPECT_EQ(sim.getJointState().position, replayed.getJointState().position);
+  EXPECT_EQ(sim.getJointState().velocity, replayed.getJointState().velocity);
+
+  // a simulator that is set up differently does not reproduce the states
+  Simulator other;
+  initSimulator(other, 0.05);
+  statistics = replayTrajectory(log, other);
+  EXPECT_LT(0, statistics.mismatches);
+  EXPECT_EQ(trajectory_log::STATE, log.record(statistics.first_mismatch)->type);
+}
+
+TEST_F(TrajectoryLogTest, Rollouts)
+{
+  Simulator sim;
+  initSimulator(sim);
+  TrajectoryRecorder recorder;
+  recorder.open(path_, sim.getJointNames());
+  sim.setRecorder(&recorder);
+
+  std::vector<sensor_msgs::JointState> commands(5), trajectory;
+  pushBackJointState(commands[0], "joint1", 0.0, 0.4, 0.0);
+  pushBackJointState(commands[3], "joint1", 0.0, -0.2, 0.0);
+  sim.rollout(ros::Time(1.0), ros::Duration(0.02), 30, commands, 0, trajectory);
+  recorder.close();
+
+  TrajectoryLogReader log;
+  log.open(path_);
+  Simulator replayed;
+  initSimulator(replayed);
+  EXPECT_EQ(30, replayTrajectory(log, replayed).updates);
+  EXPECT_EQ(sim.getJointState().position, replayed.getJointState().position);
+  EXPECT_EQ(sim.getHeader().seq, replayed.getHeader().seq);
+}
+
+TEST_F(TrajectoryLogTest, NoRestoreWhileRecording)
+{
+  Simulator sim;
+  initSimulator(sim);
+  TrajectoryRecorder recorder;
+  recorder.open(path_, sim.getJointNames());
+  sim.setRecorder(&recorder);
+  record(sim, recorder, 20);
+
+  SimulatorSnapshot snapshot;
+  sim.snapshot(snapshot);
+  record(sim, recorder, 20);
+  EXPECT_THROW(sim.restore(snapshot), std::runtime_error);
+  record(sim, recorder, 20);
+  recorder.close();
+  ASSERT_EQ(0, recorder.dropped());
+
+  // the log replays, since the simulation went on untouched
+  TrajectoryLogReader log;
+  log.open(path_);
+  Simulator replayed;
+  initSimulator(replayed);
+  ReplayStatistics statistics = replayTrajectory(log, replayed);
+  EXPECT_EQ(60, statistics.states);
+  EXPECT_EQ(0, statistics.mismatches);
+
+  // once the recorder is closed, restoring works again
+  EXPECT_NO_THROW(sim.restore(snapshot));
+}
+
+TEST_F(TrajectoryLogTest, InvalidLogs)
+{
+  TrajectoryLogReader log;
+  EXPECT_THROW(log.open(path_), std::runtime_error);
+
+  std::ofstream(path_.c_str()) << "not a trajectory log, but long enough to hold a header";
+  EXPECT_THROW(log.open(path_), std::runtime_error);
+  EXPECT_FALSE(log.isOpen());
+
+  // logs of other joints do not replay
+  std::vector<std::string> names(1, "joint1");
+  TrajectoryRecorder recorder;
+  EXPECT_THROW(recorder.open(path_, names, 0), std::runtime_error);
+  recorder.open(path_, names);
+  recorder.recordUpdate(1, 1);
+  recorder.close();
+
+  log.open(path_);
+  EXPECT_EQ(1, log.size());
+  EXPECT_EQ(0, log.clocks());
+  Simulator sim;
+  initSimulator(sim);
+  EXPECT_THROW(replayTrajectory(log, sim), std::runtime_error);
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2015-2017, Georg Bartels, <georg.bartels@cs.uni-bremen.de>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Institute of Artificial Intelligence,
+ *     University of Bremen nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <iai_naive_kinematics_sim/iai_naive_kinematics_sim.hpp>
+#include <algorithm>
+#include <random>
+
+using namespace iai_naive_kinematics_sim;
+
+class WatchdogManagerTest : public ::testing::Test
+{
+   protected:
+    virtual void SetUp()
+    {
+      periods_.push_back(ros::Duration(0.1));
+      periods_.push_back(ros::Duration(0.002));
+      periods_.push_back(ros::Duration(1.5));
+    }
+
+    virtual void TearDown(){}
+
+    std::vector<ros::Duration> periods_;
+
+    std::vector<size_t> sorted(const std::vector<size_t>& slots) const
+    {
+      std::vector<size_t> result = slots;
+      std::sort(result.begin(), result.end());
+      return result;
+    }
+};
+
+TEST_F(WatchdogManagerTest, Init)
+{
+  EXPECT_THROW(WatchdogManager(periods_, ros::Duration(0.0)), std::runtime_error);
+  EXPECT_THROW(WatchdogManager(periods_, ros::Duration(0.001), 0), std::runtime_error);
+
+  WatchdogManager dogs(periods_);
+  ASSERT_EQ(3, dogs.size());
+  for (size_t i=0; i<dogs.size(); ++i)
+  {
+    EXPECT_EQ(periods_[i], dogs.getPeriod(i));
+    EXPECT_EQ(ros::Time(0.0), dogs.getLastPetTime(i));
+    EXPECT_TRUE(dogs.isExpired(i));
+  }
+  EXPECT_TRUE(dogs.advance(ros::Time(10.0)).empty());
+}
+
+TEST_F(WatchdogManagerTest, ExpiresOnce)
+{
+  WatchdogManager dogs(periods_);
+  dogs.pet(0, ros::Time(1.0));
+  dogs.pet(1, ros::Time(1.0));
+  EXPECT_EQ(ros::Time(1.0), dogs.getLastPetTime(0));
+  EXPECT_FALSE(dogs.isExpired(0));
+
+  EXPECT_TRUE(dogs.advance(ros::Time(1.0)).empty());
+  EXPECT_TRUE(dogs.advance(ros::Time(1.002)).empty());
+  EXPECT_EQ(std::vector<size_t>(1, 1), dogs.advance(ros::Time(1.0021)));
+  EXPECT_TRUE(dogs.isExpired(1));
+  EXPECT_TRUE(dogs.advance(ros::Time(1.05)).empty());
+
+  // petting keeps it alive
+  dogs.pet(0, ros::Time(1.05));
+  EXPECT_TRUE(dogs.advance(ros::Time(1.15)).empty());
+  EXPECT_EQ(std::vector<size_t>(1, 0), dogs.advance(ros::Time(1.16)));
+  EXPECT_TRUE(dogs.advance(ros::Time(1.2)).empty());
+}
+
+TEST_F(WatchdogManagerTest, PerSlotPeriods)
+{
+  WatchdogManager dogs(periods_);
+  for (size_t i=0; i<dogs.size(); ++i)
+    dogs.pet(i, ros::Time(2.0));
+
+  dogs.setPeriod(2, ros::Duration(0.05));
+  EXPECT_EQ(ros::Duration(0.05), dogs.getPeriod(2));
+  dogs.pet(2, ros::Time(2.0));
+
+  EXPECT_EQ(std::vector<size_t>(1, 1), dogs.advance(ros::Time(2.01)));
+  EXPECT_EQ(std::vector<size_t>(1, 2), dogs.advance(ros::Time(2.06)));
+  EXPECT_EQ(std::vector<size_t>(1, 0), dogs.advance(ros::Time(2.11)));
+}
+
+TEST_F(WatchdogManagerTest, TimeJumps)
+{
+  // far beyond one turn of the wheel
+  WatchdogManager dogs(periods_);
+  for (size_t i=0; i<dogs.size(); ++i)
+    dogs.pet(i, ros::Time(3.0));
+  std::vector<size_t> all;
+  all.push_back(0);
+  all.push_back(1);
+  all.push_back(2);
+  EXPECT_EQ(all, sorted(dogs.advance(ros::Time(100.0))));
+
+  // back in time, e.g. when a projection restarts
+  dogs.pet(0, ros::Time(100.0));
+  EXPECT_TRUE(dogs.advance(ros::Time(1.0)).empty());
+  dogs.pet(1, ros::Time(1.0));
+  EXPECT_EQ(std::vector<size_t>(1, 1), dogs.advance(ros::Time(1.01)));
+  EXPECT_TRUE(dogs.advance(ros::Time(100.1)).empty());
+  EXPECT_EQ(std::vector<size_t>(1, 0), dogs.advance(ros::Time(100.2)));
+}
+
+TEST_F(WatchdogManagerTest, MatchesWatchdogs)
+{
+  // random pets and advances, compared against plain watchdogs asked every step
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int> slot_of(0, 2), steps_of(1, 30);
+  WatchdogManager dogs(periods_, ros::Duration(0.001), 16);
+  std::vector<Watchdog> reference;
+  for (size_t i=0; i<periods_.size(); ++i)
+    reference.push_back(Watchdog(periods_[i]));
+  std::vector<bool> barked(periods_.size(), true);
+
+  ros::Time now(5.0);
+  for (size_t k=0; k<2000; ++k)
+  {
+    now += ros::Duration(0.0003 * steps_of(random));
+    if (k % 3 == 0)
+    {
+      size_t slot = slot_of(random);
+      dogs.pet(slot, now);
+      reference[slot].pet(now);
+      barked[slot] = false;
+    }
+    if (k % 500 == 0)
+      now += ros::Duration(0.5);
+
+    std::vector<size_t> expected;
+    for (size_t i=0; i<reference.size(); ++i)
+      if (!barked[i] && reference[i].barks(now))
+      {
+        expected.push_back(i);
+        barked[i] = true;
+      }
+
+    ASSERT_EQ(expected, sorted(dogs.advance(now))) << "at step " << k;
+  }
+}
+
+TEST_F(WatchdogManagerTest, SnapshotRestore)
+{
+  WatchdogManager manager(periods_);
+  manager.pet(0, ros::Time(1.0));
+  manager.pet(2, ros::Time(1.0));
+  WatchdogSnapshot snapshot;
+  manager.snapshot(snapshot);
+
+  // diverge: let one watchdog expire and pet another one
+  EXPECT_EQ(std::vector<size_t>(1, 0), manager.advance(ros::Time(1.2)));
+  manager.pet(1, ros::Time(1.2));
+
+  // after restoring, the watchdogs expire as if nothing had happened since the snapshot
+  manager.restore(snapshot);
+  EXPECT_FALSE(manager.isExpired(0));
+  EXPECT_TRUE(manager.isExpired(1));
+  EXPECT_FALSE(manager.isExpired(2));
+  EXPECT_TRUE(manager.advance(ros::Time(1.05)).empty());
+  EXPECT_EQ(std::vector<size_t>(1, 0), manager.advance(ros::Time(1.2)));
+  EXPECT_EQ(std::vector<size_t>(1, 2), manager.advance(ros::Time(2.6)));
+
+  WatchdogManager other(std::vector<ros::Duration>(2, ros::Duration(0.1)));
+  EXPECT_THROW(other.restore(snapshot), std::runtime_error);
+}
+
+TEST(WatchdogPeriodsTest, Resolve)
+{
+  std::vector<std::string> controlled;
+  controlled.push_back("base_x");
+  controlled.push_back("base_y");
+  controlled.push_back("arm_1");
+  controlled.push_back("arm_2");
+  controlled.push_back("gripper");
+
+  std::map<std::string, std::vector<std::string> > groups;
+  groups["base"].push_back("base_x");
+  groups["base"].push_back("base_y");
+  groups["arm"].push_back("arm_1");
+  groups["arm"].push_back("arm_2");
+
+  std::map<std::string, double> periods;
+  periods["base"] = 0.2;
+  periods["arm"] = 0.004;
+  periods["arm_2"] = 0.006;
+
+  std::map<std::string, double> result = resolveWatchdogPeriods(periods, groups, controlled);
+  ASSERT_EQ(4, result.size());
+  EXPECT_EQ(0.2, result["base_x"]);
+  EXPECT_EQ(0.2, result["base_y"]);
+  EXPECT_EQ(0.004, result["arm_1"]);
+  EXPECT_EQ(0.006, result["arm_2"]);
+
+  periods["unknown"] = 0.1;
+  EXPECT_THROW(resolveWatchdogPeriods(periods, groups, controlled), std::runtime_error);
+  periods.erase("unknown");
+
+  periods["gripper"] = 0.0;
+  EXPECT_THROW(resolveWatchdogPeriods(periods, groups, controlled), std::runtime_error);
+  periods.erase("gripper");
+
+  groups["arm"].push_back("not_controlled");
+  EXPECT_THROW(resolveWatchdogPeriods(periods, groups, controlled), std::runtime_error);
+}